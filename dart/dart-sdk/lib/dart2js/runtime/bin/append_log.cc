@@ -0,0 +1,247 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/append_log.h"
+
+#include "bin/builtin.h"
+#include "bin/dartutils.h"
+#include "bin/thread.h"
+#include "bin/utils.h"
+
+#include "include/dart_api.h"
+
+
+AppendLog* AppendLog::Open(const char* name, Dart_Port port) {
+  File* file = File::Open(name, File::kWrite);
+  if (file == NULL) {
+    return NULL;
+  }
+  off_t length = file->Length();
+  if (length < 0) {
+    delete file;
+    return NULL;
+  }
+  AppendLog* log = new AppendLog(file, port, length);
+  int result = dart::Thread::Start(&AppendLog::Run,
+                                   reinterpret_cast<uword>(log));
+  if (result != 0) {
+    delete log;
+    return NULL;
+  }
+  return log;
+}
+
+
+AppendLog::~AppendLog() {
+  delete file_;
+  delete error_;
+  FreeRecords(head_);
+}
+
+
+void AppendLog::Append(uint8_t* data, intptr_t length) {
+  Record* record = new Record();
+  record->data = data;
+  record->length = length;
+  record->next = NULL;
+  MonitorLocker locker(&monitor_);
+  ASSERT(!closing_);
+  if (tail_ == NULL) {
+    head_ = record;
+  } else {
+    tail_->next = record;
+  }
+  tail_ = record;
+  locker.Notify();
+}
+
+
+void AppendLog::Close() {
+  MonitorLocker locker(&monitor_);
+  closing_ = true;
+  locker.Notify();
+}
+
+
+void AppendLog::Run(uword args) {
+  reinterpret_cast<AppendLog*>(args)->WriteLoop();
+}
+
+
+void AppendLog::WriteLoop() {
+  const void** buffers = reinterpret_cast<const void**>(
+      malloc(kMaxBatchRecords * sizeof(*buffers)));
+  int64_t* lengths = reinterpret_cast<int64_t*>(
+      malloc(kMaxBatchRecords * sizeof(*lengths)));
+  while (true) {
+    intptr_t count = 0;
+    Record* batch = TakeBatch(&count);
+    if (batch == NULL) break;
+    // The records appended while this batch is written and flushed
+    // are queued up for the next batch.
+    if (error_ == NULL) {
+      int64_t batch_length = 0;
+      intptr_t i = 0;
+      for (Record* record = batch; record != NULL; record = record->next) {
+        buffers[i] = record->data;
+        lengths[i] = record->length;
+        batch_length += record->length;
+        i++;
+      }
+      if (file_->WriteGatherFully(buffers, lengths, count) &&
+          file_->FlushData()) {
+        length_ += batch_length;
+      } else {
+        error_ = new OSError();
+      }
+    }
+    FreeRecords(batch);
+    if (error_ == NULL) {
+      PostBatchDone(count);
+    } else {
+      PostBatchFailed(count);
+    }
+  }
+  free(buffers);
+  free(lengths);
+  Dart_Port port = port_;
+  delete this;
+  Dart_CObject closed;
+  closed.type = Dart_CObject::kNull;
+  Dart_PostCObject(port, &closed);
+}
+
+
+AppendLog::Record* AppendLog::TakeBatch(intptr_t* count) {
+  MonitorLocker locker(&monitor_);
+  while (head_ == NULL && !closing_) {
+    locker.Wait();
+  }
+  if (head_ == NULL) {
+    return NULL;
+  }
+  Record* batch = head_;
+  Record* last = head_;
+  *count = 1;
+  while (last->next != NULL && *count < kMaxBatchRecords) {
+    last = last->next;
+    (*count)++;
+  }
+  head_ = last->next;
+  if (head_ == NULL) {
+    tail_ = NULL;
+  }
+  last->next = NULL;
+  return batch;
+}
+
+
+void AppendLog::PostBatchDone(intptr_t count) {
+  Dart_CObject success;
+  success.type = Dart_CObject::kInt32;
+  success.value.as_int32 = 0;
+  Dart_CObject records;
+  records.type = Dart_CObject::kInt32;
+  records.value.as_int32 = count;
+  Dart_CObject length;
+  length.type = Dart_CObject::kInt64;
+  length.value.as_int64 = length_;
+  Dart_CObject* values[3] = { &success, &records, &length };
+  Dart_CObject message;
+  message.type = Dart_CObject::kArray;
+  message.value.as_array.length = 3;
+  message.value.as_array.values = values;
+  Dart_PostCObject(port_, &message);
+}
+
+
+void AppendLog::PostBatchFailed(intptr_t count) {
+  Dart_CObject type;
+  type.type = Dart_CObject::kInt32;
+  type.value.as_int32 = 2;  // OSERROR_RESPONSE in file_impl.dart.
+  Dart_CObject code;
+  code.type = Dart_CObject::kInt32;
+  code.value.as_int32 = error_->code();
+  Dart_CObject error_message;
+  error_message.type = Dart_CObject::kString;
+  error_message.value.as_string = error_->message();
+  Dart_CObject records;
+  records.type = Dart_CObject::kInt32;
+  records.value.as_int32 = count;
+  Dart_CObject* values[4] = { &type, &code, &error_message, &records };
+  Dart_CObject message;
+  message.type = Dart_CObject::kArray;
+  message.value.as_array.length = 4;
+  message.value.as_array.values = values;
+  Dart_PostCObject(port_, &message);
+}
+
+
+void AppendLog::FreeRecords(Record* records) {
+  while (records != NULL) {
+    Record* next = records->next;
+    free(records->data);
+    delete records;
+    records = next;
+  }
+}
+
+
+void FUNCTION_NAME(AppendLog_Open)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  const char* name =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 0));
+  Dart_Port port =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 1),
+                                 DartUtils::kIdFieldName);
+  AppendLog* log = AppendLog::Open(name, port);
+  if (log != NULL) {
+    Dart_SetReturnValue(args,
+                        Dart_NewInteger(reinterpret_cast<intptr_t>(log)));
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(AppendLog_Append)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  AppendLog* log = reinterpret_cast<AppendLog*>(value);
+  ASSERT(log != NULL);
+  Dart_Handle buffer_obj = Dart_GetNativeArgument(args, 1);
+  ASSERT(Dart_IsList(buffer_obj));
+  // Offset and length arguments are checked in Dart code to be
+  // integers and have the property that (offset + length) <=
+  // list.length.
+  int64_t offset =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 2));
+  int64_t length =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 3));
+  // The record is owned by the log until it has been written so it is
+  // not taken from the I/O buffer pool, which caches per thread.
+  uint8_t* data = reinterpret_cast<uint8_t*>(malloc(length));
+  Dart_Handle result = Dart_ListGetAsBytes(buffer_obj, offset, data, length);
+  if (Dart_IsError(result)) {
+    free(data);
+    Dart_PropagateError(result);
+  }
+  log->Append(data, length);
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(AppendLog_Close)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  AppendLog* log = reinterpret_cast<AppendLog*>(value);
+  ASSERT(log != NULL);
+  log->Close();
+  Dart_ExitScope();
+}
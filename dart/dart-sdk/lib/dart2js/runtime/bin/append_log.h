@@ -0,0 +1,81 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef BIN_APPEND_LOG_H_
+#define BIN_APPEND_LOG_H_
+
+#include "bin/builtin.h"
+#include "bin/file.h"
+#include "bin/utils.h"
+#include "platform/globals.h"
+#include "platform/thread.h"
+
+// Append-only log file with group commit. Appended records are queued
+// for a background thread which writes all queued records with one
+// gather write and makes them durable with one data flush. Records
+// appended while a batch is being flushed form the next batch so the
+// cost of a flush is shared by all records arriving meanwhile.
+//
+// When a batch is durable the message [0, count, length] is posted to
+// the port of the log, where count is the number of records in the
+// batch and length is the length of the file after the batch. If
+// writing or flushing fails the message is [2, code, message, count]
+// and all later records fail with the same error, as the content of
+// the file after the failure is unknown.
+class AppendLog {
+ public:
+  // Opens the file with the given name for appending. Returns NULL if
+  // the file could not be opened.
+  static AppendLog* Open(const char* name, Dart_Port port);
+
+  // Queues a record. The log takes ownership of the data, which must
+  // be allocated with malloc.
+  void Append(uint8_t* data, intptr_t length);
+
+  // Writes the queued records, closes the file and posts null to the
+  // port. The log deletes itself when done.
+  void Close();
+
+ private:
+  struct Record {
+    uint8_t* data;
+    intptr_t length;
+    Record* next;
+  };
+
+  // Upper bound of the number of records in one batch.
+  static const intptr_t kMaxBatchRecords = 1024;
+
+  AppendLog(File* file, Dart_Port port, int64_t length)
+      : file_(file),
+        port_(port),
+        length_(length),
+        head_(NULL),
+        tail_(NULL),
+        closing_(false),
+        error_(NULL) { }
+  ~AppendLog();
+
+  static void Run(uword args);
+  void WriteLoop();
+  // Takes up to kMaxBatchRecords records off the queue. Returns NULL if
+  // the log is closing and the queue is empty.
+  Record* TakeBatch(intptr_t* count);
+  void PostBatchDone(intptr_t count);
+  void PostBatchFailed(intptr_t count);
+  static void FreeRecords(Record* records);
+
+  File* file_;
+  Dart_Port port_;
+  int64_t length_;
+  dart::Monitor monitor_;
+  Record* head_;
+  Record* tail_;
+  bool closing_;
+  OSError* error_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppendLog);
+};
+
+#endif  // BIN_APPEND_LOG_H_
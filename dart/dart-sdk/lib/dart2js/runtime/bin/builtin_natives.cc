@@ -15,6 +15,9 @@
 // List all native functions implemented in standalone dart that is used
 // to inject additional functionality e.g: Logger, file I/O, socket I/O etc.
 #define BUILTIN_NATIVE_LIST(V)                                                 \
+  V(AppendLog_Open, 2)                                                         \
+  V(AppendLog_Append, 4)                                                       \
+  V(AppendLog_Close, 1)                                                        \
   V(Directory_Exists, 1)                                                       \
   V(Directory_Create, 1)                                                       \
   V(Directory_Current, 0)                                                      \
@@ -23,7 +26,7 @@
   V(Directory_Rename, 2)                                                       \
   V(Directory_NewServicePort, 0)                                               \
   V(EventHandler_Start, 1)                                                     \
-  V(EventHandler_SendData, 4)                                                  \
+  V(EventHandler_SendData, 5)                                                  \
   V(Exit, 1)                                                                   \
   V(File_Open, 2)                                                              \
   V(File_Exists, 1)                                                            \
@@ -33,38 +36,57 @@
   V(File_WriteString, 2)                                                       \
   V(File_ReadList, 4)                                                          \
   V(File_WriteList, 4)                                                         \
+  V(File_ReadAt, 5)                                                            \
+  V(File_WriteAt, 5)                                                           \
   V(File_Position, 1)                                                          \
   V(File_SetPosition, 2)                                                       \
   V(File_Truncate, 2)                                                          \
   V(File_Length, 1)                                                            \
   V(File_LengthFromName, 1)                                                    \
   V(File_LastModified, 1)                                                      \
+  V(File_Stat, 1)                                                              \
   V(File_Flush, 1)                                                             \
+  V(File_Mmap, 5)                                                              \
+  V(File_StartReadAhead, 4)                                                    \
+  V(File_ReadAheadConsumed, 1)                                                 \
+  V(File_StopReadAhead, 1)                                                     \
   V(File_Create, 1)                                                            \
   V(File_Delete, 1)                                                            \
+  V(File_Copy, 2)                                                              \
   V(File_Directory, 1)                                                         \
   V(File_FullPath, 1)                                                          \
   V(File_OpenStdio, 1)                                                         \
   V(File_GetStdioHandleType, 1)                                                \
-  V(File_NewServicePort, 0)                                                    \
+  V(File_NewServicePort, 1)                                                    \
+  V(FileSystemWatcher_Watch, 2)                                                \
+  V(FileSystemWatcher_Unwatch, 2)                                              \
+  V(FileSystemWatcher_GetInstance, 0)                                          \
   V(Logger_PrintString, 1)                                                     \
   V(Platform_NumberOfProcessors, 0)                                            \
   V(Platform_OperatingSystem, 0)                                               \
   V(Platform_PathSeparator, 0)                                                 \
   V(Platform_LocalHostname, 0)                                                 \
   V(Platform_Environment, 0)                                                   \
-  V(Process_Start, 10)                                                         \
+  V(Process_Start, 13)                                                         \
   V(Process_Kill, 3)                                                           \
+  V(Process_KeepWarm, 10)                                                      \
+  V(Process_NewServicePort, 0)                                                 \
   V(ServerSocket_CreateBindListen, 4)                                          \
   V(ServerSocket_Accept, 2)                                                    \
+  V(ServerSocket_Dispatch, 5)                                                  \
+  V(ServerSocket_CloseDispatcher, 1)                                           \
   V(Socket_CreateConnect, 3)                                                   \
   V(Socket_Available, 1)                                                       \
   V(Socket_ReadList, 4)                                                        \
   V(Socket_WriteList, 4)                                                       \
+  V(Socket_WriteListZeroCopy, 4)                                               \
+  V(Socket_EnableZeroCopy, 1)                                                  \
+  V(Socket_GetZeroCopyThreshold, 0)                                            \
   V(Socket_GetPort, 1)                                                         \
   V(Socket_GetRemotePeer, 1)                                                   \
   V(Socket_GetError, 1)                                                        \
   V(Socket_GetStdioHandle, 2)                                                  \
+  V(Socket_ReleaseDispatched, 2)                                               \
   V(Socket_NewServicePort, 0)
 
 
@@ -5,14 +5,12 @@
 #include "bin/directory.h"
 
 #include "bin/dartutils.h"
+#include "bin/io_service.h"
 #include "bin/thread.h"
+#include "bin/utils.h"
 #include "include/dart_api.h"
 #include "platform/assert.h"
 
-dart::Mutex Directory::mutex_;
-int Directory::service_ports_size_ = 0;
-Dart_Port* Directory::service_ports_ = NULL;
-int Directory::service_ports_index_ = 0;
 
 void FUNCTION_NAME(Directory_Current)(Dart_NativeArguments args) {
   Dart_EnterScope();
@@ -168,14 +166,97 @@ static CObject* DirectoryCreateTempRequest(const CObjectArray& request) {
 }
 
 
+static bool AddGlobs(CObject* object,
+                     DirectoryListingFilter* filter,
+                     bool include) {
+  if (object->IsNull()) return true;
+  if (!object->IsArray()) return false;
+  CObjectArray globs(object);
+  for (int i = 0; i < globs.Length(); i++) {
+    if (!globs[i]->IsString()) return false;
+    CObjectString glob(globs[i]);
+    if (include) {
+      filter->AddInclude(glob.CString());
+    } else {
+      filter->AddExclude(glob.CString());
+    }
+  }
+  return true;
+}
+
+
+static bool GetBound(CObject* object, int64_t default_value, int64_t* bound) {
+  if (object->IsNull()) {
+    *bound = default_value;
+    return true;
+  }
+  if (!object->IsIntptr()) return false;
+  CObjectIntptr value(object);
+  *bound = value.Value();
+  return true;
+}
+
+
+// Reads the filter of a list request, which is a list of the include
+// globs, the exclude globs, the minimum and maximum file size and the
+// bounds of the file modification time. Each element can be null.
+static bool ParseListingFilter(CObject* object,
+                               DirectoryListingFilter* filter) {
+  if (!object->IsArray()) return false;
+  CObjectArray values(object);
+  if (values.Length() != 6) return false;
+  if (!AddGlobs(values[0], filter, true) ||
+      !AddGlobs(values[1], filter, false)) {
+    return false;
+  }
+  int64_t min_size;
+  int64_t max_size;
+  int64_t modified_after;
+  int64_t modified_before;
+  if (!GetBound(values[2], 0, &min_size) ||
+      !GetBound(values[3], kMaxInt64, &max_size) ||
+      !GetBound(values[4], kMinInt64, &modified_after) ||
+      !GetBound(values[5], kMaxInt64, &modified_before)) {
+    return false;
+  }
+  if (!values[2]->IsNull() || !values[3]->IsNull()) {
+    filter->SetSizeBounds(min_size, max_size);
+  }
+  if (!values[4]->IsNull() || !values[5]->IsNull()) {
+    filter->SetModifiedBounds(modified_after, modified_before);
+  }
+  return true;
+}
+
+
 static CObject* DirectoryListRequest(const CObjectArray& request,
                                      Dart_Port response_port) {
-  if (request.Length() == 3 && request[1]->IsString() && request[2]->IsBool()) {
-    DirectoryListing* dir_listing = new DirectoryListing(response_port);
+  DirectoryListingFilter filter;
+  bool has_filter = (request.Length() == 6 && !request[5]->IsNull());
+  if ((request.Length() == 3 || request.Length() == 6) &&
+      request[1]->IsString() &&
+      request[2]->IsBool() &&
+      (request.Length() == 3 ||
+       (request[3]->IsBool() && request[4]->IsBool())) &&
+      (!has_filter || ParseListingFilter(request[5], &filter))) {
+    bool include_stat = false;
+    bool unordered = false;
+    if (request.Length() == 6) {
+      CObjectBool stat(request[3]);
+      include_stat = stat.Value();
+      CObjectBool any_order(request[4]);
+      unordered = any_order.Value();
+    }
+    DirectoryListing* dir_listing =
+        new DirectoryListing(response_port, include_stat, unordered);
+    if (has_filter) {
+      dir_listing->set_filter(&filter);
+    }
     CObjectString path(request[1]);
     CObjectBool recursive(request[2]);
     bool completed = Directory::List(
         path.CString(), recursive.Value(), dir_listing);
+    completed = dir_listing->Flush() && completed;
     delete dir_listing;
     CObjectArray* response = new CObjectArray(CObject::NewArray(2));
     response->SetAt(
@@ -252,27 +333,10 @@ void DirectoryService(Dart_Port dest_port_id,
 
 
 Dart_Port Directory::GetServicePort() {
-  MutexLocker lock(&mutex_);
-  if (service_ports_size_ == 0) {
-    ASSERT(service_ports_ == NULL);
-    service_ports_size_ = 16;
-    service_ports_ = new Dart_Port[service_ports_size_];
-    service_ports_index_ = 0;
-    for (int i = 0; i < service_ports_size_; i++) {
-      service_ports_[i] = kIllegalPort;
-    }
-  }
-
-  Dart_Port result = service_ports_[service_ports_index_];
-  if (result == kIllegalPort) {
-    result = Dart_NewNativePort("DirectoryService",
-                                DirectoryService,
-                                true);
-    ASSERT(result != kIllegalPort);
-    service_ports_[service_ports_index_] = result;
-  }
-  service_ports_index_ = (service_ports_index_ + 1) % service_ports_size_;
-  return result;
+  return IOService::GetServicePort(IOService::kDirectoryService,
+                                   "DirectoryService",
+                                   DirectoryService,
+                                   IOService::kNoOrderingKey);
 }
 
 
@@ -289,37 +353,295 @@ void FUNCTION_NAME(Directory_NewServicePort)(Dart_NativeArguments args) {
 }
 
 
-CObjectArray* DirectoryListing::NewResponse(Response type, char* arg) {
-  CObjectArray* response = new CObjectArray(CObject::NewArray(2));
-  response->SetAt(0, new CObjectInt32(CObject::NewInt32(type)));
-  response->SetAt(1, new CObjectString(CObject::NewString(arg)));
-  return response;
+DirectoryListing::~DirectoryListing() {
+  for (intptr_t i = 0; i < batch_count_; i++) {
+    free(batch_paths_[i]);
+  }
+}
+
+
+bool DirectoryListing::AddEntry(Response type,
+                                const char* path,
+                                const int64_t* stat) {
+  batch_types_[batch_count_] = type;
+  batch_paths_[batch_count_] = strdup(path);
+  if (include_stat_) {
+    for (intptr_t i = 0; i < kStatValues; i++) {
+      batch_stats_[batch_count_][i] = stat[i];
+    }
+  }
+  batch_count_++;
+  batch_bytes_ += strlen(path);
+  if (batch_count_ == kMaxBatchEntries || batch_bytes_ >= kMaxBatchBytes) {
+    return Flush();
+  }
+  return true;
 }
 
 
-bool DirectoryListing::HandleDirectory(char* dir_name) {
+bool DirectoryListing::Flush() {
+  if (batch_count_ == 0) return true;
+  // The message is built from malloced objects rather than scope
+  // allocated CObjects as a long listing posts many batches in the
+  // same scope. Posting copies the message so it is freed right away.
+  intptr_t entry_length = include_stat_ ? 2 + kStatValues : 2;
+  intptr_t length = 1 + entry_length * batch_count_;
+  Dart_CObject* objects = new Dart_CObject[length];
+  Dart_CObject** values = new Dart_CObject*[length];
+  for (intptr_t i = 0; i < length; i++) {
+    values[i] = &objects[i];
+  }
+  objects[0].type = Dart_CObject::kInt32;
+  objects[0].value.as_int32 = kListBatch;
+  for (intptr_t i = 0; i < batch_count_; i++) {
+    Dart_CObject* entry = &objects[1 + entry_length * i];
+    entry[0].type = Dart_CObject::kInt32;
+    entry[0].value.as_int32 = batch_types_[i];
+    entry[1].type = Dart_CObject::kString;
+    entry[1].value.as_string = batch_paths_[i];
+    if (include_stat_) {
+      for (intptr_t j = 0; j < kStatValues; j++) {
+        entry[2 + j].type = Dart_CObject::kInt64;
+        entry[2 + j].value.as_int64 = batch_stats_[i][j];
+      }
+    }
+  }
+  Dart_CObject message;
+  message.type = Dart_CObject::kArray;
+  message.value.as_array.length = length;
+  message.value.as_array.values = values;
+  bool result = Dart_PostCObject(response_port_, &message);
+  delete[] values;
+  delete[] objects;
+  for (intptr_t i = 0; i < batch_count_; i++) {
+    free(batch_paths_[i]);
+  }
+  batch_count_ = 0;
+  batch_bytes_ = 0;
+  return result;
+}
+
+
+bool DirectoryListing::HandleDirectory(char* dir_name, const int64_t* stat) {
   // TODO(sgjesse): Pass flags to indicate whether directory
   // responses are needed.
-  CObjectArray* response = NewResponse(kListDirectory, dir_name);
-  return Dart_PostCObject(response_port_, response->AsApiCObject());
+  return AddEntry(kListDirectory, dir_name, stat);
 }
 
 
-bool DirectoryListing::HandleFile(char* file_name) {
+bool DirectoryListing::HandleFile(char* file_name, const int64_t* stat) {
   // TODO(sgjesse): Pass flags to indicate whether file
   // responses are needed.
-  CObjectArray* response = NewResponse(kListFile, file_name);
-  return Dart_PostCObject(response_port_, response->AsApiCObject());
+  return AddEntry(kListFile, file_name, stat);
 }
 
 
 bool DirectoryListing::HandleError(const char* dir_name) {
   // TODO(sgjesse): Pass flags to indicate whether error
   // responses are needed.
-  CObject* err = CObject::NewOSError();
+  OSError os_error;
+  // Post the entries found before the error first to keep the order.
+  if (!Flush()) return false;
+  CObject* err = CObject::NewOSError(&os_error);
   CObjectArray* response = new CObjectArray(CObject::NewArray(3));
   response->SetAt(0, new CObjectInt32(CObject::NewInt32(kListError)));
   response->SetAt(1, new CObjectString(CObject::NewString(dir_name)));
   response->SetAt(2, err);
   return Dart_PostCObject(response_port_, response->AsApiCObject());
 }
+
+
+DirectoryListingFilter::~DirectoryListingFilter() {
+  for (intptr_t i = 0; i < include_count_; i++) {
+    free(includes_[i]);
+  }
+  free(includes_);
+  for (intptr_t i = 0; i < exclude_count_; i++) {
+    free(excludes_[i]);
+  }
+  free(excludes_);
+}
+
+
+void DirectoryListingFilter::AddGlob(const char* glob,
+                                     char*** globs,
+                                     intptr_t* count) {
+  *globs = reinterpret_cast<char**>(
+      realloc(*globs, (*count + 1) * sizeof(**globs)));
+  (*globs)[*count] = strdup(glob);
+  (*count)++;
+}
+
+
+void DirectoryListingFilter::AddInclude(const char* glob) {
+  AddGlob(glob, &includes_, &include_count_);
+}
+
+
+void DirectoryListingFilter::AddExclude(const char* glob) {
+  AddGlob(glob, &excludes_, &exclude_count_);
+}
+
+
+void DirectoryListingFilter::SetSizeBounds(int64_t min_size,
+                                           int64_t max_size) {
+  min_size_ = min_size;
+  max_size_ = max_size;
+  needs_stat_ = true;
+}
+
+
+void DirectoryListingFilter::SetModifiedBounds(int64_t after,
+                                               int64_t before) {
+  modified_after_ = after;
+  modified_before_ = before;
+  needs_stat_ = true;
+}
+
+
+bool DirectoryListingFilter::IsExcluded(const char* path) {
+  for (intptr_t i = 0; i < exclude_count_; i++) {
+    if (GlobMatches(excludes_[i], path, false)) return true;
+  }
+  return false;
+}
+
+
+bool DirectoryListingFilter::IsIncluded(const char* path, bool below) {
+  if (include_count_ == 0) return true;
+  for (intptr_t i = 0; i < include_count_; i++) {
+    if (GlobMatches(includes_[i], path, below)) return true;
+  }
+  return false;
+}
+
+
+bool DirectoryListingFilter::Matches(const char* path,
+                                     bool is_directory,
+                                     const int64_t* stat) {
+  if (IsExcluded(path) || !IsIncluded(path, false)) return false;
+  if (is_directory || !needs_stat_) return true;
+  int64_t size = stat[DirectoryListing::kStatSize];
+  int64_t modified = stat[DirectoryListing::kStatModified];
+  return size >= min_size_ &&
+      size <= max_size_ &&
+      modified >= modified_after_ &&
+      modified < modified_before_;
+}
+
+
+bool DirectoryListingFilter::ShouldTraverse(const char* path) {
+  return !IsExcluded(path) && IsIncluded(path, true);
+}
+
+
+static bool IsGlobSeparator(char c) {
+#if defined(TARGET_OS_WINDOWS)
+  return c == '/' || c == '\\';
+#else
+  return c == '/';
+#endif
+}
+
+
+static const char* SegmentEnd(const char* segment) {
+  while (*segment != '\0' && !IsGlobSeparator(*segment)) segment++;
+  return segment;
+}
+
+
+static const char* NextSegment(const char* segment_end) {
+  return (*segment_end == '\0') ? segment_end : segment_end + 1;
+}
+
+
+// Matches c against the single character glob at *glob, which is a
+// literal, '?' or a '[...]' class, and advances *glob past it on a
+// match. A '[' without a closing ']' is a literal.
+static bool MatchGlobCharacter(const char** glob,
+                               const char* glob_end,
+                               char c) {
+  const char* g = *glob;
+  if (*g == '?') {
+    *glob = g + 1;
+    return true;
+  }
+  if (*g == '[') {
+    const char* p = g + 1;
+    bool negated = (p < glob_end && (*p == '!' || *p == '^'));
+    if (negated) p++;
+    bool matched = false;
+    // A ']' right after the opening bracket is part of the class.
+    const char* first = p;
+    while (p < glob_end && (*p != ']' || p == first)) {
+      if (p + 2 < glob_end && p[1] == '-' && p[2] != ']') {
+        if (p[0] <= c && c <= p[2]) matched = true;
+        p += 3;
+      } else {
+        if (*p == c) matched = true;
+        p++;
+      }
+    }
+    if (p < glob_end) {
+      if (matched == negated) return false;
+      *glob = p + 1;
+      return true;
+    }
+  }
+  if (*g != c) return false;
+  *glob = g + 1;
+  return true;
+}
+
+
+// Matches the glob segment [glob, glob_end) against the path segment
+// [name, name_end). A '*' backtracks to the last star only, which is
+// enough as a star matches any sequence within the segment.
+static bool MatchGlobSegment(const char* glob,
+                             const char* glob_end,
+                             const char* name,
+                             const char* name_end) {
+  const char* star_glob = NULL;
+  const char* star_name = NULL;
+  while (name < name_end) {
+    if (glob < glob_end && *glob == '*') {
+      star_glob = ++glob;
+      star_name = name;
+    } else if (glob < glob_end &&
+               MatchGlobCharacter(&glob, glob_end, *name)) {
+      name++;
+    } else if (star_glob != NULL) {
+      glob = star_glob;
+      name = ++star_name;
+    } else {
+      return false;
+    }
+  }
+  while (glob < glob_end && *glob == '*') glob++;
+  return glob == glob_end;
+}
+
+
+bool DirectoryListingFilter::GlobMatches(const char* glob,
+                                         const char* path,
+                                         bool below) {
+  if (*glob == '\0') {
+    return !below && *path == '\0';
+  }
+  const char* glob_end = SegmentEnd(glob);
+  if (glob_end - glob == 2 && glob[0] == '*' && glob[1] == '*') {
+    // Everything below can match. Otherwise the '**' either matches no
+    // segment or the first segment of path and possibly more.
+    if (below) return true;
+    if (GlobMatches(NextSegment(glob_end), path, false)) return true;
+    return *path != '\0' &&
+        GlobMatches(glob, NextSegment(SegmentEnd(path)), false);
+  }
+  if (*path == '\0') {
+    // The rest of the glob can match entries below path.
+    return below;
+  }
+  const char* path_end = SegmentEnd(path);
+  return MatchGlobSegment(glob, glob_end, path, path_end) &&
+      GlobMatches(NextSegment(glob_end), NextSegment(path_end), below);
+}
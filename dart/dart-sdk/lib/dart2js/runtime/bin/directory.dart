@@ -118,8 +118,33 @@ interface Directory default _Directory {
    * [DirectoryLister] object representing the active listing
    * operation. Handlers for files and directories should be
    * registered on this DirectoryLister object.
+   *
+   * If [includeStat] is true the size, modification time, mode and
+   * inode number of each entry are read while listing and passed to
+   * the entry handler, which avoids a separate request per entry.
+   *
+   * If [unordered] is true a recursive listing may list
+   * sub-directories in parallel. The entries of different directories
+   * are then reported in no particular order, but a directory is
+   * always reported before its entries.
+   *
+   * If a [filter] is given only the entries it selects are reported.
+   * The filter is applied natively while listing so sub-directories
+   * it rules out are not even read.
    */
-  DirectoryLister list([bool recursive]);
+  DirectoryLister list([bool recursive,
+                        bool includeStat,
+                        bool unordered,
+                        DirectoryFilter filter]);
+
+  /**
+   * Start watching the directory for changes to the directory itself
+   * and to the files and directories directly inside it. Returns a
+   * [FileSystemWatcher] on which a change handler should be
+   * registered. The watcher must be closed when no longer used.
+   * Throws an exception if the directory cannot be watched.
+   */
+  FileSystemWatcher watch();
 
   /**
    * Gets the path of this directory.
@@ -128,6 +153,40 @@ interface Directory default _Directory {
 }
 
 
+/**
+ * A [DirectoryFilter] selects the entries reported by a directory
+ * listing.
+ *
+ * The globs are matched against the path of an entry relative to the
+ * listed directory using '/' as separator. '*' and '?' match within a
+ * path segment, '[...]' matches a character class and a '**' segment
+ * matches any number of segments, so a glob starting with a '**'
+ * segment matches at any depth. An entry is reported if it matches one
+ * of the [include] globs, or there are none, and none of the [exclude]
+ * globs. The contents of an excluded directory are not listed.
+ *
+ * Files are only reported if their size is in the range from
+ * [minSize] to [maxSize], both inclusive, and they were last modified
+ * at or after [modifiedAfter] and before [modifiedBefore]. Bounds
+ * which are null do not restrict the listing.
+ */
+class DirectoryFilter {
+  const DirectoryFilter([List<String> this.include,
+                         List<String> this.exclude,
+                         int this.minSize,
+                         int this.maxSize,
+                         Date this.modifiedAfter,
+                         Date this.modifiedBefore]);
+
+  final List<String> include;
+  final List<String> exclude;
+  final int minSize;
+  final int maxSize;
+  final Date modifiedAfter;
+  final Date modifiedBefore;
+}
+
+
 /**
  * A [DirectoryLister] represents an actively running listing operation.
  *
@@ -150,6 +209,15 @@ interface DirectoryLister default _DirectoryLister {
    */
   void set onFile(void onFile(String file));
 
+  /**
+   * Sets the handler that is called for all files and directories
+   * during listing. The entry handler is called with the full path of
+   * the entry and its [FileStat] if the listing includes stats or null
+   * otherwise. It is called in addition to the file or directory
+   * handler.
+   */
+  void set onEntry(void onEntry(String path, FileStat stat));
+
   /**
    * Set the handler that is called when a listing is done. The
    * handler is called with an indication of whether or not the
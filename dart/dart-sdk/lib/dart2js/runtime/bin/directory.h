@@ -10,24 +10,163 @@
 #include "platform/globals.h"
 #include "platform/thread.h"
 
+// Selects the entries of a listing before they are posted. Globs are
+// matched against the path of an entry relative to the listed
+// directory. '*' and '?' match within a path segment, '[...]' matches a
+// character class and a '**' segment matches any number of segments.
+// An entry is selected if it matches an include glob, or there are
+// none, and no exclude glob. The size and modification time bounds
+// only apply to files. Directories matching an exclude glob and
+// directories below which no include glob can match are not opened.
+class DirectoryListingFilter {
+ public:
+  DirectoryListingFilter()
+      : includes_(NULL),
+        include_count_(0),
+        excludes_(NULL),
+        exclude_count_(0),
+        min_size_(0),
+        max_size_(kMaxInt64),
+        modified_after_(kMinInt64),
+        modified_before_(kMaxInt64),
+        needs_stat_(false) {}
+  ~DirectoryListingFilter();
+
+  void AddInclude(const char* glob);
+  void AddExclude(const char* glob);
+  // Files must have a size in [min_size, max_size] and a modification
+  // time in milliseconds since the epoch in [after, before).
+  void SetSizeBounds(int64_t min_size, int64_t max_size);
+  void SetModifiedBounds(int64_t after, int64_t before);
+
+  // Whether Matches needs the stat values of files.
+  bool needs_stat() const { return needs_stat_; }
+  // Whether the entry with the given relative path is selected. stat
+  // holds the DirectoryListing::StatValue values of the entry if
+  // needs_stat() is true.
+  bool Matches(const char* path, bool is_directory, const int64_t* stat);
+  // Whether the directory with the given relative path has to be
+  // opened in a recursive listing.
+  bool ShouldTraverse(const char* path);
+
+  // Returns whether path matches glob or, if below is true, whether a
+  // path below path can match glob.
+  static bool GlobMatches(const char* glob, const char* path, bool below);
+
+ private:
+  static void AddGlob(const char* glob, char*** globs, intptr_t* count);
+  bool IsExcluded(const char* path);
+  bool IsIncluded(const char* path, bool below);
+
+  char** includes_;
+  intptr_t include_count_;
+  char** excludes_;
+  intptr_t exclude_count_;
+  int64_t min_size_;
+  int64_t max_size_;
+  int64_t modified_after_;
+  int64_t modified_before_;
+  bool needs_stat_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryListingFilter);
+};
+
+
+// Posts the entries found while listing a directory to a port. Files
+// and directories are collected and posted in batches of the form
+// [kListBatch, type, path, type, path, ...] where type is
+// kListDirectory or kListFile. If the listing includes stats each path
+// is followed by the kStatValues values of the entry. A batch is
+// posted when it is full, before an error is posted and when Flush is
+// called at the end of the listing.
 class DirectoryListing {
  public:
   enum Response {
     kListDirectory = 0,
     kListFile = 1,
     kListError = 2,
-    kListDone = 3
+    kListDone = 3,
+    kListBatch = 4
+  };
+
+  // A batch is posted when it has kMaxBatchEntries entries or its
+  // paths take up kMaxBatchBytes bytes.
+  static const intptr_t kMaxBatchEntries = 1024;
+  static const intptr_t kMaxBatchBytes = 256 * KB;
+
+  // The stat values of an entry. These have to be kept in sync with
+  // _DirectoryLister in directory_impl.dart.
+  enum StatValue {
+    kStatSize = 0,
+    kStatModified = 1,  // In milliseconds since the epoch.
+    kStatMode = 2,
+    kStatInode = 3,
+    kStatValues = 4
   };
 
-  explicit DirectoryListing(Dart_Port response_port)
-      : response_port_(response_port) {}
-  bool HandleDirectory(char* dir_name);
-  bool HandleFile(char* file_name);
+  DirectoryListing(Dart_Port response_port,
+                   bool include_stat,
+                   bool unordered)
+      : response_port_(response_port),
+        include_stat_(include_stat),
+        unordered_(unordered),
+        filter_(NULL),
+        root_length_(0),
+        batch_count_(0),
+        batch_bytes_(0) {}
+  ~DirectoryListing();
+  Dart_Port response_port() const { return response_port_; }
+  bool include_stat() const { return include_stat_; }
+  // Whether the stat values of every entry have to be read, either to
+  // post them or to filter on them.
+  bool needs_stat() const {
+    return include_stat_ || (filter_ != NULL && filter_->needs_stat());
+  }
+  // Whether the entries of a recursive listing may be posted in any
+  // order, which allows listing subdirectories in parallel. Entries
+  // are always posted after their directory.
+  bool unordered() const { return unordered_; }
+
+  // The filter is owned by the caller and is shared by the listings
+  // used for one listing request. The root length is the length of
+  // the full path of the listed directory including the trailing
+  // separator, which is stripped from paths before they are filtered.
+  DirectoryListingFilter* filter() const { return filter_; }
+  void set_filter(DirectoryListingFilter* filter) { filter_ = filter; }
+  intptr_t root_length() const { return root_length_; }
+  void set_root_length(intptr_t length) { root_length_ = length; }
+
+  // Whether the entry with the given full path passes the filter.
+  bool Matches(const char* path, bool is_directory, const int64_t* stat) {
+    return filter_ == NULL ||
+        filter_->Matches(path + root_length_, is_directory, stat);
+  }
+  // Whether the directory with the given full path has to be opened in
+  // a recursive listing.
+  bool ShouldTraverse(const char* path) {
+    return filter_ == NULL || filter_->ShouldTraverse(path + root_length_);
+  }
+  // stat holds the kStatValues values of the entry if the listing
+  // includes stats and is ignored otherwise.
+  bool HandleDirectory(char* dir_name, const int64_t* stat);
+  bool HandleFile(char* file_name, const int64_t* stat);
   bool HandleError(const char* dir_name);
+  // Post the entries collected so far. Returns false if they could not
+  // be posted.
+  bool Flush();
 
  private:
-  CObjectArray* NewResponse(Response response, char* arg);
+  bool AddEntry(Response type, const char* path, const int64_t* stat);
   Dart_Port response_port_;
+  bool include_stat_;
+  bool unordered_;
+  DirectoryListingFilter* filter_;
+  intptr_t root_length_;
+  intptr_t batch_count_;
+  intptr_t batch_bytes_;
+  Response batch_types_[kMaxBatchEntries];
+  char* batch_paths_[kMaxBatchEntries];
+  int64_t batch_stats_[kMaxBatchEntries][kStatValues];
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(DirectoryListing);
 };
@@ -64,11 +203,6 @@ class Directory {
   static Dart_Port GetServicePort();
 
  private:
-  static dart::Mutex mutex_;
-  static int service_ports_size_;
-  static Dart_Port* service_ports_;
-  static int service_ports_index_;
-
   DISALLOW_ALLOCATION();
   DISALLOW_IMPLICIT_CONSTRUCTORS(Directory);
 };
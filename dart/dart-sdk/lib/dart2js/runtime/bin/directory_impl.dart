@@ -168,8 +168,16 @@ class _Directory implements Directory {
     return new Directory(newPath);
   }
 
-  DirectoryLister list([bool recursive = false]) {
-    return new _DirectoryLister(_path, recursive);
+  DirectoryLister list([bool recursive = false,
+                        bool includeStat = false,
+                        bool unordered = false,
+                        DirectoryFilter filter]) {
+    return new _DirectoryLister(
+        _path, recursive, includeStat, unordered, filter);
+  }
+
+  FileSystemWatcher watch() {
+    return new _FileSystemWatcher(_path);
   }
 
   String get path() { return _path; }
@@ -203,21 +211,39 @@ class _Directory implements Directory {
 }
 
 class _DirectoryLister implements DirectoryLister {
-  _DirectoryLister(String path, bool recursive) {
+  _DirectoryLister(String path,
+                   bool recursive,
+                   bool includeStat,
+                   bool unordered,
+                   DirectoryFilter filter) {
     final int LIST_DIRECTORY = 0;
     final int LIST_FILE = 1;
     final int LIST_ERROR = 2;
     final int LIST_DONE = 3;
+    final int LIST_BATCH = 4;
 
     final int RESPONSE_TYPE = 0;
     final int RESPONSE_PATH = 1;
     final int RESPONSE_COMPLETE = 1;
     final int RESPONSE_ERROR = 2;
 
-    List request = new List(3);
+    // Stat values following the path of an entry in a batch when the
+    // listing includes stats. These have to be kept in sync with
+    // DirectoryListing::StatValue in directory.h.
+    final int STAT_SIZE = 0;
+    final int STAT_MODIFIED = 1;
+    final int STAT_MODE = 2;
+    final int STAT_INODE = 3;
+    final int STAT_VALUES = 4;
+
+    List request = new List(6);
     request[0] = _Directory.LIST_REQUEST;
     request[1] = path;
     request[2] = recursive;
+    request[3] = includeStat;
+    request[4] = unordered;
+    request[5] = _filterToList(filter);
+    int entryLength = includeStat ? 2 + STAT_VALUES : 2;
     ReceivePort responsePort = new ReceivePort();
     // Use a separate directory service port for each listing as
     // listing operations on the same directory can run in parallel.
@@ -235,6 +261,34 @@ class _DirectoryLister implements DirectoryLister {
         case LIST_FILE:
           if (_onFile != null) _onFile(message[RESPONSE_PATH]);
           break;
+        case LIST_BATCH:
+          // Files and directories are posted in batches of type and
+          // path pairs following the response type, each followed by
+          // the stat values if the listing includes stats.
+          for (int i = 1; i < message.length; i += entryLength) {
+            bool isDirectory = message[i] == LIST_DIRECTORY;
+            String entryPath = message[i + 1];
+            if (isDirectory) {
+              if (_onDir != null) _onDir(entryPath);
+            } else {
+              if (_onFile != null) _onFile(entryPath);
+            }
+            if (_onEntry != null) {
+              FileStat stat = null;
+              if (includeStat) {
+                int s = i + 2;
+                stat = new FileStat._internal(
+                    isDirectory ? FileStat.DIRECTORY : FileStat.FILE,
+                    message[s + STAT_SIZE],
+                    new Date.fromMillisecondsSinceEpoch(
+                        message[s + STAT_MODIFIED]),
+                    message[s + STAT_MODE],
+                    message[s + STAT_INODE]);
+              }
+              _onEntry(entryPath, stat);
+            }
+          }
+          break;
         case LIST_ERROR:
           var errorType =
               message[RESPONSE_ERROR][_FileUtils.ERROR_RESPONSE_ERROR_TYPE];
@@ -262,6 +316,23 @@ class _DirectoryLister implements DirectoryLister {
     });
   }
 
+  // Encodes the filter in the form read by the directory service.
+  static List _filterToList(DirectoryFilter filter) {
+    if (filter == null) return null;
+    List result = new List(6);
+    result[0] = filter.include;
+    result[1] = filter.exclude;
+    result[2] = filter.minSize;
+    result[3] = filter.maxSize;
+    if (filter.modifiedAfter != null) {
+      result[4] = filter.modifiedAfter.millisecondsSinceEpoch;
+    }
+    if (filter.modifiedBefore != null) {
+      result[5] = filter.modifiedBefore.millisecondsSinceEpoch;
+    }
+    return result;
+  }
+
   void set onDir(void onDir(String dir)) {
     _onDir = onDir;
   }
@@ -270,6 +341,10 @@ class _DirectoryLister implements DirectoryLister {
     _onFile = onFile;
   }
 
+  void set onEntry(void onEntry(String path, FileStat stat)) {
+    _onEntry = onEntry;
+  }
+
   void set onDone(void onDone(bool completed)) {
     _onDone = onDone;
   }
@@ -288,6 +363,7 @@ class _DirectoryLister implements DirectoryLister {
 
   Function _onDir;
   Function _onFile;
+  Function _onEntry;
   Function _onDone;
   Function _onError;
 }
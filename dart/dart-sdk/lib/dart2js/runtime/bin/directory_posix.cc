@@ -6,12 +6,17 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#if defined(TARGET_OS_LINUX)
+#include <sys/syscall.h>
+#endif
 #include <unistd.h>
 
 #include "bin/file.h"
 #include "bin/platform.h"
+#include "bin/thread.h"
 
 
 static char* SafeStrNCpy(char* dest, const char* src, size_t n) {
@@ -21,13 +26,6 @@ static char* SafeStrNCpy(char* dest, const char* src, size_t n) {
 }
 
 
-// Forward declarations.
-static bool ListRecursively(const char* dir_name,
-                            bool recursive,
-                            DirectoryListing* listing);
-static bool DeleteRecursively(const char* dir_name);
-
-
 static bool ComputeFullPath(const char* dir_name,
                             char* path,
                             int* path_length) {
@@ -51,44 +49,397 @@ static bool ComputeFullPath(const char* dir_name,
 }
 
 
-static bool HandleDir(char* dir_name,
-                      char* path,
-                      int path_length,
-                      bool recursive,
-                      DirectoryListing *listing) {
-  if (strcmp(dir_name, ".") != 0 &&
-      strcmp(dir_name, "..") != 0) {
-    size_t written = snprintf(path + path_length,
-                              PATH_MAX - path_length,
-                              "%s",
-                              dir_name);
-    if (written != strlen(dir_name)) {
+// Iterates the entries of an open directory, skipping "." and "..". On
+// Linux the entries are read with getdents64 into a large buffer so a
+// large directory is read with few system calls. Elsewhere the
+// directory stream from fdopendir is used. The iterator owns the file
+// descriptor.
+class DirectoryEntries {
+ public:
+  explicit DirectoryEntries(int fd);
+  ~DirectoryEntries();
+
+  // Returns false at the end of the directory or if reading failed, in
+  // which case error() is the errno value of the failure.
+  bool Next(const char** name, unsigned char* type);
+  int fd() const { return fd_; }
+  int error() const { return error_; }
+
+ private:
+#if defined(TARGET_OS_LINUX)
+  // Layout of the entries returned by getdents64, which has no
+  // declaration in the C library headers.
+  struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;  // NOLINT
+    unsigned char d_type;
+    char d_name[1];
+  };
+
+  static const intptr_t kBufferSize = 64 * KB;
+
+  char* buffer_;
+  intptr_t buffer_position_;
+  intptr_t buffer_length_;
+#else
+  DIR* dir_pointer_;
+  dirent entry_;
+#endif
+  int fd_;
+  int error_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryEntries);
+};
+
+
+#if defined(TARGET_OS_LINUX)
+DirectoryEntries::DirectoryEntries(int fd)
+    : buffer_(static_cast<char*>(malloc(kBufferSize))),
+      buffer_position_(0),
+      buffer_length_(0),
+      fd_(fd),
+      error_(0) {
+  ASSERT(buffer_ != NULL);
+}
+
+
+DirectoryEntries::~DirectoryEntries() {
+  free(buffer_);
+  TEMP_FAILURE_RETRY(close(fd_));
+}
+
+
+bool DirectoryEntries::Next(const char** name, unsigned char* type) {
+  while (true) {
+    if (buffer_position_ == buffer_length_) {
+      long result = TEMP_FAILURE_RETRY(  // NOLINT
+          syscall(SYS_getdents64, fd_, buffer_, kBufferSize));
+      if (result <= 0) {
+        if (result == -1) error_ = errno;
+        return false;
+      }
+      buffer_position_ = 0;
+      buffer_length_ = result;
+    }
+    LinuxDirent64* entry =
+        reinterpret_cast<LinuxDirent64*>(buffer_ + buffer_position_);
+    buffer_position_ += entry->d_reclen;
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      *name = entry->d_name;
+      *type = entry->d_type;
+      return true;
+    }
+  }
+}
+#else
+DirectoryEntries::DirectoryEntries(int fd)
+    : dir_pointer_(fdopendir(fd)), fd_(fd), error_(0) {
+  if (dir_pointer_ == NULL) {
+    error_ = errno;
+  }
+}
+
+
+DirectoryEntries::~DirectoryEntries() {
+  if (dir_pointer_ != NULL) {
+    closedir(dir_pointer_);
+  } else {
+    TEMP_FAILURE_RETRY(close(fd_));
+  }
+}
+
+
+bool DirectoryEntries::Next(const char** name, unsigned char* type) {
+  if (dir_pointer_ == NULL) return false;
+  dirent* result;
+  while (true) {
+    int read = TEMP_FAILURE_RETRY(readdir_r(dir_pointer_, &entry_, &result));
+    if (read != 0) {
+      error_ = read;
       return false;
     }
-    bool ok = listing->HandleDirectory(path);
-    if (!ok) return ok;
-    if (recursive) {
-      return ListRecursively(path, recursive, listing);
+    if (result == NULL) return false;
+    if (strcmp(entry_.d_name, ".") != 0 && strcmp(entry_.d_name, "..") != 0) {
+      *name = entry_.d_name;
+      *type = entry_.d_type;
+      return true;
     }
   }
+}
+#endif
+
+
+// A traversal of a directory tree spread over a bounded number of
+// worker threads. The thread running the walk is worker 0. The
+// subdirectories found by a worker are queued, and helper threads are
+// started only while more directories are queued than idle workers
+// can take, so walking a small tree does not start any threads. The
+// helper threads of all walks running at the same time share one
+// bound, so concurrent walks do not multiply the thread count. A
+// directory is done when it and all its subdirectories have been
+// handled, which lets a recursive delete remove a directory after its
+// content.
+class DirectoryWalk {
+ public:
+  struct Dir {
+    char* path;  // Full path ending with a separator.
+    Dir* parent;
+    // One for handling the directory itself and one for each queued
+    // subdirectory which is not done yet.
+    intptr_t pending;
+    Dir* next;
+  };
+
+  virtual ~DirectoryWalk() { }
+
+  // Walks the tree below the directory with the given path, which must
+  // end with a separator. Returns when all directories are done and
+  // all helper threads have exited.
+  void Run(const char* path);
+
+  // Queues the subdirectory of parent with the given path, which does
+  // not end with a separator.
+  void AddDirectory(Dir* parent, const char* path);
+
+  bool failed();
+  void Fail();
+
+ protected:
+  static const intptr_t kMaxWorkers = 16;
+
+  DirectoryWalk();
+
+  // Handles the entries of dir on the given worker.
+  virtual void HandleDirectory(intptr_t worker, Dir* dir) = 0;
+  // Called when dir and all its subdirectories have been handled.
+  virtual void DirectoryDone(Dir* dir) { }
+  // Called on each worker after it has handled its last directory.
+  virtual void WorkerDone(intptr_t worker) { }
+
+ private:
+  static void RunHelper(uword args);
+  void Work(intptr_t worker);
+  // Takes the next queued directory. Returns NULL when the walk is
+  // done.
+  Dir* Take();
+  void Release(Dir* dir);
+
+  // Reserves one of the helper threads shared by all walks. Returns
+  // false when they are all in use.
+  static bool ReserveHelper();
+  static void ReleaseHelper();
+
+  static dart::Mutex helpers_mutex_;
+  static intptr_t helpers_;
+
+  dart::Monitor monitor_;
+  Dir* head_;
+  Dir* tail_;
+  intptr_t queued_;
+  intptr_t idle_;
+  intptr_t workers_;
+  intptr_t next_helper_;
+  intptr_t running_helpers_;
+  bool done_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryWalk);
+};
+
+
+DirectoryWalk::DirectoryWalk()
+    : head_(NULL),
+      tail_(NULL),
+      queued_(0),
+      idle_(0),
+      workers_(1),
+      next_helper_(1),
+      running_helpers_(0),
+      done_(false),
+      failed_(false) {
+}
+
+
+dart::Mutex DirectoryWalk::helpers_mutex_;
+intptr_t DirectoryWalk::helpers_ = 0;
+
+
+bool DirectoryWalk::ReserveHelper() {
+  // Walking is mostly waiting for metadata reads so use more workers
+  // than processors.
+  intptr_t max_workers = 2 * Platform::NumberOfProcessors();
+  if (max_workers < 2) max_workers = 2;
+  if (max_workers > kMaxWorkers) max_workers = kMaxWorkers;
+  MutexLocker locker(&helpers_mutex_);
+  if (helpers_ >= max_workers - 1) return false;
+  helpers_++;
   return true;
 }
 
 
-static bool HandleFile(char* file_name,
-                       char* path,
-                       int path_length,
-                       DirectoryListing *listing) {
-  // TODO(sgjesse): Pass flags to indicate whether file responses are
-  // needed.
+void DirectoryWalk::ReleaseHelper() {
+  MutexLocker locker(&helpers_mutex_);
+  helpers_--;
+}
+
+
+void DirectoryWalk::Run(const char* path) {
+  Dir* root = new Dir();
+  root->path = strdup(path);
+  root->parent = NULL;
+  root->pending = 1;
+  root->next = NULL;
+  {
+    MonitorLocker locker(&monitor_);
+    head_ = tail_ = root;
+    queued_ = 1;
+  }
+  Work(0);
+  MonitorLocker locker(&monitor_);
+  while (running_helpers_ > 0) {
+    locker.Wait();
+  }
+}
+
+
+void DirectoryWalk::AddDirectory(Dir* parent, const char* path) {
+  Dir* dir = new Dir();
+  intptr_t length = strlen(path) + strlen(File::PathSeparator());
+  dir->path = static_cast<char*>(malloc(length + 1));
+  snprintf(dir->path, length + 1, "%s%s", path, File::PathSeparator());
+  dir->parent = parent;
+  dir->pending = 1;
+  dir->next = NULL;
+  bool start_helper = false;
+  {
+    MonitorLocker locker(&monitor_);
+    parent->pending++;
+    if (tail_ == NULL) {
+      head_ = dir;
+    } else {
+      tail_->next = dir;
+    }
+    tail_ = dir;
+    queued_++;
+    if (queued_ > idle_ + 1 && workers_ < kMaxWorkers &&
+        ReserveHelper()) {
+      workers_++;
+      running_helpers_++;
+      start_helper = true;
+    }
+    locker.Notify();
+  }
+  if (start_helper) {
+    int result = dart::Thread::Start(&DirectoryWalk::RunHelper,
+                                     reinterpret_cast<uword>(this));
+    if (result != 0) {
+      // The running workers take the queued directories.
+      ReleaseHelper();
+      MonitorLocker locker(&monitor_);
+      workers_--;
+      running_helpers_--;
+    }
+  }
+}
+
+
+bool DirectoryWalk::failed() {
+  MonitorLocker locker(&monitor_);
+  return failed_;
+}
+
+
+void DirectoryWalk::Fail() {
+  MonitorLocker locker(&monitor_);
+  failed_ = true;
+}
+
+
+void DirectoryWalk::RunHelper(uword args) {
+  DirectoryWalk* walk = reinterpret_cast<DirectoryWalk*>(args);
+  intptr_t worker;
+  {
+    MonitorLocker locker(&walk->monitor_);
+    worker = walk->next_helper_++;
+  }
+  walk->Work(worker);
+  ReleaseHelper();
+  MonitorLocker locker(&walk->monitor_);
+  walk->running_helpers_--;
+  locker.NotifyAll();
+}
+
+
+void DirectoryWalk::Work(intptr_t worker) {
+  ASSERT(worker < kMaxWorkers);
+  while (true) {
+    Dir* dir = Take();
+    if (dir == NULL) break;
+    HandleDirectory(worker, dir);
+    Release(dir);
+  }
+  WorkerDone(worker);
+}
+
+
+DirectoryWalk::Dir* DirectoryWalk::Take() {
+  MonitorLocker locker(&monitor_);
+  idle_++;
+  while (head_ == NULL && !done_) {
+    locker.Wait();
+  }
+  idle_--;
+  if (head_ == NULL) {
+    return NULL;
+  }
+  Dir* dir = head_;
+  head_ = dir->next;
+  if (head_ == NULL) {
+    tail_ = NULL;
+  }
+  queued_--;
+  return dir;
+}
+
+
+void DirectoryWalk::Release(Dir* dir) {
+  while (dir != NULL) {
+    {
+      MonitorLocker locker(&monitor_);
+      dir->pending--;
+      if (dir->pending > 0) return;
+    }
+    DirectoryDone(dir);
+    Dir* parent = dir->parent;
+    free(dir->path);
+    delete dir;
+    if (parent == NULL) {
+      MonitorLocker locker(&monitor_);
+      done_ = true;
+      locker.NotifyAll();
+    }
+    dir = parent;
+  }
+}
+
+
+// Forward declaration.
+static bool ListRecursively(int dir_fd,
+                            char* path,
+                            int path_length,
+                            bool recursive,
+                            DirectoryListing* listing,
+                            DirectoryWalk* walk,
+                            DirectoryWalk::Dir* walk_dir);
+
+
+static bool AppendName(const char* name, char* path, int path_length) {
   size_t written = snprintf(path + path_length,
                             PATH_MAX - path_length,
                             "%s",
-                            file_name);
-  if (written != strlen(file_name)) {
-    return false;
-  }
-  return listing->HandleFile(path);
+                            name);
+  return written == strlen(name);
 }
 
 
@@ -98,250 +449,369 @@ static void PostError(DirectoryListing *listing,
 }
 
 
-static bool ListRecursively(const char* dir_name,
-                            bool recursive,
-                            DirectoryListing *listing) {
-  DIR* dir_pointer;
-  do {
-    dir_pointer = opendir(dir_name);
-  } while (dir_pointer == NULL && errno == EINTR);
-  if (dir_pointer == NULL) {
-    PostError(listing, dir_name);
+// Posts an error for the directory whose path, including the trailing
+// separator, is the first path_length characters of path.
+static void PostDirectoryError(DirectoryListing *listing,
+                               char* path,
+                               int path_length) {
+  path[path_length > 1 ? path_length - 1 : path_length] = '\0';
+  PostError(listing, path);
+}
+
+
+static void FillListingStat(const struct stat& entry_info, int64_t* stat) {
+  stat[DirectoryListing::kStatSize] = entry_info.st_size;
+  stat[DirectoryListing::kStatModified] =
+      static_cast<int64_t>(entry_info.st_mtime) * 1000;
+  stat[DirectoryListing::kStatMode] = entry_info.st_mode & 07777;
+  stat[DirectoryListing::kStatInode] = entry_info.st_ino;
+}
+
+
+static bool HandleDir(int dir_fd,
+                      const char* dir_name,
+                      char* path,
+                      int path_length,
+                      const int64_t* stat,
+                      bool recursive,
+                      DirectoryListing *listing,
+                      DirectoryWalk* walk,
+                      DirectoryWalk::Dir* walk_dir) {
+  if (!AppendName(dir_name, path, path_length)) {
     return false;
   }
+  if (listing->Matches(path, true, stat)) {
+    bool ok = listing->HandleDirectory(path, stat);
+    if (!ok) return ok;
+  }
+  // Directories the filter rules out are never opened.
+  if (!recursive || !listing->ShouldTraverse(path)) {
+    return true;
+  }
+  if (walk != NULL) {
+    // Post the directory before another worker can list and post its
+    // entries.
+    if (!listing->Flush()) return false;
+    walk->AddDirectory(walk_dir, path);
+  } else {
+    int fd = TEMP_FAILURE_RETRY(
+        openat(dir_fd, dir_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd == -1) {
+      PostError(listing, path);
+      return false;
+    }
+    int length = path_length + strlen(dir_name);
+    if (!AppendName(File::PathSeparator(), path, length)) {
+      TEMP_FAILURE_RETRY(close(fd));
+      return false;
+    }
+    length += strlen(File::PathSeparator());
+    return ListRecursively(fd, path, length, recursive, listing, NULL, NULL);
+  }
+  return true;
+}
 
-  // Compute full path for the directory currently being listed.  The
-  // path buffer will be used to construct the current path in the
-  // recursive traversal. path_length does not always equal
-  // strlen(path) but indicates the current prefix of path that is the
-  // path of the current directory in the traversal.
-  char *path = static_cast<char*>(malloc(PATH_MAX));
-  ASSERT(path != NULL);
-  int path_length = 0;
-  bool valid = ComputeFullPath(dir_name, path, &path_length);
-  if (!valid) {
-    free(path);
-    PostError(listing, dir_name);
+
+static bool HandleFile(const char* file_name,
+                       char* path,
+                       int path_length,
+                       const int64_t* stat,
+                       DirectoryListing *listing) {
+  // TODO(sgjesse): Pass flags to indicate whether file responses are
+  // needed.
+  if (!AppendName(file_name, path, path_length)) {
     return false;
   }
+  if (!listing->Matches(path, false, stat)) {
+    return true;
+  }
+  return listing->HandleFile(path, stat);
+}
 
-  // Iterated the directory and post the directories and files to the
-  // ports.
-  int read = 0;
+
+// Lists the directory open as dir_fd. The path buffer holds the full
+// path of the directory followed by a separator in its first
+// path_length characters and is used to construct the paths of the
+// entries in the recursive traversal. Entries are looked up relative to
+// dir_fd so the full path is never resolved by the OS again. Takes
+// ownership of dir_fd. If walk is not NULL subdirectories are queued on
+// the walk as children of walk_dir instead of being listed right away.
+static bool ListRecursively(int dir_fd,
+                            char* path,
+                            int path_length,
+                            bool recursive,
+                            DirectoryListing *listing,
+                            DirectoryWalk* walk,
+                            DirectoryWalk::Dir* walk_dir) {
+  DirectoryEntries entries(dir_fd);
+  bool needs_stat = listing->needs_stat();
+  int64_t stat[DirectoryListing::kStatValues];
   bool success = true;
-  dirent entry;
-  dirent* result;
-  while ((read = TEMP_FAILURE_RETRY(readdir_r(dir_pointer,
-                                              &entry,
-                                              &result))) == 0 &&
-         result != NULL) {
-    switch (entry.d_type) {
+  const char* name;
+  unsigned char type;
+  while (entries.Next(&name, &type)) {
+    if (needs_stat || type == DT_LNK || type == DT_UNKNOWN) {
+      // On some file systems the entry type is not determined by
+      // readdir. For those and for links we use fstatat to determine
+      // the actual entry type. Notice that fstatat without
+      // AT_SYMLINK_NOFOLLOW returns the type of the file pointed to.
+      struct stat entry_info;
+      int stat_success =
+          TEMP_FAILURE_RETRY(fstatat(dir_fd, name, &entry_info, 0));
+      if (stat_success == -1) {
+        success = false;
+        if (AppendName(name, path, path_length)) {
+          PostError(listing, path);
+        }
+        continue;
+      }
+      ASSERT(!S_ISLNK(entry_info.st_mode));
+      if (S_ISDIR(entry_info.st_mode)) {
+        type = DT_DIR;
+      } else if (S_ISREG(entry_info.st_mode)) {
+        type = DT_REG;
+      } else {
+        continue;
+      }
+      if (needs_stat) {
+        FillListingStat(entry_info, stat);
+      }
+    }
+    switch (type) {
       case DT_DIR:
-        success = HandleDir(entry.d_name,
+        success = HandleDir(dir_fd,
+                            name,
                             path,
                             path_length,
+                            stat,
                             recursive,
-                            listing) && success;
+                            listing,
+                            walk,
+                            walk_dir) && success;
         break;
       case DT_REG:
-        success = HandleFile(entry.d_name,
+        success = HandleFile(name,
                              path,
                              path_length,
+                             stat,
                              listing) && success;
         break;
-      case DT_LNK:
-      case DT_UNKNOWN: {
-        // On some file systems the entry type is not determined by
-        // readdir_r. For those and for links we use stat to determine
-        // the actual entry type. Notice that stat returns the type of
-        // the file pointed to.
-        struct stat entry_info;
-        size_t written = snprintf(path + path_length,
-                                  PATH_MAX - path_length,
-                                  "%s",
-                                  entry.d_name);
-        if (written != strlen(entry.d_name)) {
-          success = false;
-          break;
-        }
-        int stat_success = TEMP_FAILURE_RETRY(stat(path, &entry_info));
-        if (stat_success == -1) {
-          success = false;
-          PostError(listing, path);
-          break;
-        }
-        if (S_ISDIR(entry_info.st_mode)) {
-          success = HandleDir(entry.d_name,
-                              path,
-                              path_length,
-                              recursive,
-                              listing) && success;
-        } else if (S_ISREG(entry_info.st_mode)) {
-          success = HandleFile(entry.d_name,
-                               path,
-                               path_length,
-                               listing) && success;
-        }
-        ASSERT(!S_ISLNK(entry_info.st_mode));
-        break;
-      }
       default:
         break;
     }
   }
 
-  if (read != 0) {
-    errno = read;
+  if (entries.error() != 0) {
+    errno = entries.error();
     success = false;
-    PostError(listing, dir_name);
+    PostDirectoryError(listing, path, path_length);
   }
 
-  if (closedir(dir_pointer) == -1) {
-    success = false;
-    PostError(listing, dir_name);
-  }
-  free(path);
-
   return success;
 }
 
 
-static bool DeleteFile(char* file_name,
-                       char* path,
-                       int path_length) {
-  size_t written = snprintf(path + path_length,
-                            PATH_MAX - path_length,
-                            "%s",
-                            file_name);
-  if (written != strlen(file_name)) {
-    return false;
-  }
-  return (remove(path) == 0);
-}
-
-
-static bool DeleteDir(char* dir_name,
-                      char* path,
-                      int path_length) {
-  if (strcmp(dir_name, ".") != 0 &&
-      strcmp(dir_name, "..") != 0) {
-    size_t written = snprintf(path + path_length,
-                              PATH_MAX - path_length,
-                              "%s",
-                              dir_name);
-    if (written != strlen(dir_name)) {
-      return false;
+// Recursive listing which lists subdirectories in parallel. Each
+// helper worker posts its entries through its own listing so entries
+// of different directories are posted in no particular order.
+class ParallelListing : public DirectoryWalk {
+ public:
+  explicit ParallelListing(DirectoryListing* listing) {
+    listings_[0] = listing;
+    for (intptr_t i = 1; i < kMaxWorkers; i++) {
+      listings_[i] = NULL;
     }
-    return DeleteRecursively(path);
-  }
-  return true;
-}
-
-
-static bool DeleteRecursively(const char* dir_name) {
-  // Do not recurse into links for deletion. Instead delete the link.
-  struct stat st;
-  if (TEMP_FAILURE_RETRY(lstat(dir_name, &st)) == -1) {
-    return false;
-  } else if (S_ISLNK(st.st_mode)) {
-    return (remove(dir_name) == 0);
   }
 
-  // Not a link. Attempt to open as a directory and recurse into the
-  // directory.
-  DIR* dir_pointer;
-  do {
-    dir_pointer = opendir(dir_name);
-  } while (dir_pointer == NULL && errno == EINTR);
-
-  if (dir_pointer == NULL) {
-    return false;
+ protected:
+  virtual void HandleDirectory(intptr_t worker, Dir* dir) {
+    DirectoryListing* listing = listings_[worker];
+    if (listing == NULL) {
+      listing = new DirectoryListing(listings_[0]->response_port(),
+                                     listings_[0]->include_stat(),
+                                     listings_[0]->unordered());
+      listing->set_filter(listings_[0]->filter());
+      listing->set_root_length(listings_[0]->root_length());
+      listings_[worker] = listing;
+    }
+    char* path = static_cast<char*>(malloc(PATH_MAX));
+    ASSERT(path != NULL);
+    int path_length = strlen(dir->path);
+    if (!AppendName(dir->path, path, 0)) {
+      free(path);
+      Fail();
+      return;
+    }
+    int fd = TEMP_FAILURE_RETRY(
+        open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd == -1) {
+      PostDirectoryError(listing, path, path_length);
+      Fail();
+    } else if (!ListRecursively(fd,
+                                path,
+                                path_length,
+                                true,
+                                listing,
+                                this,
+                                dir)) {
+      Fail();
+    }
+    free(path);
   }
 
-  // Compute full path for the directory currently being deleted.  The
-  // path buffer will be used to construct the current path in the
-  // recursive traversal. path_length does not always equal
-  // strlen(path) but indicates the current prefix of path that is the
-  // path of the current directory in the traversal.
-  char *path = static_cast<char*>(malloc(PATH_MAX));
-  ASSERT(path != NULL);
-  int path_length = 0;
-  bool valid = ComputeFullPath(dir_name, path, &path_length);
-  if (!valid) {
-    free(path);
-    return false;
+  virtual void WorkerDone(intptr_t worker) {
+    // The listing of worker 0 is flushed by the caller.
+    if (worker == 0 || listings_[worker] == NULL) return;
+    if (!listings_[worker]->Flush()) Fail();
+    delete listings_[worker];
+    listings_[worker] = NULL;
   }
 
-  // Iterate the directory and delete all files and directories.
-  int read = 0;
-  bool success = true;
-  dirent entry;
-  dirent* result;
-  while ((read = TEMP_FAILURE_RETRY(readdir_r(dir_pointer,
-                                              &entry,
-                                              &result))) == 0 &&
-         result != NULL &&
-         success) {
-    switch (entry.d_type) {
-      case DT_DIR:
-        success = success && DeleteDir(entry.d_name, path, path_length);
-        break;
-      case DT_REG:
-      case DT_LNK:
-        // Treat all links as files. This will delete the link which
-        // is what we want no matter if the link target is a file or a
-        // directory.
-        success = success && DeleteFile(entry.d_name, path, path_length);
-        break;
-      case DT_UNKNOWN: {
+ private:
+  DirectoryListing* listings_[kMaxWorkers];
+};
+
+
+// Recursive delete which deletes the content of subdirectories in
+// parallel. A directory is removed once all its subdirectories have
+// been removed. After the first failure the remaining directories are
+// skipped.
+class ParallelDelete : public DirectoryWalk {
+ public:
+  ParallelDelete() { }
+
+ protected:
+  virtual void HandleDirectory(intptr_t worker, Dir* dir) {
+    if (failed()) return;
+    int fd = TEMP_FAILURE_RETRY(
+        open(dir->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+    if (fd == -1) {
+      Fail();
+      return;
+    }
+    char* path = static_cast<char*>(malloc(PATH_MAX));
+    ASSERT(path != NULL);
+    int path_length = strlen(dir->path);
+    bool success = AppendName(dir->path, path, 0);
+    DirectoryEntries entries(fd);
+    const char* name;
+    unsigned char type;
+    while (success && entries.Next(&name, &type)) {
+      if (type == DT_UNKNOWN) {
         // On some file systems the entry type is not determined by
-        // readdir_r. For those we use lstat to determine the entry
-        // type.
+        // readdir. For those we use fstatat without following links
+        // to determine the entry type.
         struct stat entry_info;
-        size_t written = snprintf(path + path_length,
-                                  PATH_MAX - path_length,
-                                  "%s",
-                                  entry.d_name);
-        if (written != strlen(entry.d_name)) {
-          success = false;
-          break;
-        }
-        int lstat_success = TEMP_FAILURE_RETRY(lstat(path, &entry_info));
-        if (lstat_success == -1) {
+        if (TEMP_FAILURE_RETRY(fstatat(fd,
+                                       name,
+                                       &entry_info,
+                                       AT_SYMLINK_NOFOLLOW)) == -1) {
           success = false;
           break;
         }
         if (S_ISDIR(entry_info.st_mode)) {
-          success = success && DeleteDir(entry.d_name, path, path_length);
-        } else if (S_ISREG(entry_info.st_mode) || S_ISLNK(entry_info.st_mode)) {
-          // Treat links as files. This will delete the link which is
-          // what we want no matter if the link target is a file or a
-          // directory.
-          success = success && DeleteFile(entry.d_name, path, path_length);
+          type = DT_DIR;
+        } else if (S_ISREG(entry_info.st_mode)) {
+          type = DT_REG;
+        } else if (S_ISLNK(entry_info.st_mode)) {
+          type = DT_LNK;
         }
-        break;
       }
-      default:
-        break;
+      switch (type) {
+        case DT_DIR:
+          success = AppendName(name, path, path_length);
+          if (success) AddDirectory(dir, path);
+          break;
+        case DT_REG:
+        case DT_LNK:
+          // Treat all links as files. This will delete the link which
+          // is what we want no matter if the link target is a file or a
+          // directory.
+          success = (TEMP_FAILURE_RETRY(unlinkat(fd, name, 0)) == 0);
+          break;
+        default:
+          break;
+      }
+    }
+    if (!success || entries.error() != 0) {
+      Fail();
+    }
+    free(path);
+  }
+
+  virtual void DirectoryDone(Dir* dir) {
+    if (failed()) return;
+    if (TEMP_FAILURE_RETRY(rmdir(dir->path)) == -1) {
+      Fail();
     }
   }
+};
 
-  free(path);
 
-  if ((read != 0) ||
-      (closedir(dir_pointer) == -1) ||
-      (remove(dir_name) == -1)) {
+static bool DeleteRecursively(const char* dir_name) {
+  // Do not recurse into links for deletion. Instead delete the link.
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(lstat(dir_name, &st)) == -1) {
     return false;
+  } else if (S_ISLNK(st.st_mode)) {
+    return (remove(dir_name) == 0);
   }
 
-  return success;
+  char *path = static_cast<char*>(malloc(PATH_MAX));
+  ASSERT(path != NULL);
+  size_t written = snprintf(path,
+                            PATH_MAX,
+                            "%s%s",
+                            dir_name,
+                            File::PathSeparator());
+  if (written != strlen(dir_name) + strlen(File::PathSeparator())) {
+    free(path);
+    return false;
+  }
+  ParallelDelete walk;
+  walk.Run(path);
+  free(path);
+  return !walk.failed();
 }
 
 
 bool Directory::List(const char* dir_name,
                      bool recursive,
                      DirectoryListing *listing) {
-  bool completed = ListRecursively(dir_name, recursive, listing);
+  // Compute the full path of the directory once. The paths of the
+  // entries are constructed from it during the traversal.
+  char *path = static_cast<char*>(malloc(PATH_MAX));
+  ASSERT(path != NULL);
+  int path_length = 0;
+  if (!ComputeFullPath(dir_name, path, &path_length)) {
+    free(path);
+    PostError(listing, dir_name);
+    return false;
+  }
+  listing->set_root_length(path_length);
+  bool completed;
+  if (recursive && listing->unordered()) {
+    ParallelListing walk(listing);
+    path[path_length] = '\0';
+    walk.Run(path);
+    completed = !walk.failed();
+  } else {
+    int fd = TEMP_FAILURE_RETRY(
+        open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd == -1) {
+      free(path);
+      PostError(listing, dir_name);
+      return false;
+    }
+    completed = ListRecursively(fd,
+                                path,
+                                path_length,
+                                recursive,
+                                listing,
+                                NULL,
+                                NULL);
+  }
+  free(path);
   return completed;
 }
 
@@ -0,0 +1,219 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/globals.h"
+#if !defined(TARGET_OS_WINDOWS)
+#include <limits.h>
+#include <unistd.h>
+#endif
+
+#include "bin/directory.h"
+#include "bin/file.h"
+#include "bin/thread.h"
+#include "include/dart_api.h"
+#include "platform/assert.h"
+#include "vm/benchmark_test.h"
+#include "vm/timer.h"
+#include "vm/unit_test.h"
+
+
+static const intptr_t kListingBenchmarkFiles = 20000;
+
+static dart::Monitor* listing_monitor = NULL;
+static intptr_t listed_entries = 0;
+static bool listing_done = false;
+
+
+// Counts the entries in the listing responses. The benchmark posts
+// null after the listing to find out when all responses are handled.
+static void CountListingResponses(Dart_Port dest_port_id,
+                                  Dart_Port reply_port_id,
+                                  Dart_CObject* message) {
+  MonitorLocker locker(listing_monitor);
+  if (message->type == Dart_CObject::kNull) {
+    listing_done = true;
+    locker.Notify();
+    return;
+  }
+  ASSERT(message->type == Dart_CObject::kArray);
+  Dart_CObject* type = message->value.as_array.values[0];
+  if (type->value.as_int32 == DirectoryListing::kListBatch) {
+    listed_entries += (message->value.as_array.length - 1) / 2;
+  } else if (type->value.as_int32 == DirectoryListing::kListFile ||
+             type->value.as_int32 == DirectoryListing::kListDirectory) {
+    listed_entries++;
+  }
+}
+
+
+UNIT_TEST_CASE(DirectoryListingFilterGlobs) {
+  EXPECT(DirectoryListingFilter::GlobMatches("*.dart", "a.dart", false));
+  EXPECT(!DirectoryListingFilter::GlobMatches("*.dart", "a/b.dart", false));
+  EXPECT(DirectoryListingFilter::GlobMatches("**/*.dart", "a.dart", false));
+  EXPECT(DirectoryListingFilter::GlobMatches("**/*.dart", "a/b.dart", false));
+  EXPECT(DirectoryListingFilter::GlobMatches("a/**/b", "a/b", false));
+  EXPECT(DirectoryListingFilter::GlobMatches("a/**/b", "a/x/y/b", false));
+  EXPECT(!DirectoryListingFilter::GlobMatches("a/**/b", "a/x/c", false));
+  EXPECT(DirectoryListingFilter::GlobMatches("f?[0-9]", "fx7", false));
+  EXPECT(!DirectoryListingFilter::GlobMatches("f?[!0-9]", "fx7", false));
+  // Matching below a directory decides whether it is traversed.
+  EXPECT(DirectoryListingFilter::GlobMatches("src/*.dart", "src", true));
+  EXPECT(!DirectoryListingFilter::GlobMatches("src/*.dart", "lib", true));
+  EXPECT(!DirectoryListingFilter::GlobMatches("src/*.dart", "src/a", true));
+  EXPECT(DirectoryListingFilter::GlobMatches("**/*.dart", "a/b", true));
+}
+
+
+UNIT_TEST_CASE(DirectoryListingFilterBounds) {
+  DirectoryListingFilter filter;
+  filter.AddInclude("**/*.dart");
+  filter.AddExclude("**/packages");
+  filter.SetSizeBounds(10, 100);
+  int64_t stat[DirectoryListing::kStatValues] = { 50, 0, 0, 0 };
+  EXPECT(filter.Matches("a/b.dart", false, stat));
+  EXPECT(!filter.Matches("a/b.txt", false, stat));
+  stat[DirectoryListing::kStatSize] = 500;
+  EXPECT(!filter.Matches("a/b.dart", false, stat));
+  EXPECT(filter.ShouldTraverse("a"));
+  EXPECT(!filter.ShouldTraverse("a/packages"));
+}
+
+
+namespace dart {
+
+// Lists the directory and waits until all responses posted to port
+// have been counted in listed_entries. Returns whether the listing
+// completed.
+static bool ListAndCount(Dart_Port port,
+                         const char* dir_name,
+                         bool recursive,
+                         bool unordered) {
+  listed_entries = 0;
+  listing_done = false;
+  DirectoryListing* listing = new DirectoryListing(port, false, unordered);
+  bool completed = Directory::List(dir_name, recursive, listing);
+  completed = listing->Flush() && completed;
+  delete listing;
+  Dart_CObject done;
+  done.type = Dart_CObject::kNull;
+  Dart_PostCObject(port, &done);
+  MonitorLocker locker(listing_monitor);
+  while (!listing_done) {
+    locker.Wait();
+  }
+  return completed;
+}
+
+
+#if !defined(TARGET_OS_WINDOWS)
+// Creates a file or directory below the directory with the given path
+// and counts it.
+static void CreateEntry(const char* dir_name,
+                        const char* name,
+                        bool is_directory,
+                        char* path,
+                        intptr_t* count) {
+  snprintf(path, PATH_MAX, "%s%s%s", dir_name, File::PathSeparator(), name);
+  if (is_directory) {
+    EXPECT(Directory::Create(path));
+  } else {
+    EXPECT(File::Create(path));
+  }
+  (*count)++;
+}
+
+
+// Walks a nested tree with the parallel recursive listing and delete.
+// The tree holds a link to a directory outside of it, which is listed
+// through but not deleted through.
+UNIT_TEST_CASE(DirectoryParallelWalk) {
+  static const intptr_t kDirectories = 8;
+  static const intptr_t kFiles = 3;
+  char* dir_name = Directory::CreateTemp("");
+  char* outside_name = Directory::CreateTemp("");
+  ASSERT(dir_name != NULL && outside_name != NULL);
+  char parent[PATH_MAX];
+  char path[PATH_MAX];
+  char name[32];
+  intptr_t entries = 0;
+  for (intptr_t i = 0; i < kDirectories; i++) {
+    snprintf(name, sizeof(name), "dir%d", static_cast<int>(i));
+    CreateEntry(dir_name, name, true, parent, &entries);
+    // Each directory holds files and a chain of nested directories.
+    for (intptr_t depth = 0; depth < 3; depth++) {
+      for (intptr_t j = 0; j < kFiles; j++) {
+        snprintf(name, sizeof(name), "file%d", static_cast<int>(j));
+        CreateEntry(parent, name, false, path, &entries);
+      }
+      CreateEntry(parent, "sub", true, path, &entries);
+      strncpy(parent, path, PATH_MAX);
+    }
+  }
+  CreateEntry(dir_name, "file", false, path, &entries);
+  CreateEntry(outside_name, "kept", false, path, &entries);
+  char kept_name[PATH_MAX];
+  strncpy(kept_name, path, PATH_MAX);
+  snprintf(path, PATH_MAX, "%s%slink", dir_name, File::PathSeparator());
+  EXPECT_EQ(0, symlink(outside_name, path));
+  // The link is listed as a directory.
+  entries++;
+
+  listing_monitor = new Monitor();
+  Dart_Port port =
+      Dart_NewNativePort("DirectoryParallelWalk",
+                         CountListingResponses,
+                         false);
+  ASSERT(port != kIllegalPort);
+  EXPECT(ListAndCount(port, dir_name, true, true));
+  EXPECT_EQ(entries, listed_entries);
+  Dart_CloseNativePort(port);
+  delete listing_monitor;
+  listing_monitor = NULL;
+
+  EXPECT(Directory::Delete(dir_name, true));
+  EXPECT_EQ(Directory::DOES_NOT_EXIST, Directory::Exists(dir_name));
+  EXPECT(File::Exists(kept_name));
+  EXPECT(Directory::Delete(outside_name, true));
+  free(outside_name);
+  free(dir_name);
+}
+#endif
+
+
+// Measures listing a large directory from the native listing to the
+// handling of the responses on the receiving port.
+BENCHMARK(DirectoryListing) {
+  char* dir_name = Directory::CreateTemp("");
+  ASSERT(dir_name != NULL);
+  char path[1024];
+  for (intptr_t i = 0; i < kListingBenchmarkFiles; i++) {
+    snprintf(path, sizeof(path), "%s%sfile%d",
+             dir_name, File::PathSeparator(), static_cast<int>(i));
+    File* file = File::Open(path, File::kWriteTruncate);
+    ASSERT(file != NULL);
+    delete file;
+  }
+  listing_monitor = new dart::Monitor();
+  Dart_Port port =
+      Dart_NewNativePort("DirectoryListingBenchmark",
+                         CountListingResponses,
+                         false);
+  ASSERT(port != kIllegalPort);
+
+  Timer timer(true, "Directory listing benchmark");
+  timer.Start();
+  bool completed = ListAndCount(port, dir_name, false, false);
+  timer.Stop();
+  ASSERT(completed);
+  ASSERT(listed_entries == kListingBenchmarkFiles);
+  benchmark->set_score(timer.TotalElapsedTime());
+
+  Dart_CloseNativePort(port);
+  delete listing_monitor;
+  listing_monitor = NULL;
+  Directory::Delete(dir_name, true);
+  free(dir_name);
+}
+
+}  // namespace dart
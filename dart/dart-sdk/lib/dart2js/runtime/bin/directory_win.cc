@@ -42,6 +42,7 @@ static bool DeleteRecursively(const char* dir_name);
 static bool HandleDir(char* dir_name,
                       char* path,
                       int path_length,
+                      const int64_t* stat,
                       bool recursive,
                       DirectoryListing* listing) {
   if (strcmp(dir_name, ".") != 0 &&
@@ -53,9 +54,12 @@ static bool HandleDir(char* dir_name,
     if (written != strlen(dir_name)) {
       return false;
     }
-    bool ok = listing->HandleDirectory(path);
-    if (!ok) return ok;
-    if (recursive) {
+    if (listing->Matches(path, true, stat)) {
+      bool ok = listing->HandleDirectory(path, stat);
+      if (!ok) return ok;
+    }
+    // Directories the filter rules out are never opened.
+    if (recursive && listing->ShouldTraverse(path)) {
       return ListRecursively(path, recursive, listing);
     }
   }
@@ -66,6 +70,7 @@ static bool HandleDir(char* dir_name,
 static bool HandleFile(char* file_name,
                        char* path,
                        int path_length,
+                       const int64_t* stat,
                        DirectoryListing* listing) {
   size_t written = snprintf(path + path_length,
                             MAX_PATH - path_length,
@@ -74,7 +79,31 @@ static bool HandleFile(char* file_name,
   if (written != strlen(file_name)) {
     return false;
   };
-  return listing->HandleFile(path);
+  if (!listing->Matches(path, false, stat)) {
+    return true;
+  }
+  return listing->HandleFile(path, stat);
+}
+
+
+// The find data already holds the size, modification time and
+// attributes of the entry so no extra system calls are needed when the
+// listing includes stats.
+static void FillListingStat(LPWIN32_FIND_DATA find_file_data, int64_t* stat) {
+  static const int64_t kTimeEpoc = 116444736000000000LL;
+  ULARGE_INTEGER size;
+  size.LowPart = find_file_data->nFileSizeLow;
+  size.HighPart = find_file_data->nFileSizeHigh;
+  ULARGE_INTEGER modified;
+  modified.LowPart = find_file_data->ftLastWriteTime.dwLowDateTime;
+  modified.HighPart = find_file_data->ftLastWriteTime.dwHighDateTime;
+  bool read_only =
+      (find_file_data->dwFileAttributes & FILE_ATTRIBUTE_READONLY) != 0;
+  stat[DirectoryListing::kStatSize] = size.QuadPart;
+  stat[DirectoryListing::kStatModified] =
+      (static_cast<int64_t>(modified.QuadPart) - kTimeEpoc) / 10000;
+  stat[DirectoryListing::kStatMode] = read_only ? 0444 : 0666;
+  stat[DirectoryListing::kStatInode] = 0;
 }
 
 
@@ -83,15 +112,24 @@ static bool HandleEntry(LPWIN32_FIND_DATA find_file_data,
                         int path_length,
                         bool recursive,
                         DirectoryListing* listing) {
+  int64_t stat[DirectoryListing::kStatValues];
+  if (listing->needs_stat()) {
+    FillListingStat(find_file_data, stat);
+  }
   DWORD attributes = find_file_data->dwFileAttributes;
   if ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
     return HandleDir(find_file_data->cFileName,
                      path,
                      path_length,
+                     stat,
                      recursive,
                      listing);
   } else {
-    return HandleFile(find_file_data->cFileName, path, path_length, listing);
+    return HandleFile(find_file_data->cFileName,
+                      path,
+                      path_length,
+                      stat,
+                      listing);
   }
 }
 
@@ -279,6 +317,14 @@ static bool DeleteRecursively(const char* dir_name) {
 bool Directory::List(const char* dir_name,
                      bool recursive,
                      DirectoryListing* listing) {
+  // The paths of the entries start with the full path of the directory
+  // followed by a separator.
+  char* path = static_cast<char*>(malloc(MAX_PATH));
+  int path_length = 0;
+  if (ComputeFullSearchPath(dir_name, path, &path_length)) {
+    listing->set_root_length(path_length - 1);
+  }
+  free(path);
   bool completed = ListRecursively(dir_name, recursive, listing);
   return completed;
 }
@@ -13,7 +13,7 @@ static const intptr_t kNativeEventHandlerFieldIndex = 0;
 /*
  * Returns the reference of the EventHandler stored in the native field.
  */
-static EventHandler* GetEventHandler(Dart_Handle handle) {
+EventHandler* EventHandler::FromDartObject(Dart_Handle handle) {
   intptr_t value = 0;
   Dart_Handle result = Dart_GetNativeInstanceField(
       handle, kNativeEventHandlerFieldIndex, &value);
@@ -52,18 +52,21 @@ void FUNCTION_NAME(EventHandler_Start)(Dart_NativeArguments args) {
 
 /*
  * Send data to the EventHandler thread to register for a given instance
- * args[1] a ReceivePort args[2] with a notification event args[3]. args[0]
- * holds the reference to the dart EventHandler object.
+ * args[1] a ReceivePort args[2] with a notification event args[3]. The
+ * set timeout commands carry the timeout in milliseconds in args[4].
+ * args[0] holds the reference to the dart EventHandler object.
  */
 void FUNCTION_NAME(EventHandler_SendData)(Dart_NativeArguments args) {
   Dart_EnterScope();
   Dart_Handle handle = Dart_GetNativeArgument(args, 0);
-  EventHandler* event_handler = GetEventHandler(handle);
+  EventHandler* event_handler = EventHandler::FromDartObject(handle);
   intptr_t id = DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 1));
   handle = Dart_GetNativeArgument(args, 2);
   Dart_Port dart_port =
       DartUtils::GetIntegerField(handle, DartUtils::kIdFieldName);
   intptr_t data = DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 3));
-  event_handler->SendData(id, dart_port, data);
+  int64_t timeout = 0;
+  DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 4), &timeout);
+  event_handler->SendData(id, dart_port, data, timeout);
   Dart_ExitScope();
 }
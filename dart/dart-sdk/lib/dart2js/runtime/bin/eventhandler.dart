@@ -14,13 +14,16 @@ class _EventHandler extends NativeFieldWrapperClass1 {
 
   void _doStart() native "EventHandler_Start";
 
-  static _sendData(int id, ReceivePort receivePort, int data) {
+  // The set timeout commands carry the timeout in milliseconds in
+  // [timeout].
+  static _sendData(int id, ReceivePort receivePort, int data,
+                   [int timeout = 0]) {
     if (_eventHandler !== null) {
-      _eventHandler._doSendData(id, receivePort, data);
+      _eventHandler._doSendData(id, receivePort, data, timeout);
     }
   }
 
-  void _doSendData(int id, ReceivePort receivePort, int data)
+  void _doSendData(int id, ReceivePort receivePort, int data, int timeout)
       native "EventHandler_SendData";
 
   static _EventHandler _eventHandler;
@@ -16,13 +16,30 @@ enum MessageFlags {
   kOutEvent = 1,
   kErrorEvent = 2,
   kCloseEvent = 3,
+  kReleaseEvent = 4,
+  kTimeoutEvent = 5,
   kCloseCommand = 8,
   kShutdownReadCommand = 9,
   kShutdownWriteCommand = 10,
+  kSetReadTimeoutCommand = 11,
+  kSetWriteTimeoutCommand = 12,
   kListeningSocket = 16,
   kPipe = 17,
+  kProcessExit = 18,
+  kFileSystemWatch = 19,
 };
 
+// With kProcessExit the id is a process descriptor or, on kernels
+// without process descriptors, an exit code pipe (Linux only). When
+// the process exits the event handler reaps it, or reads the exit code
+// from the pipe, and posts its exit code, negated if the process was
+// killed by a signal, instead of an event mask.
+//
+// With kFileSystemWatch the id is the shared file system watcher
+// instance (Linux only). It stays registered once it has been
+// registered, and its changes are posted to the ports of the watches
+// instead of to the port it was registered with.
+
 
 // The event handler delegation class is OS specific.
 #if defined(TARGET_OS_LINUX)
@@ -37,8 +54,13 @@ enum MessageFlags {
 
 class EventHandler {
  public:
-  void SendData(intptr_t id, Dart_Port dart_port, intptr_t data) {
-    delegate_.SendData(id, dart_port, data);
+  // The set timeout commands carry the timeout in milliseconds in
+  // timeout, which is ignored for all other messages.
+  void SendData(intptr_t id,
+                Dart_Port dart_port,
+                intptr_t data,
+                int64_t timeout) {
+    delegate_.SendData(id, dart_port, data, timeout);
   }
 
   static EventHandler* StartEventHandler() {
@@ -47,6 +69,10 @@ class EventHandler {
     return handler;
   }
 
+  // Returns the EventHandler stored in the native field of a Dart
+  // _EventHandler object.
+  static EventHandler* FromDartObject(Dart_Handle handle);
+
  private:
   EventHandlerImplementation delegate_;
 };
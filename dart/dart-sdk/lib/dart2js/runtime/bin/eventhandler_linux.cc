@@ -5,17 +5,23 @@
 #include "bin/eventhandler.h"
 
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "bin/dartutils.h"
 #include "bin/fdutils.h"
+#include "bin/file_system_watcher.h"
 #include "bin/hashmap.h"
+#include "bin/process.h"
+#include "bin/socket.h"
 #include "platform/thread.h"
 #include "platform/utils.h"
 
@@ -53,6 +59,165 @@ intptr_t SocketData::GetPollEvents() {
 }
 
 
+int64_t SocketData::GetTimeout() {
+  int64_t timeout = 0;
+  if (!IsClosedRead() && ((mask_ & (1 << kInEvent)) != 0)) {
+    timeout = read_timeout_;
+  }
+  if (!IsClosedWrite() && ((mask_ & (1 << kOutEvent)) != 0)) {
+    if ((timeout == 0) ||
+        ((write_timeout_ != 0) && (write_timeout_ < timeout))) {
+      timeout = write_timeout_;
+    }
+  }
+  return timeout;
+}
+
+
+TimeoutWheel::TimeoutWheel()
+    : count_(0), current_tick_(-1), expiry_tick_(-1) {
+  for (intptr_t i = 0; i < kSlots; i++) {
+    slots_[i] = NULL;
+  }
+}
+
+
+void TimeoutWheel::Insert(SocketData* sd, int64_t deadline) {
+  ASSERT(sd->deadline() == -1);
+  if (count_ == 0) {
+    current_tick_ = GetCurrentTimeMilliseconds() / kTickMilliseconds;
+    expiry_tick_ = -1;
+  }
+  int64_t tick = DeadlineTick(deadline);
+  if (tick <= current_tick_) tick = current_tick_ + 1;
+  if (count_ == 0 || (expiry_tick_ != -1 && tick < expiry_tick_)) {
+    expiry_tick_ = tick;
+  }
+  intptr_t slot = tick % kSlots;
+  sd->set_deadline(deadline);
+  sd->set_wheel_slot(slot);
+  sd->set_wheel_prev(NULL);
+  sd->set_wheel_next(slots_[slot]);
+  if (slots_[slot] != NULL) slots_[slot]->set_wheel_prev(sd);
+  slots_[slot] = sd;
+  count_++;
+}
+
+
+void TimeoutWheel::Remove(SocketData* sd) {
+  if (sd->deadline() == -1) return;
+  if (sd->wheel_prev() != NULL) {
+    sd->wheel_prev()->set_wheel_next(sd->wheel_next());
+  } else {
+    ASSERT(slots_[sd->wheel_slot()] == sd);
+    slots_[sd->wheel_slot()] = sd->wheel_next();
+  }
+  if (sd->wheel_next() != NULL) {
+    sd->wheel_next()->set_wheel_prev(sd->wheel_prev());
+  }
+  sd->set_deadline(-1);
+  sd->set_wheel_next(NULL);
+  sd->set_wheel_prev(NULL);
+  count_--;
+}
+
+
+int64_t TimeoutWheel::NextExpiry() {
+  ASSERT(count_ > 0);
+  if (expiry_tick_ == -1) {
+    // Find the first slot in the coming turn of the wheel holding a
+    // deadline which expires in that turn. If there is none all
+    // deadlines are further away and have been seen, so the earliest
+    // of them is next.
+    int64_t earliest = -1;
+    for (int64_t tick = current_tick_ + 1;
+         tick <= current_tick_ + kSlots && expiry_tick_ == -1;
+         tick++) {
+      for (SocketData* sd = slots_[tick % kSlots];
+           sd != NULL;
+           sd = sd->wheel_next()) {
+        int64_t deadline_tick = DeadlineTick(sd->deadline());
+        if (deadline_tick <= tick) {
+          expiry_tick_ = tick;
+          break;
+        }
+        if (earliest == -1 || deadline_tick < earliest) {
+          earliest = deadline_tick;
+        }
+      }
+    }
+    if (expiry_tick_ == -1) expiry_tick_ = earliest;
+  }
+  return expiry_tick_ * kTickMilliseconds;
+}
+
+
+SocketData* TimeoutWheel::Advance(int64_t now) {
+  SocketData* expired = NULL;
+  int64_t now_tick = now / kTickMilliseconds;
+  // Visiting each slot once is enough however long it has been since
+  // the last tick.
+  int64_t first_tick = current_tick_ + 1;
+  if (now_tick - first_tick >= kSlots) first_tick = now_tick - kSlots + 1;
+  for (int64_t tick = first_tick; tick <= now_tick && count_ > 0; tick++) {
+    SocketData* current = slots_[tick % kSlots];
+    while (current != NULL) {
+      SocketData* next = current->wheel_next();
+      if (current->deadline() <= now) {
+        Remove(current);
+        current->set_wheel_next(expired);
+        expired = current;
+      }
+      current = next;
+    }
+  }
+  if (now_tick > current_tick_) current_tick_ = now_tick;
+  if (expiry_tick_ != -1 && expiry_tick_ <= current_tick_) {
+    expiry_tick_ = -1;
+  }
+  return expired;
+}
+
+
+// Reaps the process with the given pid if it has exited and returns
+// its exit code, negated if the process was killed by a signal.
+// Returns false if the process is still running.
+static bool ReapProcess(pid_t pid, int* exit_code) {
+  int status = 0;
+  pid_t result = TEMP_FAILURE_RETRY(waitpid(pid, &status, WNOHANG));
+  if (result == 0) {
+    return false;
+  }
+  *exit_code = 0;
+  if (result == -1) {
+    // If SIGCHLD is ignored the process is reaped by the kernel and
+    // its exit code is lost.
+    if (errno != ECHILD) {
+      perror("Failed waiting for process");
+    }
+  } else if (WIFEXITED(status)) {
+    *exit_code = WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    *exit_code = -WTERMSIG(status);
+  }
+  return true;
+}
+
+
+// Reads the exit code written by the exit code handler of the process
+// module to the exit code pipe of a process, negated if the process
+// was killed by a signal.
+static int ReadExitCode(intptr_t fd) {
+  int message[2];
+  ssize_t bytes_read = FDUtils::ReadFromBlocking(fd, message, sizeof(message));
+  if (bytes_read != sizeof(message)) {
+    perror("Failed reading process exit code");
+    return 0;
+  }
+  return (message[1] == 0) ? message[0] : -message[0];
+}
+
+
 // Unregister the file descriptor for a SocketData structure with epoll.
 static void RemoveFromEpollInstance(intptr_t epoll_fd_, SocketData* sd) {
   if (sd->tracked_by_epoll()) {
@@ -151,11 +316,13 @@ SocketData* EventHandlerImplementation::GetSocketData(intptr_t fd) {
 
 void EventHandlerImplementation::WakeupHandler(intptr_t id,
                                                Dart_Port dart_port,
-                                               int64_t data) {
+                                               int64_t data,
+                                               int64_t timeout) {
   InterruptMessage msg;
   msg.id = id;
   msg.dart_port = dart_port;
   msg.data = data;
+  msg.timeout = timeout;
   intptr_t result =
       FDUtils::WriteToBlocking(interrupt_fds_[1], &msg, kInterruptMessageSize);
   if (result != kInterruptMessageSize) {
@@ -207,22 +374,65 @@ void EventHandlerImplementation::HandleInterruptFd() {
         UpdateEpollInstance(epoll_fd_, sd);
       } else if ((msg.data & (1 << kCloseCommand)) != 0) {
         ASSERT(msg.data == (1 << kCloseCommand));
-        // Close the socket and free system resources and move on to
-        // next message.
-        RemoveFromEpollInstance(epoll_fd_, sd);
-        intptr_t fd = sd->fd();
-        sd->Close();
-        socket_map_.Remove(GetHashmapKeyFromFd(fd), GetHashmapHashFromFd(fd));
-        delete sd;
+        if (sd->IsProcessExit() && sd->pid() != 0 &&
+            !sd->IsProcessReaped()) {
+          // Nobody waits for the exit code any longer but the process
+          // still has to be reaped when it exits. A process with an
+          // exit code pipe is reaped by the exit code handler.
+          sd->MarkProcessOrphaned();
+          UpdateEpollInstance(epoll_fd_, sd);
+        } else {
+          // Close the socket and free system resources and move on to
+          // next message.
+          CloseSocketData(sd);
+        }
+      } else if ((msg.data & (1 << kSetReadTimeoutCommand)) != 0) {
+        sd->set_read_timeout(msg.timeout);
+        UpdateDeadline(sd);
+      } else if ((msg.data & (1 << kSetWriteTimeoutCommand)) != 0) {
+        sd->set_write_timeout(msg.timeout);
+        UpdateDeadline(sd);
       } else {
         // Setup events to wait for.
         sd->SetPortAndMask(msg.dart_port, msg.data);
+        if (sd->IsProcessExit() && sd->pid() == 0) {
+          sd->set_pid(Process::TakeProcessDescriptorPid(sd->fd()));
+        }
         UpdateEpollInstance(epoll_fd_, sd);
+        UpdateDeadline(sd);
       }
     }
   }
 }
 
+void EventHandlerImplementation::HandleProcessExit(SocketData* sd) {
+  int exit_code = 0;
+  if (sd->pid() == 0) {
+    exit_code = ReadExitCode(sd->fd());
+  } else if (!ReapProcess(sd->pid(), &exit_code)) {
+    return;
+  }
+  RemoveFromEpollInstance(epoll_fd_, sd);
+  sd->MarkProcessReaped();
+  if (sd->IsProcessOrphaned()) {
+    CloseSocketData(sd);
+  } else {
+    // The exit event is closed when Dart code sends the close command
+    // so its number is not reused before that.
+    DartUtils::PostInt32(sd->port(), exit_code);
+  }
+}
+
+
+void EventHandlerImplementation::CloseSocketData(SocketData* sd) {
+  RemoveFromEpollInstance(epoll_fd_, sd);
+  timeout_wheel_.Remove(sd);
+  intptr_t fd = sd->fd();
+  sd->Close();
+  socket_map_.Remove(GetHashmapKeyFromFd(fd), GetHashmapHashFromFd(fd));
+  delete sd;
+}
+
 #ifdef DEBUG_POLL
 static void PrintEventMask(intptr_t fd, intptr_t events) {
   printf("%d ", fd);
@@ -243,6 +453,39 @@ static void PrintEventMask(intptr_t fd, intptr_t events) {
 }
 #endif
 
+// Posts the completed zero-copy writes of the socket to Dart as a
+// list holding the release event mask followed by the first and last
+// id of each completed range. Returns whether any were posted.
+bool EventHandlerImplementation::PostZeroCopyCompletions(SocketData* sd) {
+  static const intptr_t kMaxRanges = 16;
+  uint32_t ranges[2 * kMaxRanges];
+  Dart_CObject mask;
+  mask.type = Dart_CObject::kInt32;
+  mask.value.as_int32 = 1 << kReleaseEvent;
+  Dart_CObject ids[2 * kMaxRanges];
+  Dart_CObject* values[2 * kMaxRanges + 1];
+  values[0] = &mask;
+  bool posted = false;
+  intptr_t count = 0;
+  do {
+    count = Socket::ReadZeroCopyCompletions(sd->fd(), ranges, kMaxRanges);
+    if (count == 0) break;
+    for (intptr_t i = 0; i < 2 * count; i++) {
+      ids[i].type = Dart_CObject::kInt64;
+      ids[i].value.as_int64 = ranges[i];
+      values[i + 1] = &ids[i];
+    }
+    Dart_CObject message;
+    message.type = Dart_CObject::kArray;
+    message.value.as_array.length = 2 * count + 1;
+    message.value.as_array.values = values;
+    Dart_PostCObject(sd->port(), &message);
+    posted = true;
+  } while (count == kMaxRanges);
+  return posted;
+}
+
+
 intptr_t EventHandlerImplementation::GetPollEvents(intptr_t events,
                                                    SocketData* sd) {
 #ifdef DEBUG_POLL
@@ -259,6 +502,23 @@ intptr_t EventHandlerImplementation::GetPollEvents(intptr_t events,
       if (event_mask == 0) event_mask |= (1 << kInEvent);
     }
   } else {
+    // Completions of zero-copy writes are reported through the error
+    // queue which also raises EPOLLERR. Only treat EPOLLERR as an
+    // error if it is still raised after the completions have been
+    // consumed.
+    if (((events & EPOLLERR) != 0) &&
+        !sd->IsPipe() &&
+        PostZeroCopyCompletions(sd)) {
+      struct pollfd poll_fd;
+      poll_fd.fd = sd->fd();
+      poll_fd.events = 0;
+      poll_fd.revents = 0;
+      if ((TEMP_FAILURE_RETRY(poll(&poll_fd, 1, 0)) == 0) ||
+          ((poll_fd.revents & POLLERR) == 0)) {
+        events &= ~EPOLLERR;
+      }
+    }
+
     // Prioritize data events over close and error events.
     if ((events & EPOLLIN) != 0) {
       if (FDUtils::AvailableBytes(sd->fd()) != 0) {
@@ -330,12 +590,21 @@ void EventHandlerImplementation::HandleEvents(struct epoll_event* events,
   for (int i = 0; i < size; i++) {
     if (events[i].data.ptr != NULL) {
       SocketData* sd = reinterpret_cast<SocketData*>(events[i].data.ptr);
+      if (sd->IsProcessExit()) {
+        HandleProcessExit(sd);
+        continue;
+      }
+      if (sd->IsFileSystemWatch()) {
+        FileSystemWatcher::DispatchEvents(sd->fd());
+        continue;
+      }
       intptr_t event_mask = GetPollEvents(events[i].events, sd);
       if (event_mask != 0) {
         // Unregister events for the file descriptor. Events will be
         // registered again when the current event has been handled in
         // Dart code.
         RemoveFromEpollInstance(epoll_fd_, sd);
+        timeout_wheel_.Remove(sd);
         Dart_Port port = sd->port();
         ASSERT(port != 0);
         DartUtils::PostInt32(port, event_mask);
@@ -346,16 +615,50 @@ void EventHandlerImplementation::HandleEvents(struct epoll_event* events,
 }
 
 
+void EventHandlerImplementation::UpdateDeadline(SocketData* sd) {
+  // The deadline is restarted every time the events to wait for are
+  // registered, so a read timeout measures the time without data.
+  timeout_wheel_.Remove(sd);
+  int64_t timeout = sd->GetTimeout();
+  if (timeout > 0 && sd->port() != 0) {
+    timeout_wheel_.Insert(sd, GetCurrentTimeMilliseconds() + timeout);
+  }
+}
+
+
 intptr_t EventHandlerImplementation::GetTimeout() {
-  if (timeout_ == kInfinityTimeout) {
+  int64_t next_timeout = timeout_;
+  if (!timeout_wheel_.IsEmpty()) {
+    int64_t next_expiry = timeout_wheel_.NextExpiry();
+    if (next_timeout == kInfinityTimeout || next_expiry < next_timeout) {
+      next_timeout = next_expiry;
+    }
+  }
+  if (next_timeout == kInfinityTimeout) {
     return kInfinityTimeout;
   }
-  intptr_t millis = timeout_ - GetCurrentTimeMilliseconds();
+  intptr_t millis = next_timeout - GetCurrentTimeMilliseconds();
   return (millis < 0) ? 0 : millis;
 }
 
 
+void EventHandlerImplementation::HandleDeadlines() {
+  if (timeout_wheel_.IsEmpty()) return;
+  SocketData* sd = timeout_wheel_.Advance(GetCurrentTimeMilliseconds());
+  while (sd != NULL) {
+    SocketData* next = sd->wheel_next();
+    sd->set_wheel_next(NULL);
+    // As for other events the socket is unregistered until Dart code
+    // has handled the timeout.
+    RemoveFromEpollInstance(epoll_fd_, sd);
+    DartUtils::PostInt32(sd->port(), 1 << kTimeoutEvent);
+    sd = next;
+  }
+}
+
+
 void EventHandlerImplementation::HandleTimeout() {
+  HandleDeadlines();
   if (timeout_ != kInfinityTimeout) {
     intptr_t millis = timeout_ - GetCurrentTimeMilliseconds();
     if (millis <= 0) {
@@ -403,8 +706,9 @@ void EventHandlerImplementation::StartEventHandler() {
 
 void EventHandlerImplementation::SendData(intptr_t id,
                                           Dart_Port dart_port,
-                                          intptr_t data) {
-  WakeupHandler(id, dart_port, data);
+                                          intptr_t data,
+                                          int64_t timeout) {
+  WakeupHandler(id, dart_port, data, timeout);
 }
 
 
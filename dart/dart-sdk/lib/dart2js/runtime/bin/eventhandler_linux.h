@@ -19,19 +19,33 @@ class InterruptMessage {
   intptr_t id;
   Dart_Port dart_port;
   int64_t data;
+  int64_t timeout;
 };
 
 
 enum PortDataFlags {
   kClosedRead = 0,
   kClosedWrite = 1,
+  kProcessReaped = 2,
+  kProcessOrphaned = 3,
 };
 
 
 class SocketData {
  public:
   explicit SocketData(intptr_t fd)
-      : tracked_by_epoll_(false), fd_(fd), port_(0), mask_(0), flags_(0) {
+      : tracked_by_epoll_(false),
+        fd_(fd),
+        port_(0),
+        mask_(0),
+        flags_(0),
+        read_timeout_(0),
+        write_timeout_(0),
+        deadline_(-1),
+        pid_(0),
+        wheel_slot_(0),
+        wheel_next_(NULL),
+        wheel_prev_(NULL) {
     ASSERT(fd_ != -1);
   }
 
@@ -57,11 +71,23 @@ class SocketData {
 
   bool IsListeningSocket() { return (mask_ & (1 << kListeningSocket)) != 0; }
   bool IsPipe() { return (mask_ & (1 << kPipe)) != 0; }
+  bool IsProcessExit() { return (mask_ & (1 << kProcessExit)) != 0; }
+  bool IsFileSystemWatch() {
+    return (mask_ & (1 << kFileSystemWatch)) != 0;
+  }
   bool IsClosedRead() { return (flags_ & (1 << kClosedRead)) != 0; }
   bool IsClosedWrite() { return (flags_ & (1 << kClosedWrite)) != 0; }
+  bool IsProcessReaped() { return (flags_ & (1 << kProcessReaped)) != 0; }
+  // A process descriptor closed from Dart before the process exited
+  // stays registered so the process is reaped when it exits.
+  bool IsProcessOrphaned() {
+    return (flags_ & (1 << kProcessOrphaned)) != 0;
+  }
 
   void MarkClosedRead() { flags_ |= (1 << kClosedRead); }
   void MarkClosedWrite() { flags_ |= (1 << kClosedWrite); }
+  void MarkProcessReaped() { flags_ |= (1 << kProcessReaped); }
+  void MarkProcessOrphaned() { flags_ |= (1 << kProcessOrphaned); }
 
   void SetPortAndMask(Dart_Port port, intptr_t mask) {
     ASSERT(fd_ != -1);
@@ -69,11 +95,29 @@ class SocketData {
     mask_ = mask;
   }
 
+  // Returns the timeout in milliseconds for the events currently
+  // waited for or 0 if there is none. The read timeout applies while
+  // waiting for data and the write timeout while waiting for the
+  // socket to become writable.
+  int64_t GetTimeout();
+
   intptr_t fd() { return fd_; }
   Dart_Port port() { return port_; }
   intptr_t mask() { return mask_; }
   bool tracked_by_epoll() { return tracked_by_epoll_; }
   void set_tracked_by_epoll(bool value) { tracked_by_epoll_ = value; }
+  void set_read_timeout(int64_t value) { read_timeout_ = value; }
+  void set_write_timeout(int64_t value) { write_timeout_ = value; }
+  int64_t deadline() { return deadline_; }
+  void set_deadline(int64_t value) { deadline_ = value; }
+  intptr_t pid() { return pid_; }
+  void set_pid(intptr_t pid) { pid_ = pid; }
+  intptr_t wheel_slot() { return wheel_slot_; }
+  void set_wheel_slot(intptr_t slot) { wheel_slot_ = slot; }
+  SocketData* wheel_next() { return wheel_next_; }
+  void set_wheel_next(SocketData* sd) { wheel_next_ = sd; }
+  SocketData* wheel_prev() { return wheel_prev_; }
+  void set_wheel_prev(SocketData* sd) { wheel_prev_ = sd; }
 
  private:
   bool tracked_by_epoll_;
@@ -81,6 +125,56 @@ class SocketData {
   Dart_Port port_;
   intptr_t mask_;
   intptr_t flags_;
+  int64_t read_timeout_;
+  int64_t write_timeout_;
+  // Absolute time in milliseconds of the deadline or -1 if the socket
+  // is not in the timeout wheel.
+  int64_t deadline_;
+  // With kProcessExit the pid of the process of a process descriptor
+  // or 0 for an exit code pipe.
+  intptr_t pid_;
+  intptr_t wheel_slot_;
+  SocketData* wheel_next_;
+  SocketData* wheel_prev_;
+};
+
+
+// Coarse timing wheel holding the deadlines of all sockets waiting
+// for events with a timeout. Deadlines are rounded up to the next
+// tick. Sockets with a deadline more than a full turn of the wheel
+// away stay in their slot until the wheel has come around far
+// enough.
+class TimeoutWheel {
+ public:
+  static const intptr_t kTickMilliseconds = 100;
+  static const intptr_t kSlots = 256;
+
+  TimeoutWheel();
+
+  void Insert(SocketData* sd, int64_t deadline);
+  void Remove(SocketData* sd);
+  bool IsEmpty() { return count_ == 0; }
+  // Returns the absolute time in milliseconds of the first tick at
+  // which a deadline expires. Ticks without expiring deadlines are
+  // skipped. Must not be called on an empty wheel.
+  int64_t NextExpiry();
+  // Advances the wheel to the given time. Removes the sockets whose
+  // deadline has passed and returns them linked through wheel_next.
+  SocketData* Advance(int64_t now);
+
+ private:
+  static int64_t DeadlineTick(int64_t deadline) {
+    return (deadline + kTickMilliseconds - 1) / kTickMilliseconds;
+  }
+
+  SocketData* slots_[kSlots];
+  intptr_t count_;
+  // Number of the last tick processed.
+  int64_t current_tick_;
+  // First tick at which a deadline expires or -1 if it has to be
+  // found again. After removals it can be earlier than needed, which
+  // only costs an extra wakeup.
+  int64_t expiry_tick_;
 };
 
 
@@ -92,7 +186,10 @@ class EventHandlerImplementation {
   // Gets the socket data structure for a given file
   // descriptor. Creates a new one if one is not found.
   SocketData* GetSocketData(intptr_t fd);
-  void SendData(intptr_t id, Dart_Port dart_port, intptr_t data);
+  void SendData(intptr_t id,
+                Dart_Port dart_port,
+                intptr_t data,
+                int64_t timeout);
   void StartEventHandler();
 
  private:
@@ -101,14 +198,23 @@ class EventHandlerImplementation {
   void HandleEvents(struct epoll_event* events, int size);
   void HandleTimeout();
   static void Poll(uword args);
-  void WakeupHandler(intptr_t id, Dart_Port dart_port, int64_t data);
+  void WakeupHandler(intptr_t id,
+                     Dart_Port dart_port,
+                     int64_t data,
+                     int64_t timeout);
   void HandleInterruptFd();
+  void HandleProcessExit(SocketData* sd);
+  void CloseSocketData(SocketData* sd);
   void SetPort(intptr_t fd, Dart_Port dart_port, intptr_t mask);
+  void UpdateDeadline(SocketData* sd);
+  void HandleDeadlines();
   intptr_t GetPollEvents(intptr_t events, SocketData* sd);
+  bool PostZeroCopyCompletions(SocketData* sd);
   static void* GetHashmapKeyFromFd(intptr_t fd);
   static uint32_t GetHashmapHashFromFd(intptr_t fd);
 
   HashMap socket_map_;
+  TimeoutWheel timeout_wheel_;
   int64_t timeout_;  // Time for next timeout.
   Dart_Port timeout_port_;
   int interrupt_fds_[2];
@@ -163,11 +163,13 @@ SocketData* EventHandlerImplementation::GetSocketData(intptr_t fd) {
 
 void EventHandlerImplementation::WakeupHandler(intptr_t id,
                                                Dart_Port dart_port,
-                                               int64_t data) {
+                                               int64_t data,
+                                               int64_t timeout) {
   InterruptMessage msg;
   msg.id = id;
   msg.dart_port = dart_port;
   msg.data = data;
+  msg.timeout = timeout;
   intptr_t result =
       FDUtils::WriteToBlocking(interrupt_fds_[1], &msg, kInterruptMessageSize);
   if (result != kInterruptMessageSize) {
@@ -225,6 +227,9 @@ void EventHandlerImplementation::HandleInterruptFd() {
         sd->Close();
         socket_map_.Remove(GetHashmapKeyFromFd(fd), GetHashmapHashFromFd(fd));
         delete sd;
+      } else if ((msg.data & ((1 << kSetReadTimeoutCommand) |
+                              (1 << kSetWriteTimeoutCommand))) != 0) {
+        // Socket timeouts are not supported on Mac OS.
       } else {
         // Setup events to wait for.
         sd->SetPortAndMask(msg.dart_port, msg.data);
@@ -396,8 +401,9 @@ void EventHandlerImplementation::StartEventHandler() {
 
 void EventHandlerImplementation::SendData(intptr_t id,
                                           Dart_Port dart_port,
-                                          intptr_t data) {
-  WakeupHandler(id, dart_port, data);
+                                          intptr_t data,
+                                          int64_t timeout) {
+  WakeupHandler(id, dart_port, data, timeout);
 }
 
 
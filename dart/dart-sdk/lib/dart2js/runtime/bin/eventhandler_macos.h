@@ -19,6 +19,7 @@ class InterruptMessage {
   intptr_t id;
   Dart_Port dart_port;
   int64_t data;
+  int64_t timeout;
 };
 
 
@@ -105,7 +106,10 @@ class EventHandlerImplementation {
   // Gets the socket data structure for a given file
   // descriptor. Creates a new one if one is not found.
   SocketData* GetSocketData(intptr_t fd);
-  void SendData(intptr_t id, Dart_Port dart_port, intptr_t data);
+  void SendData(intptr_t id,
+                Dart_Port dart_port,
+                intptr_t data,
+                int64_t timeout);
   void StartEventHandler();
 
  private:
@@ -114,7 +118,10 @@ class EventHandlerImplementation {
   void HandleEvents(struct kevent* events, int size);
   void HandleTimeout();
   static void EventHandlerEntry(uword args);
-  void WakeupHandler(intptr_t id, Dart_Port dart_port, int64_t data);
+  void WakeupHandler(intptr_t id,
+                     Dart_Port dart_port,
+                     int64_t data,
+                     int64_t timeout);
   void HandleInterruptFd();
   void SetPort(intptr_t fd, Dart_Port dart_port, intptr_t mask);
   intptr_t GetEvents(struct kevent* event, SocketData* sd);
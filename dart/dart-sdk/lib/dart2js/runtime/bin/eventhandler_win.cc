@@ -620,6 +620,9 @@ void EventHandlerImplementation::HandleInterrupt(InterruptMessage* msg) {
     // completion thread will use the new timeout value for its next wait.
     timeout_ = msg->data;
     timeout_port_ = msg->dart_port;
+  } else if ((msg->data & ((1 << kSetReadTimeoutCommand) |
+                           (1 << kSetWriteTimeoutCommand))) != 0) {
+    // Socket timeouts are not supported on Windows.
   } else {
     bool delete_handle = false;
     Handle* handle = reinterpret_cast<Handle*>(msg->id);
@@ -841,11 +844,13 @@ DWORD EventHandlerImplementation::GetTimeout() {
 
 void EventHandlerImplementation::SendData(intptr_t id,
                                           Dart_Port dart_port,
-                                          intptr_t data) {
+                                          intptr_t data,
+                                          int64_t timeout) {
   InterruptMessage* msg = new InterruptMessage;
   msg->id = id;
   msg->dart_port = dart_port;
   msg->data = data;
+  msg->timeout = timeout;
   BOOL ok = PostQueuedCompletionStatus(
       completion_port_, 0, NULL, reinterpret_cast<OVERLAPPED*>(msg));
   if (!ok) {
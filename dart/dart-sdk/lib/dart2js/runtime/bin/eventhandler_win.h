@@ -28,6 +28,7 @@ struct InterruptMessage {
   intptr_t id;
   Dart_Port dart_port;
   int64_t data;
+  int64_t timeout;
 };
 
 
@@ -346,7 +347,10 @@ class EventHandlerImplementation {
   EventHandlerImplementation();
   virtual ~EventHandlerImplementation() {}
 
-  void SendData(intptr_t id, Dart_Port dart_port, intptr_t data);
+  void SendData(intptr_t id,
+                Dart_Port dart_port,
+                intptr_t data,
+                int64_t timeout);
   void StartEventHandler();
 
   DWORD GetTimeout();
@@ -6,6 +6,10 @@
 
 #include "bin/builtin.h"
 #include "bin/dartutils.h"
+#include "bin/file_io_engine.h"
+#include "bin/hashmap.h"
+#include "bin/io_buffer_pool.h"
+#include "bin/io_service.h"
 #include "bin/thread.h"
 #include "bin/utils.h"
 
@@ -13,10 +17,6 @@
 
 static const int kMSPerSecond = 1000;
 
-dart::Mutex File::mutex_;
-int File::service_ports_size_ = 0;
-Dart_Port* File::service_ports_ = NULL;
-int File::service_ports_index_ = 0;
 
 bool File::ReadFully(void* buffer, int64_t num_bytes) {
   int64_t remaining = num_bytes;
@@ -48,6 +48,34 @@ bool File::WriteFully(const void* buffer, int64_t num_bytes) {
 }
 
 
+bool File::WriteGatherFully(const void* const* buffers,
+                            const int64_t* lengths,
+                            intptr_t count) {
+  intptr_t index = 0;
+  while (index < count) {
+    int64_t written =
+        WriteGather(buffers + index, lengths + index, count - index);
+    if (written < 0) {
+      return false;
+    }
+    // Skip the buffers which have been written completely.
+    while (index < count && written >= lengths[index]) {
+      written -= lengths[index];
+      index++;
+    }
+    if (written > 0) {
+      // Write the rest of a partially written buffer on its own.
+      const char* rest = reinterpret_cast<const char*>(buffers[index]);
+      if (!WriteFully(rest + written, lengths[index] - written)) {
+        return false;
+      }
+      index++;
+    }
+  }
+  return true;
+}
+
+
 File::FileOpenMode File::DartModeToFileMode(DartFileOpenMode mode) {
   ASSERT(mode == File::kDartRead ||
          mode == File::kDartWrite ||
@@ -199,12 +227,12 @@ void FUNCTION_NAME(File_ReadList)(Dart_NativeArguments args) {
   Dart_Handle result = Dart_ListLength(buffer_obj, &array_len);
   if (Dart_IsError(result)) Dart_PropagateError(result);
   ASSERT((offset + length) <= array_len);
-  uint8_t* buffer = new uint8_t[length];
+  uint8_t* buffer = IOBufferPool::Allocate(length);
   int bytes_read = file->Read(reinterpret_cast<void*>(buffer), length);
   if (bytes_read >= 0) {
     result = Dart_ListSetAsBytes(buffer_obj, offset, buffer, bytes_read);
     if (Dart_IsError(result)) {
-      delete[] buffer;
+      IOBufferPool::Free(buffer);
       Dart_PropagateError(result);
     }
     Dart_SetReturnValue(args, Dart_NewInteger(bytes_read));
@@ -213,7 +241,7 @@ void FUNCTION_NAME(File_ReadList)(Dart_NativeArguments args) {
     if (Dart_IsError(err)) Dart_PropagateError(err);
     Dart_SetReturnValue(args, err);
   }
-  delete[] buffer;
+  IOBufferPool::Free(buffer);
   Dart_ExitScope();
 }
 
@@ -238,10 +266,10 @@ void FUNCTION_NAME(File_WriteList)(Dart_NativeArguments args) {
   Dart_Handle result = Dart_ListLength(buffer_obj, &buffer_len);
   if (Dart_IsError(result)) Dart_PropagateError(result);
   ASSERT((offset + length) <= buffer_len);
-  uint8_t* buffer = new uint8_t[length];
+  uint8_t* buffer = IOBufferPool::Allocate(length);
   result = Dart_ListGetAsBytes(buffer_obj, offset, buffer, length);
   if (Dart_IsError(result)) {
-    delete[] buffer;
+    IOBufferPool::Free(buffer);
     Dart_PropagateError(result);
   }
   int bytes_written = file->Write(reinterpret_cast<void*>(buffer), length);
@@ -252,7 +280,107 @@ void FUNCTION_NAME(File_WriteList)(Dart_NativeArguments args) {
     if (Dart_IsError(err)) Dart_PropagateError(err);
     Dart_SetReturnValue(args, err);
   }
-  delete[] buffer;
+  IOBufferPool::Free(buffer);
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(File_ReadAt)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  File* file = reinterpret_cast<File*>(value);
+  ASSERT(file != NULL);
+  Dart_Handle buffer_obj = Dart_GetNativeArgument(args, 1);
+  ASSERT(Dart_IsList(buffer_obj));
+  // Offset and length arguments are checked in Dart code to be
+  // integers and have the property that (offset + length) <=
+  // list.length. Therefore, it is safe to extract their value as
+  // 64-bit integers.
+  int64_t offset =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 2));
+  int64_t length =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 3));
+  int64_t position = 0;
+  if (!DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 4), &position) ||
+      position < 0) {
+    OSError os_error(-1, "Invalid argument", OSError::kUnknown);
+    Dart_Handle err = DartUtils::NewDartOSError(&os_error);
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+    Dart_ExitScope();
+    return;
+  }
+  intptr_t array_len = 0;
+  Dart_Handle result = Dart_ListLength(buffer_obj, &array_len);
+  if (Dart_IsError(result)) Dart_PropagateError(result);
+  ASSERT((offset + length) <= array_len);
+  uint8_t* buffer = IOBufferPool::Allocate(length);
+  int64_t bytes_read =
+      file->ReadAt(reinterpret_cast<void*>(buffer), length, position);
+  if (bytes_read >= 0) {
+    result = Dart_ListSetAsBytes(buffer_obj, offset, buffer, bytes_read);
+    if (Dart_IsError(result)) {
+      IOBufferPool::Free(buffer);
+      Dart_PropagateError(result);
+    }
+    Dart_SetReturnValue(args, Dart_NewInteger(bytes_read));
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  IOBufferPool::Free(buffer);
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(File_WriteAt)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  File* file = reinterpret_cast<File*>(value);
+  ASSERT(file != NULL);
+  Dart_Handle buffer_obj = Dart_GetNativeArgument(args, 1);
+  ASSERT(Dart_IsList(buffer_obj));
+  // Offset and length arguments are checked in Dart code to be
+  // integers and have the property that (offset + length) <=
+  // list.length. Therefore, it is safe to extract their value as
+  // 64-bit integers.
+  int64_t offset =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 2));
+  int64_t length =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 3));
+  int64_t position = 0;
+  if (!DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 4), &position) ||
+      position < 0) {
+    OSError os_error(-1, "Invalid argument", OSError::kUnknown);
+    Dart_Handle err = DartUtils::NewDartOSError(&os_error);
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+    Dart_ExitScope();
+    return;
+  }
+  intptr_t buffer_len = 0;
+  Dart_Handle result = Dart_ListLength(buffer_obj, &buffer_len);
+  if (Dart_IsError(result)) Dart_PropagateError(result);
+  ASSERT((offset + length) <= buffer_len);
+  uint8_t* buffer = IOBufferPool::Allocate(length);
+  result = Dart_ListGetAsBytes(buffer_obj, offset, buffer, length);
+  if (Dart_IsError(result)) {
+    IOBufferPool::Free(buffer);
+    Dart_PropagateError(result);
+  }
+  int64_t bytes_written =
+      file->WriteAt(reinterpret_cast<void*>(buffer), length, position);
+  if (bytes_written >= 0) {
+    Dart_SetReturnValue(args, Dart_NewInteger(bytes_written));
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  IOBufferPool::Free(buffer);
   Dart_ExitScope();
 }
 
@@ -375,6 +503,320 @@ void FUNCTION_NAME(File_LastModified)(Dart_NativeArguments args) {
 }
 
 
+void FUNCTION_NAME(File_Stat)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  const char* name =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 0));
+  int64_t data[File::kStatFieldCount];
+  if (File::Stat(name, data)) {
+    data[File::kStatModified] *= kMSPerSecond;
+    Dart_Handle result = Dart_NewList(File::kStatFieldCount);
+    if (Dart_IsError(result)) Dart_PropagateError(result);
+    for (intptr_t i = 0; i < File::kStatFieldCount; i++) {
+      Dart_Handle error = Dart_ListSetAt(result, i, Dart_NewInteger(data[i]));
+      if (Dart_IsError(error)) Dart_PropagateError(error);
+    }
+    Dart_SetReturnValue(args, result);
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
+// Reads a file sequentially on a background thread ahead of a file
+// input stream. Each filled buffer is posted to the stream's port as
+// [0, bytes]. At most window buffers are posted but not yet consumed
+// by the stream at any time. End of file is posted as null and a read
+// error as an OS error response.
+class FileReadAhead {
+ public:
+  FileReadAhead(File* file,
+                intptr_t window,
+                intptr_t buffer_size,
+                Dart_Port port)
+      : file_(file),
+        window_(window),
+        buffer_size_(buffer_size),
+        port_(port),
+        outstanding_(0),
+        stop_(false),
+        running_(false) { }
+
+  bool Start() {
+    running_ = true;
+    int result = dart::Thread::Start(&FileReadAhead::Run,
+                                     reinterpret_cast<uword>(this));
+    if (result != 0) {
+      running_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  // Called when the stream has taken a buffer off its queue.
+  void Consumed() {
+    MonitorLocker locker(&monitor_);
+    ASSERT(outstanding_ > 0);
+    outstanding_--;
+    locker.Notify();
+  }
+
+  // Stop reading and wait for the background thread to let go of the
+  // file so the file can be closed.
+  void Stop() {
+    MonitorLocker locker(&monitor_);
+    stop_ = true;
+    locker.Notify();
+    while (running_) {
+      locker.Wait();
+    }
+  }
+
+ private:
+  static void Run(uword args) {
+    reinterpret_cast<FileReadAhead*>(args)->ReadLoop();
+  }
+
+  void ReadLoop() {
+    file_->AdviseSequentialRead();
+    // The buffer is not taken from the I/O buffer pool as the pool
+    // caches buffers per thread and this thread is short lived.
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(malloc(buffer_size_));
+    while (true) {
+      {
+        MonitorLocker locker(&monitor_);
+        while (!stop_ && outstanding_ == window_) {
+          locker.Wait();
+        }
+        if (stop_) break;
+      }
+      int64_t bytes_read = file_->Read(buffer, buffer_size_);
+      if (bytes_read <= 0) {
+        if (bytes_read < 0) {
+          PostOSError();
+        } else {
+          Dart_CObject end;
+          end.type = Dart_CObject::kNull;
+          Dart_PostCObject(port_, &end);
+        }
+        break;
+      }
+      {
+        MonitorLocker locker(&monitor_);
+        outstanding_++;
+      }
+      Dart_CObject success;
+      success.type = Dart_CObject::kInt32;
+      success.value.as_int32 = 0;
+      Dart_CObject data;
+      data.type = Dart_CObject::kUint8Array;
+      data.value.as_byte_array.length = bytes_read;
+      data.value.as_byte_array.values = buffer;
+      Dart_CObject* values[2] = { &success, &data };
+      Dart_CObject message;
+      message.type = Dart_CObject::kArray;
+      message.value.as_array.length = 2;
+      message.value.as_array.values = values;
+      // Posting copies the data so the buffer can be reused right away.
+      Dart_PostCObject(port_, &message);
+    }
+    free(buffer);
+    MonitorLocker locker(&monitor_);
+    running_ = false;
+    locker.Notify();
+  }
+
+  void PostOSError() {
+    OSError os_error;
+    Dart_CObject type;
+    type.type = Dart_CObject::kInt32;
+    type.value.as_int32 = 2;  // OSERROR_RESPONSE in file_impl.dart.
+    Dart_CObject code;
+    code.type = Dart_CObject::kInt32;
+    code.value.as_int32 = os_error.code();
+    Dart_CObject message;
+    message.type = Dart_CObject::kString;
+    message.value.as_string = os_error.message();
+    Dart_CObject* values[3] = { &type, &code, &message };
+    Dart_CObject response;
+    response.type = Dart_CObject::kArray;
+    response.value.as_array.length = 3;
+    response.value.as_array.values = values;
+    Dart_PostCObject(port_, &response);
+  }
+
+  File* file_;
+  intptr_t window_;
+  intptr_t buffer_size_;
+  Dart_Port port_;
+  dart::Monitor monitor_;
+  intptr_t outstanding_;
+  bool stop_;
+  bool running_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileReadAhead);
+};
+
+
+void FUNCTION_NAME(File_StartReadAhead)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  File* file = reinterpret_cast<File*>(value);
+  ASSERT(file != NULL);
+  int64_t window = 0;
+  int64_t buffer_size = 0;
+  if (DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 1), &window) &&
+      DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 2),
+                               &buffer_size) &&
+      window > 0 &&
+      buffer_size > 0 &&
+      buffer_size <= kMaxInt32) {
+    Dart_Port port =
+        DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 3),
+                                   DartUtils::kIdFieldName);
+    FileReadAhead* read_ahead =
+        new FileReadAhead(file, window, buffer_size, port);
+    if (read_ahead->Start()) {
+      Dart_SetReturnValue(
+          args, Dart_NewInteger(reinterpret_cast<intptr_t>(read_ahead)));
+    } else {
+      delete read_ahead;
+      Dart_Handle err = DartUtils::NewDartOSError();
+      if (Dart_IsError(err)) Dart_PropagateError(err);
+      Dart_SetReturnValue(args, err);
+    }
+  } else {
+    OSError os_error(-1, "Invalid argument", OSError::kUnknown);
+    Dart_Handle err = DartUtils::NewDartOSError(&os_error);
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(File_ReadAheadConsumed)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  FileReadAhead* read_ahead = reinterpret_cast<FileReadAhead*>(value);
+  ASSERT(read_ahead != NULL);
+  read_ahead->Consumed();
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(File_StopReadAhead)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t value =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  FileReadAhead* read_ahead = reinterpret_cast<FileReadAhead*>(value);
+  ASSERT(read_ahead != NULL);
+  read_ahead->Stop();
+  delete read_ahead;
+  Dart_ExitScope();
+}
+
+
+static HashMap* registered_mappings = NULL;
+static dart::Mutex registered_mappings_mutex;
+
+
+static uint32_t MappingHash(MappedMemory* mapping) {
+  return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(mapping) >> 3);
+}
+
+
+void MappedMemory::Register(MappedMemory* mapping) {
+  MutexLocker locker(&registered_mappings_mutex);
+  if (registered_mappings == NULL) {
+    registered_mappings = new HashMap(&HashMap::SamePointerValue, 16);
+  }
+  registered_mappings->Lookup(mapping, MappingHash(mapping), true);
+}
+
+
+void MappedMemory::Unregister(MappedMemory* mapping) {
+  MutexLocker locker(&registered_mappings_mutex);
+  if (registered_mappings != NULL) {
+    registered_mappings->Remove(mapping, MappingHash(mapping));
+  }
+}
+
+
+bool MappedMemory::IsRegistered(void* peer) {
+  MappedMemory* mapping = reinterpret_cast<MappedMemory*>(peer);
+  MutexLocker locker(&registered_mappings_mutex);
+  return (registered_mappings != NULL) &&
+      (registered_mappings->Lookup(mapping, MappingHash(mapping), false) !=
+       NULL);
+}
+
+
+static void UnmapFinalizer(void* peer) {
+  MappedMemory* mapping = reinterpret_cast<MappedMemory*>(peer);
+  MappedMemory::Unregister(mapping);
+  delete mapping;
+}
+
+
+void FUNCTION_NAME(File_Mmap)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  const char* name =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 0));
+  int64_t offset = 0;
+  int64_t length = 0;
+  int64_t mode = 0;
+  int64_t advice = 0;
+  if (DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 1), &offset) &&
+      DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 2), &length) &&
+      DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 3), &mode) &&
+      DartUtils::GetInt64Value(Dart_GetNativeArgument(args, 4), &advice) &&
+      offset >= 0 &&
+      length > 0 &&
+      length <= kIntptrMax &&
+      (mode == File::kMapRead || mode == File::kMapWrite) &&
+      advice >= File::kAdviceNormal &&
+      advice <= File::kAdviceWillNeed) {
+    MappedMemory* mapping =
+        File::Map(name,
+                  offset,
+                  length,
+                  static_cast<File::MapMode>(mode),
+                  static_cast<File::MapAdvice>(advice));
+    if (mapping != NULL) {
+      // The mapping is owned by the byte array and unmapped when the
+      // byte array is collected.
+      Dart_Handle result =
+          Dart_NewExternalByteArray(mapping->address(),
+                                    static_cast<intptr_t>(mapping->length()),
+                                    mapping,
+                                    UnmapFinalizer);
+      if (Dart_IsError(result)) {
+        delete mapping;
+        Dart_PropagateError(result);
+      }
+      MappedMemory::Register(mapping);
+      Dart_SetReturnValue(args, result);
+    } else {
+      Dart_Handle err = DartUtils::NewDartOSError();
+      if (Dart_IsError(err)) Dart_PropagateError(err);
+      Dart_SetReturnValue(args, err);
+    }
+  } else {
+    OSError os_error(-1, "Invalid argument", OSError::kUnknown);
+    Dart_Handle err = DartUtils::NewDartOSError(&os_error);
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
 void FUNCTION_NAME(File_Flush)(Dart_NativeArguments args) {
   Dart_EnterScope();
   intptr_t value =
@@ -424,6 +866,24 @@ void FUNCTION_NAME(File_Delete)(Dart_NativeArguments args) {
 }
 
 
+void FUNCTION_NAME(File_Copy)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  const char* old_path =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 0));
+  const char* new_path =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 1));
+  bool result = File::Copy(old_path, new_path);
+  if (result) {
+    Dart_SetReturnValue(args, Dart_NewBoolean(result));
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
 void FUNCTION_NAME(File_Directory)(Dart_NativeArguments args) {
   Dart_EnterScope();
   const char* str =
@@ -557,6 +1017,23 @@ static CObject* FileDeleteRequest(const CObjectArray& request) {
 }
 
 
+static CObject* FileCopyRequest(const CObjectArray& request) {
+  if (request.Length() == 3 &&
+      request[1]->IsString() &&
+      request[2]->IsString()) {
+    CObjectString old_path(request[1]);
+    CObjectString new_path(request[2]);
+    bool result = File::Copy(old_path.CString(), new_path.CString());
+    if (result) {
+      return CObject::True();
+    } else {
+      return CObject::NewOSError();
+    }
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
 static CObject* FileFullPathRequest(const CObjectArray& request) {
   if (request.Length() == 2 && request[1]->IsString()) {
     CObjectString filename(request[1]);
@@ -711,6 +1188,66 @@ static CObject* FileLastModifiedRequest(const CObjectArray& request) {
 }
 
 
+// Returns the stat fields of the file with the given name as an array
+// or NULL if the file cannot be accessed.
+static CObjectArray* StatToCObject(const char* name) {
+  int64_t data[File::kStatFieldCount];
+  if (!File::Stat(name, data)) {
+    return NULL;
+  }
+  data[File::kStatModified] *= kMSPerSecond;
+  CObjectArray* result =
+      new CObjectArray(CObject::NewArray(File::kStatFieldCount));
+  for (intptr_t i = 0; i < File::kStatFieldCount; i++) {
+    result->SetAt(i, new CObjectIntptr(CObject::NewInt64(data[i])));
+  }
+  return result;
+}
+
+
+static CObject* FileStatRequest(const CObjectArray& request) {
+  if (request.Length() == 2 && request[1]->IsString()) {
+    CObjectString filename(request[1]);
+    CObjectArray* stat = StatToCObject(filename.CString());
+    if (stat == NULL) {
+      return CObject::NewOSError();
+    }
+    CObjectArray* result = new CObjectArray(CObject::NewArray(2));
+    result->SetAt(0, new CObjectIntptr(CObject::NewInt32(0)));
+    result->SetAt(1, stat);
+    return result;
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
+// Stats a list of files in one request. The response holds the stat
+// fields for each file or null for the files which cannot be accessed.
+static CObject* FileStatListRequest(const CObjectArray& request) {
+  if (request.Length() == 2 && request[1]->IsArray()) {
+    CObjectArray names(request[1]);
+    for (int i = 0; i < names.Length(); i++) {
+      if (!names[i]->IsString()) return CObject::IllegalArgumentError();
+    }
+    CObjectArray* stats = new CObjectArray(CObject::NewArray(names.Length()));
+    for (int i = 0; i < names.Length(); i++) {
+      CObjectString filename(names[i]);
+      CObjectArray* stat = StatToCObject(filename.CString());
+      if (stat == NULL) {
+        stats->SetAt(i, CObject::Null());
+      } else {
+        stats->SetAt(i, stat);
+      }
+    }
+    CObjectArray* result = new CObjectArray(CObject::NewArray(2));
+    result->SetAt(0, new CObjectIntptr(CObject::NewInt32(0)));
+    result->SetAt(1, stats);
+    return result;
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
 static CObject* FileFlushRequest(const CObjectArray& request) {
   if (request.Length() == 2 && request[1]->IsIntptr()) {
     File* file = CObjectToFilePointer(request[1]);
@@ -803,6 +1340,39 @@ static CObject* FileReadListRequest(const CObjectArray& request) {
 }
 
 
+// Get a pointer to length bytes starting at offset in a write request
+// buffer which is either a Uint8Array or an array of integers. In the
+// latter case the bytes are copied to a buffer from the I/O buffer pool
+// which has to be released with IOBufferPool::Free. Returns NULL if the
+// array contains anything but integers.
+static uint8_t* GetWriteRequestBytes(CObject* buffer,
+                                     int64_t offset,
+                                     int64_t length) {
+  if (buffer->IsUint8Array()) {
+    CObjectUint8Array byte_array(buffer);
+    return byte_array.Buffer() + offset;
+  }
+  // Work on the API objects directly. Going through CObjectArray would
+  // scope allocate a wrapper object for every element.
+  Dart_CObject** values =
+      buffer->AsApiCObject()->value.as_array.values + offset;
+  uint8_t* bytes = IOBufferPool::Allocate(length);
+  for (int i = 0; i < length; i++) {
+    Dart_CObject* value = values[i];
+    if (value->type == Dart_CObject::kInt32) {
+      bytes[i] = value->value.as_int32 & 0xFF;
+    } else if (value->type == Dart_CObject::kInt64) {
+      bytes[i] = value->value.as_int64 & 0xFF;
+    } else {
+      // Unsupported type.
+      IOBufferPool::Free(bytes);
+      return NULL;
+    }
+  }
+  return bytes;
+}
+
+
 static CObject* FileWriteListRequest(const CObjectArray& request) {
   if (request.Length() == 5 &&
       request[1]->IsIntptr() &&
@@ -814,29 +1384,13 @@ static CObject* FileWriteListRequest(const CObjectArray& request) {
     if (!file->IsClosed()) {
       int64_t offset = CObjectInt32OrInt64ToInt64(request[3]);
       int64_t length = CObjectInt32OrInt64ToInt64(request[4]);
-      uint8_t* buffer_start;
-      if (request[2]->IsUint8Array()) {
-        CObjectUint8Array byte_array(request[2]);
-        buffer_start = byte_array.Buffer() + offset;
-      } else {
-        CObjectArray array(request[2]);
-        buffer_start = new uint8_t[length];
-        for (int i = 0; i < length; i++) {
-          if (array[i + offset]->IsInt32OrInt64()) {
-            int64_t value = CObjectInt32OrInt64ToInt64(array[i + offset]);
-            buffer_start[i] = value & 0xFF;
-          } else {
-            // Unsupported type.
-            delete[] buffer_start;
-            return CObject::IllegalArgumentError();
-          }
-        }
-        offset = 0;
-      }
+      uint8_t* buffer_start =
+          GetWriteRequestBytes(request[2], offset, length);
+      if (buffer_start == NULL) return CObject::IllegalArgumentError();
       int64_t bytes_written =
           file->Write(reinterpret_cast<void*>(buffer_start), length);
       if (!request[2]->IsUint8Array()) {
-        delete[] buffer_start;
+        IOBufferPool::Free(buffer_start);
       }
       if (bytes_written >= 0) {
         return new CObjectIntptr(CObject::NewIntptr(bytes_written));
@@ -851,6 +1405,166 @@ static CObject* FileWriteListRequest(const CObjectArray& request) {
 }
 
 
+static CObject* FileReadAtRequest(const CObjectArray& request) {
+  if (request.Length() == 4 &&
+      request[1]->IsIntptr() &&
+      request[2]->IsInt32OrInt64() &&
+      request[3]->IsInt32OrInt64()) {
+    File* file = CObjectToFilePointer(request[1]);
+    ASSERT(file != NULL);
+    if (!file->IsClosed()) {
+      int64_t length = CObjectInt32OrInt64ToInt64(request[2]);
+      int64_t position = CObjectInt32OrInt64ToInt64(request[3]);
+      if (length < 0 || position < 0) return CObject::IllegalArgumentError();
+      CObjectUint8Array* byte_array =
+          new CObjectUint8Array(CObject::NewUint8Array(length));
+      void* buffer = reinterpret_cast<void*>(byte_array->Buffer());
+      int64_t bytes_read =
+          file->ReadAt(buffer, byte_array->Length(), position);
+      if (bytes_read >= 0) {
+        CObjectArray* result = new CObjectArray(CObject::NewArray(3));
+        result->SetAt(0, new CObjectIntptr(CObject::NewInt32(0)));
+        result->SetAt(1, new CObjectIntptr(CObject::NewIntptr(bytes_read)));
+        result->SetAt(2, byte_array);
+        return result;
+      } else {
+        return CObject::NewOSError();
+      }
+    } else {
+      return CObject::FileClosedError();
+    }
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
+static CObject* FileWriteAtRequest(const CObjectArray& request) {
+  if (request.Length() == 6 &&
+      request[1]->IsIntptr() &&
+      (request[2]->IsUint8Array() || request[2]->IsArray()) &&
+      request[3]->IsInt32OrInt64() &&
+      request[4]->IsInt32OrInt64() &&
+      request[5]->IsInt32OrInt64()) {
+    File* file = CObjectToFilePointer(request[1]);
+    ASSERT(file != NULL);
+    if (!file->IsClosed()) {
+      int64_t offset = CObjectInt32OrInt64ToInt64(request[3]);
+      int64_t length = CObjectInt32OrInt64ToInt64(request[4]);
+      int64_t position = CObjectInt32OrInt64ToInt64(request[5]);
+      if (position < 0) return CObject::IllegalArgumentError();
+      uint8_t* buffer_start =
+          GetWriteRequestBytes(request[2], offset, length);
+      if (buffer_start == NULL) return CObject::IllegalArgumentError();
+      int64_t bytes_written = file->WriteAt(buffer_start, length, position);
+      if (!request[2]->IsUint8Array()) {
+        IOBufferPool::Free(buffer_start);
+      }
+      if (bytes_written >= 0) {
+        return new CObjectIntptr(CObject::NewIntptr(bytes_written));
+      } else {
+        return CObject::NewOSError();
+      }
+    } else {
+      return CObject::FileClosedError();
+    }
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
+static CObject* OutOfMemoryError() {
+  OSError os_error(-1, "Out of memory", OSError::kUnknown);
+  return CObject::NewOSError(&os_error);
+}
+
+
+// Read the rest of a file whose length is not known up front, e.g. a
+// file in /proc, into a byte array. Returns an OSError if the buffer
+// cannot be allocated.
+static CObject* ReadUnknownLength(File* file) {
+  static const int64_t kChunkSize = 64 * KB;
+  int64_t capacity = kChunkSize;
+  int64_t length = 0;
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(malloc(capacity));
+  if (buffer == NULL) return OutOfMemoryError();
+  while (true) {
+    if (length == capacity) {
+      capacity *= 2;
+      uint8_t* new_buffer =
+          reinterpret_cast<uint8_t*>(realloc(buffer, capacity));
+      if (new_buffer == NULL) {
+        free(buffer);
+        return OutOfMemoryError();
+      }
+      buffer = new_buffer;
+    }
+    int64_t bytes_read = file->Read(buffer + length, capacity - length);
+    if (bytes_read < 0) {
+      free(buffer);
+      return CObject::NewOSError();
+    }
+    if (bytes_read == 0) break;
+    length += bytes_read;
+  }
+  CObjectUint8Array* byte_array =
+      new CObjectUint8Array(CObject::NewUint8Array(length));
+  memmove(byte_array->Buffer(), buffer, length);
+  free(buffer);
+  return byte_array;
+}
+
+
+// Open, read and close a file in one request. The whole content is read
+// directly into a byte array of the size reported for the file.
+static CObject* FileReadWholeFileRequest(const CObjectArray& request) {
+  if (request.Length() == 2 && request[1]->IsString()) {
+    CObjectString filename(request[1]);
+    File* file = File::Open(filename.CString(), File::kRead);
+    if (file == NULL) return CObject::NewOSError();
+    int64_t length = file->Length();
+    if (length < 0) {
+      CObject* error = CObject::NewOSError();
+      delete file;
+      return error;
+    }
+    CObject* data;
+    if (length == 0) {
+      data = ReadUnknownLength(file);
+    } else {
+      CObjectUint8Array* byte_array =
+          new CObjectUint8Array(CObject::NewUint8Array(length));
+      int64_t total = 0;
+      while (total < length) {
+        int64_t bytes_read =
+            file->Read(byte_array->Buffer() + total, length - total);
+        if (bytes_read < 0) {
+          CObject* error = CObject::NewOSError();
+          delete file;
+          return error;
+        }
+        if (bytes_read == 0) break;
+        total += bytes_read;
+      }
+      if (total < length) {
+        // The file was truncated while it was being read.
+        CObjectUint8Array* truncated =
+            new CObjectUint8Array(CObject::NewUint8Array(total));
+        memmove(truncated->Buffer(), byte_array->Buffer(), total);
+        byte_array = truncated;
+      }
+      data = byte_array;
+    }
+    delete file;
+    if (!data->IsUint8Array()) return data;
+    CObjectArray* result = new CObjectArray(CObject::NewArray(2));
+    result->SetAt(0, new CObjectIntptr(CObject::NewInt32(0)));
+    result->SetAt(1, data);
+    return result;
+  }
+  return CObject::IllegalArgumentError();
+}
+
+
 static CObject* FileWriteStringRequest(const CObjectArray& request) {
   if (request.Length() == 3 &&
       request[1]->IsIntptr() &&
@@ -870,6 +1584,95 @@ static CObject* FileWriteStringRequest(const CObjectArray& request) {
 }
 
 
+// Hand a request over to the asynchronous file engine if the engine
+// supports it. The engine posts the response to the reply port when the
+// operation completes. Returns false if the request has to be handled
+// synchronously. Flush requests always are: a close queued after the
+// flush on the same port would otherwise release the file descriptor
+// while the sync is still pending.
+static bool SubmitFileRequest(const CObjectArray& request,
+                              Dart_Port reply_port) {
+  CObjectInt32 requestType(request[0]);
+  switch (requestType.Value()) {
+    case File::kOpenRequest:
+      if (request.Length() == 3 &&
+          request[1]->IsString() &&
+          request[2]->IsInt32()) {
+        CObjectString filename(request[1]);
+        CObjectInt32 mode(request[2]);
+        File::DartFileOpenMode dart_file_mode =
+            static_cast<File::DartFileOpenMode>(mode.Value());
+        return FileIOEngine::SubmitOpen(
+            filename.CString(),
+            File::DartModeToFileMode(dart_file_mode),
+            reply_port);
+      }
+      break;
+    case File::kLengthFromNameRequest:
+      if (request.Length() == 2 && request[1]->IsString()) {
+        CObjectString filename(request[1]);
+        return FileIOEngine::SubmitLength(filename.CString(), reply_port);
+      }
+      break;
+    case File::kLastModifiedRequest:
+      if (request.Length() == 2 && request[1]->IsString()) {
+        CObjectString filename(request[1]);
+        return FileIOEngine::SubmitLastModified(filename.CString(),
+                                                reply_port);
+      }
+      break;
+    case File::kReadAtRequest:
+      if (request.Length() == 4 &&
+          request[1]->IsIntptr() &&
+          request[2]->IsInt32OrInt64() &&
+          request[3]->IsInt32OrInt64()) {
+        File* file = CObjectToFilePointer(request[1]);
+        ASSERT(file != NULL);
+        int64_t length = CObjectInt32OrInt64ToInt64(request[2]);
+        int64_t position = CObjectInt32OrInt64ToInt64(request[3]);
+        if (!file->IsClosed() && length >= 0 && position >= 0) {
+          return FileIOEngine::SubmitReadAt(file,
+                                            length,
+                                            position,
+                                            reply_port);
+        }
+      }
+      break;
+    case File::kWriteAtRequest:
+      if (request.Length() == 6 &&
+          request[1]->IsIntptr() &&
+          (request[2]->IsUint8Array() || request[2]->IsArray()) &&
+          request[3]->IsInt32OrInt64() &&
+          request[4]->IsInt32OrInt64() &&
+          request[5]->IsInt32OrInt64()) {
+        File* file = CObjectToFilePointer(request[1]);
+        ASSERT(file != NULL);
+        int64_t offset = CObjectInt32OrInt64ToInt64(request[3]);
+        int64_t length = CObjectInt32OrInt64ToInt64(request[4]);
+        int64_t position = CObjectInt32OrInt64ToInt64(request[5]);
+        if (!file->IsClosed() && position >= 0) {
+          uint8_t* buffer_start =
+              GetWriteRequestBytes(request[2], offset, length);
+          if (buffer_start == NULL) return false;
+          bool submitted = FileIOEngine::SubmitWriteAt(file,
+                                                       buffer_start,
+                                                       length,
+                                                       position,
+                                                       reply_port);
+          if (!request[2]->IsUint8Array()) {
+            IOBufferPool::Free(buffer_start);
+          }
+          return submitted;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return false;
+}
+
+
 void FileService(Dart_Port dest_port_id,
                  Dart_Port reply_port_id,
                  Dart_CObject* message) {
@@ -877,6 +1680,7 @@ void FileService(Dart_Port dest_port_id,
   CObjectArray request(message);
   if (message->type == Dart_CObject::kArray) {
     if (request.Length() > 1 && request[0]->IsInt32()) {
+      if (SubmitFileRequest(request, reply_port_id)) return;
       CObjectInt32 requestType(request[0]);
       switch (requestType.Value()) {
         case File::kExistsRequest:
@@ -936,6 +1740,24 @@ void FileService(Dart_Port dest_port_id,
         case File::kWriteStringRequest:
           response = FileWriteStringRequest(request);
           break;
+        case File::kReadAtRequest:
+          response = FileReadAtRequest(request);
+          break;
+        case File::kWriteAtRequest:
+          response = FileWriteAtRequest(request);
+          break;
+        case File::kReadWholeFileRequest:
+          response = FileReadWholeFileRequest(request);
+          break;
+        case File::kCopyRequest:
+          response = FileCopyRequest(request);
+          break;
+        case File::kStatRequest:
+          response = FileStatRequest(request);
+          break;
+        case File::kStatListRequest:
+          response = FileStatListRequest(request);
+          break;
         default:
           UNREACHABLE();
       }
@@ -946,35 +1768,20 @@ void FileService(Dart_Port dest_port_id,
 }
 
 
-Dart_Port File::GetServicePort() {
-  MutexLocker lock(&mutex_);
-  if (service_ports_size_ == 0) {
-    ASSERT(service_ports_ == NULL);
-    service_ports_size_ = 16;
-    service_ports_ = new Dart_Port[service_ports_size_];
-    service_ports_index_ = 0;
-    for (int i = 0; i < service_ports_size_; i++) {
-      service_ports_[i] = kIllegalPort;
-    }
-  }
-
-  Dart_Port result = service_ports_[service_ports_index_];
-  if (result == kIllegalPort) {
-    result = Dart_NewNativePort("FileService",
-                                FileService,
-                                true);
-    ASSERT(result != kIllegalPort);
-    service_ports_[service_ports_index_] = result;
-  }
-  service_ports_index_ = (service_ports_index_ + 1) % service_ports_size_;
-  return result;
+Dart_Port File::GetServicePort(intptr_t ordering_key) {
+  return IOService::GetServicePort(IOService::kFileService,
+                                   "FileService",
+                                   FileService,
+                                   ordering_key);
 }
 
 
 void FUNCTION_NAME(File_NewServicePort)(Dart_NativeArguments args) {
   Dart_EnterScope();
   Dart_SetReturnValue(args, Dart_Null());
-  Dart_Port service_port = File::GetServicePort();
+  intptr_t ordering_key =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  Dart_Port service_port = File::GetServicePort(ordering_key);
   if (service_port != kIllegalPort) {
     // Return a send port for the service port.
     Dart_Handle send_port = Dart_NewSendPort(service_port);
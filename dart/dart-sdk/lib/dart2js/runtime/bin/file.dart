@@ -15,6 +15,93 @@ class FileMode {
 }
 
 
+/**
+ * MmapMode describes how a file region mapped with [File.mmapSync] is
+ * shared with the file.
+ *
+ * [READ]: changes made to the mapped bytes are private to the process
+ * and never written to the file.
+ *
+ * [WRITE]: changes made to the mapped bytes are written back to the
+ * file. The file has to be writable.
+ */
+class MmapMode {
+  static final READ = const MmapMode._internal(0);
+  static final WRITE = const MmapMode._internal(1);
+  const MmapMode._internal(int this._mode);
+  final int _mode;
+}
+
+
+/**
+ * MmapAdvice is a hint to the operating system about how a region
+ * mapped with [File.mmapSync] is going to be accessed.
+ */
+class MmapAdvice {
+  static final NORMAL = const MmapAdvice._internal(0);
+  static final SEQUENTIAL = const MmapAdvice._internal(1);
+  static final RANDOM = const MmapAdvice._internal(2);
+  static final WILLNEED = const MmapAdvice._internal(3);
+  const MmapAdvice._internal(int this._advice);
+  final int _advice;
+}
+
+
+/**
+ * FileStat holds the metadata of a file: its [type], [size],
+ * [modified] time, permission bits ([mode]) and [inode] number. All
+ * fields are read with a single system call. FileStat objects are
+ * obtained by calling the [:stat:] method on a [File] object or with
+ * [statList].
+ */
+class FileStat {
+  static final int FILE = 0;
+  static final int DIRECTORY = 1;
+  static final int OTHER = 2;
+
+  const FileStat._internal(int this.type,
+                           int this.size,
+                           Date this.modified,
+                           int this.mode,
+                           int this.inode);
+
+  /**
+   * Get the metadata of all files in [paths] with a single request to
+   * the file service. Returns a [:Future<List<FileStat>>:] that
+   * completes with a FileStat for each path in the same order, or
+   * null for the paths which cannot be accessed.
+   */
+  static Future<List<FileStat>> statList(List<String> paths) {
+    return _FileUtils.statList(paths);
+  }
+
+  /**
+   * One of [FILE], [DIRECTORY] or [OTHER]. Links are followed.
+   */
+  final int type;
+
+  /**
+   * The size of the file in bytes.
+   */
+  final int size;
+
+  /**
+   * The time of the last modification of the file.
+   */
+  final Date modified;
+
+  /**
+   * The permission bits of the file, e.g. 0644.
+   */
+  final int mode;
+
+  /**
+   * The inode number of the file. Always 0 on Windows.
+   */
+  final int inode;
+}
+
+
 /**
  * [File] objects are references to files.
  *
@@ -67,6 +154,23 @@ interface File default _File {
    */
   void deleteSync();
 
+  /**
+   * Copy the content of the file to [newPath]. The file at [newPath]
+   * is created if it does not exist and truncated if it does. Where
+   * the operating system supports it the data is copied without
+   * passing through the Dart process and on file systems with copy
+   * on write support the copy shares the data blocks of the
+   * original. Returns a [:Future<File>:] that completes with a File
+   * object for [newPath] when the copy is done.
+   */
+  Future<File> copy(String newPath);
+
+  /**
+   * Synchronously copy the content of the file to [newPath]. Returns
+   * a File object for [newPath].
+   */
+  File copySync(String newPath);
+
   /**
    * Get a Directory object for the directory containing this
    * file. Returns a [:Future<Directory>:] that completes with the
@@ -104,6 +208,19 @@ interface File default _File {
    */
   Date lastModifiedSync();
 
+  /**
+   * Get the type, length, last-modified time, permission bits and
+   * inode number of the file in one operation. Returns a
+   * [:Future<FileStat>:] that completes with the metadata.
+   */
+  Future<FileStat> stat();
+
+  /**
+   * Synchronously get the metadata of the file. Throws an exception
+   * if the file does not exist.
+   */
+  FileStat statSync();
+
   /**
    * Open the file for random access operations. Returns a
    * [:Future<RandomAccessFile>:] that completes with the opened
@@ -137,6 +254,25 @@ interface File default _File {
    */
   RandomAccessFile openSync([FileMode mode]);
 
+  /**
+   * Synchronously map [length] bytes of the file starting at [offset]
+   * into memory. The result is a list of bytes backed directly by the
+   * mapped pages so no data is copied until it is accessed. The
+   * mapping is released when the list is garbage collected. The
+   * mapped region has to lie within the file.
+   *
+   * Large writes of the list to a socket hand the mapped pages to the
+   * operating system without copying them where supported. Bytes
+   * changed while such a write is still being transmitted can then be
+   * sent with their new value.
+   *
+   * The default value for [mode] is [:MmapMode.READ:] and the
+   * default value for [advice] is [:MmapAdvice.NORMAL:].
+   */
+  List<int> mmapSync(int offset,
+                     int length,
+                     [MmapMode mode, MmapAdvice advice]);
+
   /**
    * Get the canonical full path corresponding to the file name.
    * Returns a [:Future<String>:] that completes with the path.
@@ -152,8 +288,13 @@ interface File default _File {
    * Create a new independent input stream for the file. The file
    * input stream must be closed when no longer used to free up system
    * resources.
+   *
+   * If [readAheadBuffers] is given the file is read sequentially on a
+   * background thread which keeps up to that many 64KB buffers filled
+   * ahead of the data consumed from the stream. Use this when
+   * streaming through large files.
    */
-  InputStream openInputStream();
+  InputStream openInputStream([int readAheadBuffers]);
 
   /**
    * Creates a new independent output stream for the file. The file
@@ -172,6 +313,13 @@ interface File default _File {
    */
   OutputStream openOutputStream([FileMode mode]);
 
+  /**
+   * Synchronously open the file as an [AppendLog]. The file is
+   * created if it does not exist. The log must be closed when no
+   * longer used to free up system resources.
+   */
+  AppendLog openAppendLog();
+
   /**
    * Read the entire file contents as a list of bytes. Returns a
    * [:Future<List<int>>:] that completes with the list of bytes that
@@ -215,6 +363,14 @@ interface File default _File {
    */
   List<String> readAsLinesSync([Encoding encoding]);
 
+  /**
+   * Start watching the file for changes. Returns a
+   * [FileSystemWatcher] on which a change handler should be
+   * registered. The watcher must be closed when no longer used.
+   * Throws an exception if the file cannot be watched.
+   */
+  FileSystemWatcher watch();
+
   /**
    * Get the name of the file.
    */
@@ -289,6 +445,38 @@ interface RandomAccessFile {
    */
   int writeListSync(List<int> buffer, int offset, int bytes);
 
+  /**
+   * Read up to [bytes] bytes from the file starting at [position]
+   * into [buffer] at [offset]. The current position of the file is
+   * neither used nor changed so several reads can be in flight on the
+   * same file at once. Returns a [:Future<int>:] that completes with
+   * the number of bytes read.
+   */
+  Future<int> readAt(List<int> buffer, int offset, int bytes, int position);
+
+  /**
+   * Synchronously read up to [bytes] bytes from the file starting at
+   * [position] into [buffer] at [offset] without changing the current
+   * position of the file. Returns the number of bytes read.
+   */
+  int readAtSync(List<int> buffer, int offset, int bytes, int position);
+
+  /**
+   * Write [bytes] bytes from [buffer] at [offset] to the file starting
+   * at [position]. The current position of the file is neither used
+   * nor changed so several writes can be in flight on the same file
+   * at once. Returns a [:Future<int>:] that completes with the number
+   * of bytes written.
+   */
+  Future<int> writeAt(List<int> buffer, int offset, int bytes, int position);
+
+  /**
+   * Synchronously write [bytes] bytes from [buffer] at [offset] to the
+   * file starting at [position] without changing the current position
+   * of the file. Returns the number of bytes written.
+   */
+  int writeAtSync(List<int> buffer, int offset, int bytes, int position);
+
   /**
    * Write a string to the file using the given [encoding]. The
    * default encoding is UTF-8 - [:Encoding.UTF_8:]. Returns a
@@ -369,6 +557,96 @@ interface RandomAccessFile {
 }
 
 
+/**
+ * [AppendLog] appends records to the end of a file and reports when
+ * they are durable, i.e. when they have been flushed to the storage
+ * device. [AppendLog] objects are obtained by calling the
+ * [:openAppendLog:] method on a [File] object.
+ *
+ * Records are written and flushed in batches on a background thread.
+ * All records appended while the previous batch is being flushed go
+ * into the next batch and share one flush, which makes the log suited
+ * for write-ahead logging with many concurrent writers.
+ */
+interface AppendLog {
+  /**
+   * Append [bytes] bytes from [buffer] at [offset] to the log. The
+   * bytes are copied so the buffer can be reused right away. Returns a
+   * [:Future<int>:] that completes with the length of the file after
+   * the record once the record is durable. If writing or flushing
+   * fails, the future of the record and of all records appended later
+   * completes with an exception.
+   */
+  Future<int> append(List<int> buffer, [int offset, int bytes]);
+
+  /**
+   * Close the log. Returns a [:Future<AppendLog>:] that completes with
+   * this AppendLog when all appended records have been written and the
+   * file has been closed.
+   */
+  Future<AppendLog> close();
+
+  /**
+   * Get the name of the file.
+   */
+  String get name();
+}
+
+
+/**
+ * A change to a file or directory reported by a [FileSystemWatcher].
+ */
+class FileSystemEvent {
+  static final int CREATE = 1;
+  static final int MODIFY = 2;
+  static final int DELETE = 4;
+  static final int MOVE = 8;
+  static final int ATTRIBUTES = 16;
+  // Changes have been lost because they arrived faster than they were
+  // handled. The path is the watched path.
+  static final int OVERFLOW = 32;
+
+  const FileSystemEvent._internal(int this.type, String this.path);
+
+  /**
+   * The kinds of change as a bit mask of the constants above. Changes
+   * to the same path arriving together are reported as one event.
+   */
+  final int type;
+
+  /**
+   * The path of the changed file or directory.
+   */
+  final String path;
+}
+
+
+/**
+ * [FileSystemWatcher] reports changes to a watched file or directory.
+ * [FileSystemWatcher] objects are obtained by calling the [:watch:]
+ * method on a [File] or [Directory] object.
+ */
+interface FileSystemWatcher {
+  /**
+   * Sets the handler that is called with the changes. Changes which
+   * are detected together are passed to the handler in one list.
+   */
+  void set onChange(void onChange(List<FileSystemEvent> events));
+
+  /**
+   * Sets the handler that is called if watching fails. Watching fails
+   * when the watched file or directory is deleted or moved. The
+   * watcher is closed after an error.
+   */
+  void set onError(void onError(e));
+
+  /**
+   * Stop watching.
+   */
+  void close();
+}
+
+
 class FileIOException implements Exception {
   const FileIOException([String this.message = "",
                          OSError this.osError = null]);
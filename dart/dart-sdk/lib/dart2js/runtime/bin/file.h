@@ -25,6 +25,41 @@ typedef unsigned __int8 uint8_t;
 // Forward declaration.
 class FileHandle;
 
+
+// A region of a file mapped into memory by File::Map. Deleting the
+// object unmaps the region.
+class MappedMemory {
+ public:
+  MappedMemory(void* start, int64_t size, int64_t offset)
+      : start_(start), size_(size), offset_(offset) { }
+  ~MappedMemory();
+
+  uint8_t* address() const {
+    return reinterpret_cast<uint8_t*>(start_) + offset_;
+  }
+  int64_t length() const { return size_ - offset_; }
+
+  // Mappings backing byte arrays are registered so that socket writes
+  // can recognise the peer of an external byte array as a mapping
+  // whose data never moves, and send it without copying.
+  static void Register(MappedMemory* mapping);
+  static void Unregister(MappedMemory* mapping);
+  static bool IsRegistered(void* peer);
+
+ private:
+  // The mapping starts at a page boundary at or before the requested
+  // offset in the file. offset_ is the distance from the start of the
+  // mapping to the requested region.
+  void* start_;
+  int64_t size_;
+  int64_t offset_;
+
+  // DISALLOW_COPY_AND_ASSIGN(MappedMemory).
+  MappedMemory(const MappedMemory&);
+  void operator=(const MappedMemory&);
+};
+
+
 class File {
  public:
   enum FileOpenMode {
@@ -42,6 +77,41 @@ class File {
     kDartAppend = 2
   };
 
+  // These values have to be kept in sync with the mode values of
+  // MmapMode.READ and MmapMode.WRITE in file.dart.
+  enum MapMode {
+    kMapRead = 0,
+    kMapWrite = 1
+  };
+
+  // These values have to be kept in sync with the values of
+  // MmapAdvice in file.dart.
+  enum MapAdvice {
+    kAdviceNormal = 0,
+    kAdviceSequential = 1,
+    kAdviceRandom = 2,
+    kAdviceWillNeed = 3
+  };
+
+  // These values have to be kept in sync with the type values of
+  // FileStat in file.dart.
+  enum StatType {
+    kIsFile = 0,
+    kIsDirectory = 1,
+    kIsOther = 2
+  };
+
+  // Indices of the fields filled in by Stat. These have to be kept in
+  // sync with the STAT_ values of _FileUtils in file_impl.dart.
+  enum StatField {
+    kStatType = 0,
+    kStatSize = 1,
+    kStatModified = 2,
+    kStatMode = 3,
+    kStatInode = 4,
+    kStatFieldCount = 5
+  };
+
   enum StdioHandleType {
     kTerminal = 0,
     kPipe = 1,
@@ -69,7 +139,13 @@ class File {
     kWriteByteRequest = 15,
     kReadListRequest = 16,
     kWriteListRequest = 17,
-    kWriteStringRequest = 18
+    kWriteStringRequest = 18,
+    kReadAtRequest = 19,
+    kWriteAtRequest = 20,
+    kReadWholeFileRequest = 21,
+    kCopyRequest = 22,
+    kStatRequest = 23,
+    kStatListRequest = 24
   };
 
   ~File();
@@ -79,6 +155,24 @@ class File {
   int64_t Read(void* buffer, int64_t num_bytes);
   int64_t Write(const void* buffer, int64_t num_bytes);
 
+  // ReadAt/WriteAt attempt to transfer num_bytes to/from buffer at the
+  // given position in the file. They neither use nor change the current
+  // position so several of them can run concurrently on the same
+  // file. They return the number of bytes read/written.
+  int64_t ReadAt(void* buffer, int64_t num_bytes, int64_t position);
+  int64_t WriteAt(const void* buffer, int64_t num_bytes, int64_t position);
+
+  // WriteGather attempts to write count buffers with a single system
+  // call. It returns the number of bytes written, which can end in the
+  // middle of a buffer. WriteGatherFully loops until all buffers have
+  // been written or an error occurs.
+  int64_t WriteGather(const void* const* buffers,
+                      const int64_t* lengths,
+                      intptr_t count);
+  bool WriteGatherFully(const void* const* buffers,
+                        const int64_t* lengths,
+                        intptr_t count);
+
   // ReadFully and WriteFully do attempt to transfer num_bytes to/from
   // the buffer. In the event of short accesses they will loop internally until
   // the whole buffer has been transferred or an error occurs. If an error
@@ -106,11 +200,23 @@ class File {
   // Flush contents of file.
   bool Flush();
 
+  // Flush the data of the file to the storage device. Unlike Flush it
+  // does not wait for metadata not needed to read the data back, such
+  // as the modification time, to be written.
+  bool FlushData();
+
+  // Hint to the OS that the file is going to be read sequentially from
+  // the current position so it can read ahead more aggressively.
+  void AdviseSequentialRead();
+
   // Returns whether the file has been closed.
   bool IsClosed();
 
   const char* name() const { return name_; }
 
+  // Returns the OS file descriptor of the file.
+  intptr_t GetFD();
+
   // Open the file with the given name. The file is always opened for
   // reading. If mode contains kWrite the file is opened for both
   // reading and writing. If mode contains kWrite and the file does
@@ -122,11 +228,37 @@ class File {
   // (stdin, stout or stderr).
   static File* OpenStdio(int fd);
 
+  // Create a file object for a file descriptor of an open regular
+  // file. The file object takes ownership of the file descriptor.
+  static File* FromFD(intptr_t fd);
+
+  // Map length bytes of the file with the given name starting at
+  // offset into memory. With kMapRead changes to the memory are
+  // private to the process. With kMapWrite they are written back to
+  // the file. The advice is passed on to the OS as a hint about the
+  // expected access pattern. Returns NULL if the file could not be
+  // mapped or the region does not lie within the file.
+  static MappedMemory* Map(const char* name,
+                           int64_t offset,
+                           int64_t length,
+                           MapMode mode,
+                           MapAdvice advice);
+
   static bool Exists(const char* name);
   static bool Create(const char* name);
   static bool Delete(const char* name);
+  // Copy the content of the file old_path to new_path, creating or
+  // truncating new_path. The data is copied by the OS without passing
+  // through this process where possible. Fails if new_path refers to
+  // the same file as old_path.
+  static bool Copy(const char* old_path, const char* new_path);
   static off_t LengthFromName(const char* name);
   static time_t LastModified(const char* name);
+  // Get the type, size, modification time in seconds, permission bits
+  // and inode number of the file with a single system call. data must
+  // have room for kStatFieldCount values indexed by StatField. Returns
+  // false if the file cannot be accessed.
+  static bool Stat(const char* name, int64_t* data);
   static bool IsAbsolutePath(const char* pathname);
   static char* GetCanonicalPath(const char* name);
   static char* GetContainingDirectory(char* name);
@@ -136,7 +268,9 @@ class File {
 
   static FileOpenMode DartModeToFileMode(DartFileOpenMode mode);
 
-  static Dart_Port GetServicePort();
+  // Get a port for the file service. Requests with the same non-zero
+  // ordering key are handled in order.
+  static Dart_Port GetServicePort(intptr_t ordering_key);
 
  private:
   File(const char* name, FileHandle* handle) : name_(name), handle_(handle) { }
@@ -151,11 +285,6 @@ class File {
   // DISALLOW_COPY_AND_ASSIGN(File).
   File(const File&);
   void operator=(const File&);
-
-  static dart::Mutex mutex_;
-  static int service_ports_size_;
-  static Dart_Port* service_ports_;
-  static int service_ports_index_;
 };
 
 #endif  // BIN_FILE_H_
@@ -3,7 +3,7 @@
 // BSD-style license that can be found in the LICENSE file.
 
 class _FileInputStream extends _BaseDataInputStream implements InputStream {
-  _FileInputStream(String name)
+  _FileInputStream(String name, [int this._readAheadBuffers = 0])
       : _data = const [],
         _position = 0,
         _filePosition = 0 {
@@ -19,7 +19,8 @@ class _FileInputStream extends _BaseDataInputStream implements InputStream {
   _FileInputStream.fromStdio(int fd)
       : _data = const [],
         _position = 0,
-        _filePosition = 0 {
+        _filePosition = 0,
+        _readAheadBuffers = 0 {
     assert(fd == 0);
     _setupOpenedFile(_File._openStdioSync(fd));
   }
@@ -35,6 +36,7 @@ class _FileInputStream extends _BaseDataInputStream implements InputStream {
     var futureOpen = _openedFile.length();
     futureOpen.then((len) {
       _fileLength = len;
+      if (_readAheadBuffers > 0 && len > 0) _startReadAhead();
       _fillBuffer();
     });
     futureOpen.handleException((e) {
@@ -43,7 +45,61 @@ class _FileInputStream extends _BaseDataInputStream implements InputStream {
     });
   }
 
+  void _startReadAhead() {
+    _readAheadChunks = new Queue<List<int>>();
+    _readAheadPort = new ReceivePort();
+    _readAheadPort.receive((message, replyTo) {
+      if (_readAheadId == null) return;  // Stopped.
+      if (message == null) {
+        _readAheadDone = true;
+      } else if (message[0] != _FileUtils.SUCCESS_RESPONSE) {
+        _stopReadAhead();
+        var err =
+            new OSError(message[_FileUtils.OSERROR_RESPONSE_MESSAGE],
+                        message[_FileUtils.OSERROR_RESPONSE_ERROR_CODE]);
+        _reportError(new FileIOException("Cannot read file", err));
+        return;
+      } else {
+        _readAheadChunks.addLast(message[1]);
+      }
+      if (_position == _data.length) _fillBuffer();
+    });
+    var result = _FileUtils.startReadAhead(_openedFile._id,
+                                           _readAheadBuffers,
+                                           _bufferLength,
+                                           _readAheadPort.toSendPort());
+    if (result is OSError) {
+      // Fall back to reading on demand.
+      _readAheadPort.close();
+      _readAheadPort = null;
+      return;
+    }
+    _readAheadId = result;
+  }
+
+  void _stopReadAhead() {
+    if (_readAheadId == null) return;
+    // Stopping waits for the background read to let go of the file.
+    _FileUtils.stopReadAhead(_readAheadId);
+    _readAheadId = null;
+    _readAheadPort.close();
+  }
+
+  void _fillBufferFromReadAhead() {
+    if (_readAheadChunks.isEmpty()) {
+      // Wait for the next buffer unless the whole file has been read.
+      if (_readAheadDone) _closeFile();
+      return;
+    }
+    _data = _readAheadChunks.removeFirst();
+    _position = 0;
+    _filePosition += _data.length;
+    _FileUtils.readAheadConsumed(_readAheadId);
+    _checkScheduleCallbacks();
+  }
+
   void _closeFile() {
+    _stopReadAhead();
     if (_openedFile == null) {
       _streamMarkedClosed = true;
       return;
@@ -60,8 +116,14 @@ class _FileInputStream extends _BaseDataInputStream implements InputStream {
   void _fillBuffer() {
     Expect.equals(_position, _data.length);
     if (_openedFile == null) return;  // Called before the file is opened.
+    if (_readAheadId != null) {
+      _fillBufferFromReadAhead();
+      return;
+    }
     int size = Math.min(_bufferLength, _fileLength - _filePosition);
-    if (size == 0) {
+    // The read ahead thread reads to the end of file which can be
+    // beyond the length of the file when it was opened.
+    if (size <= 0) {
       _closeFile();
       return;
     }
@@ -148,6 +210,14 @@ class _FileInputStream extends _BaseDataInputStream implements InputStream {
   int _filePosition;
   int _fileLength;
   bool _activeFillBufferCall = false;
+
+  // Read ahead state. _readAheadId is the native read ahead object
+  // while the background thread is reading.
+  final int _readAheadBuffers;
+  int _readAheadId;
+  ReceivePort _readAheadPort;
+  Queue<List<int>> _readAheadChunks;
+  bool _readAheadDone = false;
 }
 
 
@@ -322,6 +392,18 @@ class _FileUtils {
   static final READ_LIST_REQUEST = 16;
   static final WRITE_LIST_REQUEST = 17;
   static final WRITE_STRING_REQUEST = 18;
+  static final READ_AT_REQUEST = 19;
+  static final WRITE_AT_REQUEST = 20;
+  static final READ_WHOLE_FILE_REQUEST = 21;
+  static final COPY_REQUEST = 22;
+  static final STAT_REQUEST = 23;
+  static final STAT_LIST_REQUEST = 24;
+
+  static final STAT_TYPE = 0;
+  static final STAT_SIZE = 1;
+  static final STAT_MODIFIED = 2;
+  static final STAT_MODE = 3;
+  static final STAT_INODE = 4;
 
   static final SUCCESS_RESPONSE = 0;
   static final ILLEGAL_ARGUMENT_RESPONSE = 1;
@@ -358,14 +440,35 @@ class _FileUtils {
     return [outBuffer, outOffset];
   }
 
+  // Pack the bytes to write into a byte array before posting them to a
+  // file service port. Only byte arrays are sent as a single block of
+  // data, any other list is serialized element by element and in full
+  // even if only a small range is written.
+  static List ensureByteArrayBuffer(List buffer, int offset, int bytes) {
+    if (buffer is Uint8List) return [buffer, offset];
+    Uint8List outBuffer = new Uint8List(bytes);
+    try {
+      outBuffer.setRange(0, bytes, buffer, offset);
+    } catch (var e) {
+      // Fall back to copying element by element to report the
+      // offending element.
+      return ensureFastAndSerializableBuffer(buffer, offset, bytes);
+    }
+    return [outBuffer, 0];
+  }
+
   static exists(String name) native "File_Exists";
   static open(String name, int mode) native "File_Open";
   static create(String name) native "File_Create";
   static delete(String name) native "File_Delete";
+  static copy(String name, String newPath) native "File_Copy";
   static fullPath(String name) native "File_FullPath";
   static directory(String name) native "File_Directory";
   static lengthFromName(String name) native "File_LengthFromName";
   static lastModified(String name) native "File_LastModified";
+  static stat(String name) native "File_Stat";
+  static mmap(String name, int offset, int length, int mode, int advice)
+      native "File_Mmap";
   static int close(int id) native "File_Close";
   static readByte(int id) native "File_ReadByte";
   static readList(int id, List<int> buffer, int offset, int bytes)
@@ -381,13 +484,46 @@ class _FileUtils {
   static writeListNative(int id, List<int> buffer, int offset, int bytes)
       native "File_WriteList";
   static writeString(int id, String string) native "File_WriteString";
+  static readAt(int id, List<int> buffer, int offset, int bytes, int position)
+      native "File_ReadAt";
+  static writeAt(int id, List<int> buffer, int offset, int bytes, int position) {
+    List result =
+        _FileUtils.ensureFastAndSerializableBuffer(buffer, offset, bytes);
+    List outBuffer = result[0];
+    int outOffset = result[1];
+    return writeAtNative(id, outBuffer, outOffset, bytes, position);
+  }
+  static writeAtNative(int id,
+                       List<int> buffer,
+                       int offset,
+                       int bytes,
+                       int position) native "File_WriteAt";
   static position(int id) native "File_Position";
   static setPosition(int id, int position) native "File_SetPosition";
   static truncate(int id, int length) native "File_Truncate";
   static length(int id) native "File_Length";
   static flush(int id) native "File_Flush";
   static int openStdio(int fd) native "File_OpenStdio";
-  static SendPort newServicePort() native "File_NewServicePort";
+  static startReadAhead(int id, int buffers, int bufferLength, SendPort port)
+      native "File_StartReadAhead";
+  static void readAheadConsumed(int id) native "File_ReadAheadConsumed";
+  static void stopReadAhead(int id) native "File_StopReadAhead";
+  static openAppendLog(String name, SendPort port) native "AppendLog_Open";
+  static appendToLog(int id, List<int> buffer, int offset, int bytes) {
+    List result =
+        _FileUtils.ensureFastAndSerializableBuffer(buffer, offset, bytes);
+    List outBuffer = result[0];
+    int outOffset = result[1];
+    return appendToLogNative(id, outBuffer, outOffset, bytes);
+  }
+  static appendToLogNative(int id, List<int> buffer, int offset, int bytes)
+      native "AppendLog_Append";
+  static void closeAppendLog(int id) native "AppendLog_Close";
+  // Requests posted to service ports with the same non-zero ordering
+  // key are handled in order. Use NO_ORDERING_KEY for requests which
+  // do not depend on each other.
+  static final NO_ORDERING_KEY = 0;
+  static SendPort newServicePort(int orderingKey) native "File_NewServicePort";
 
   static bool checkedExists(String name) {
     if (name is !String) throw new IllegalArgumentException();
@@ -417,6 +553,15 @@ class _FileUtils {
     return true;
   }
 
+  static bool checkedCopy(String name, String newPath) {
+    if (name is !String || newPath is !String) {
+      throw new IllegalArgumentException();
+    }
+    var result = copy(name, newPath);
+    throwIfError(result, "Cannot copy file '$name' to '$newPath'");
+    return true;
+  }
+
   static String checkedFullPath(String name) {
     if (name is !String) throw new IllegalArgumentException();
     var result = fullPath(name);
@@ -445,6 +590,19 @@ class _FileUtils {
     return result;
   }
 
+  static List<int> checkedMmap(String name,
+                               int offset,
+                               int length,
+                               int mode,
+                               int advice) {
+    if (name is !String || offset is !int || length is !int) {
+      throw new IllegalArgumentException();
+    }
+    var result = mmap(name, offset, length, mode, advice);
+    throwIfError(result, "Cannot map file '$name'");
+    return result;
+  }
+
   static int checkReadWriteListArguments(int length, int offset, int bytes) {
     if (offset < 0) return offset;
     if (bytes < 0) return bytes;
@@ -457,6 +615,40 @@ class _FileUtils {
     return writeString(id, string);
   }
 
+  static FileStat checkedStat(String name) {
+    if (name is !String) throw new IllegalArgumentException();
+    var result = stat(name);
+    throwIfError(result, "Cannot stat file '$name'");
+    return statFromList(result);
+  }
+
+  static FileStat statFromList(List data) {
+    if (data == null) return null;
+    return new FileStat._internal(
+        data[STAT_TYPE],
+        data[STAT_SIZE],
+        new Date.fromMillisecondsSinceEpoch(data[STAT_MODIFIED]),
+        data[STAT_MODE],
+        data[STAT_INODE]);
+  }
+
+  static Future<List<FileStat>> statList(List<String> paths) {
+    List request = new List(2);
+    request[0] = STAT_LIST_REQUEST;
+    request[1] = paths;
+    SendPort fileService = newServicePort(NO_ORDERING_KEY);
+    return fileService.call(request).transform((response) {
+      if (response is List && response[0] != SUCCESS_RESPONSE) {
+        throw new IllegalArgumentException();
+      }
+      List<FileStat> result = new List<FileStat>(paths.length);
+      for (int i = 0; i < paths.length; i++) {
+        result[i] = statFromList(response[1][i]);
+      }
+      return result;
+    });
+  }
+
   static throwIfError(Object result, String msg) {
     if (result is OSError) {
       throw new FileIOException(msg, result);
@@ -546,6 +738,27 @@ class _File extends _FileBase implements File {
     _FileUtils.checkedDelete(_name);
   }
 
+  Future<File> copy(String newPath) {
+    _ensureFileService();
+    List request = new List(3);
+    request[0] = _FileUtils.COPY_REQUEST;
+    request[1] = _name;
+    request[2] = newPath;
+    return _fileService.call(request).transform((response) {
+      if (_isErrorResponse(response)) {
+        throw _exceptionFromResponse(response,
+                                     "Cannot copy file '$_name' to "
+                                     "'$newPath'");
+      }
+      return new File(newPath);
+    });
+  }
+
+  File copySync(String newPath) {
+    _FileUtils.checkedCopy(_name, newPath);
+    return new File(newPath);
+  }
+
   Future<Directory> directory() {
     _ensureFileService();
     List request = new List(2);
@@ -628,6 +841,23 @@ class _File extends _FileBase implements File {
     return new Date.fromMillisecondsSinceEpoch(ms);
   }
 
+  Future<FileStat> stat() {
+    _ensureFileService();
+    List request = new List(2);
+    request[0] = _FileUtils.STAT_REQUEST;
+    request[1] = _name;
+    return _fileService.call(request).transform((response) {
+      if (_isErrorResponse(response)) {
+        throw _exceptionFromResponse(response, "Cannot stat file '$_name'");
+      }
+      return _FileUtils.statFromList(response[1]);
+    });
+  }
+
+  FileStat statSync() {
+    return _FileUtils.checkedStat(_name);
+  }
+
   RandomAccessFile openSync([FileMode mode = FileMode.READ]) {
     if (mode != FileMode.READ &&
         mode != FileMode.WRITE &&
@@ -640,6 +870,26 @@ class _File extends _FileBase implements File {
     return new _RandomAccessFile(id, _name);
   }
 
+  List<int> mmapSync(int offset,
+                     int length,
+                     [MmapMode mode = MmapMode.READ,
+                      MmapAdvice advice = MmapAdvice.NORMAL]) {
+    if (mode != MmapMode.READ && mode != MmapMode.WRITE) {
+      throw new FileIOException("Unknown mmap mode. Use MmapMode.READ "
+                                "or MmapMode.WRITE.");
+    }
+    if (offset is !int || length is !int || offset < 0 || length < 0) {
+      throw new IllegalArgumentException();
+    }
+    // Mapping zero bytes is not supported by the operating system.
+    if (length == 0) return new Uint8List(0);
+    return _FileUtils.checkedMmap(_name,
+                                  offset,
+                                  length,
+                                  mode._mode,
+                                  advice._advice);
+  }
+
   static RandomAccessFile _openStdioSync(int fd) {
     var id = _FileUtils.openStdio(fd);
     if (id == 0) {
@@ -667,8 +917,11 @@ class _File extends _FileBase implements File {
     return _FileUtils.checkedFullPath(_name);
   }
 
-  InputStream openInputStream() {
-    return new _FileInputStream(_name);
+  InputStream openInputStream([int readAheadBuffers = 0]) {
+    if (readAheadBuffers is !int || readAheadBuffers < 0) {
+      throw new IllegalArgumentException();
+    }
+    return new _FileInputStream(_name, readAheadBuffers);
   }
 
   OutputStream openOutputStream([FileMode mode = FileMode.WRITE]) {
@@ -680,20 +933,27 @@ class _File extends _FileBase implements File {
     return new _FileOutputStream(_name, mode);
   }
 
+  FileSystemWatcher watch() {
+    return new _FileSystemWatcher(_name);
+  }
+
+  AppendLog openAppendLog() {
+    return new _AppendLog(_name);
+  }
+
   Future<List<int>> readAsBytes() {
     _ensureFileService();
-    Completer<List<int>> completer = new Completer<List<int>>();
-    var chunks = new _BufferList();
-    var stream = openInputStream();
-    stream.onClosed = () {
-      completer.complete(chunks.readBytes(chunks.length));
-    };
-    stream.onData = () {
-      var chunk = stream.read();
-      chunks.add(chunk);
-    };
-    stream.onError = completer.completeException;
-    return completer.future;
+    // Open, read and close the file in a single request.
+    List request = new List(2);
+    request[0] = _FileUtils.READ_WHOLE_FILE_REQUEST;
+    request[1] = _name;
+    return _fileService.call(request).transform((response) {
+      if (_isErrorResponse(response)) {
+        throw _exceptionFromResponse(response,
+                                     "Cannot read file '$_name'");
+      }
+      return response[1];
+    });
   }
 
   List<int> readAsBytesSync() {
@@ -761,7 +1021,7 @@ class _File extends _FileBase implements File {
 
   void _ensureFileService() {
     if (_fileService == null) {
-      _fileService = _FileUtils.newServicePort();
+      _fileService = _FileUtils.newServicePort(_FileUtils.NO_ORDERING_KEY);
     }
   }
 
@@ -784,6 +1044,17 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
     // Set the id_ to 0 (NULL) to ensure the no more async requests
     // can be issued for this file.
     _id = 0;
+    if (_pendingPositionalRequests > 0) {
+      // Positional requests run on other service ports. Delay the
+      // close until they are done as they still use the file.
+      _pendingCloseRequest = request;
+      _pendingClose = completer;
+      return completer.future;
+    }
+    return _sendCloseRequest(request);
+  }
+
+  Future<RandomAccessFile> _sendCloseRequest(List request) {
     return _fileService.call(request).transform((result) {
       if (result != -1) {
         _id = result;
@@ -794,8 +1065,33 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
     });
   }
 
+  SendPort _positionalRequestPort() {
+    _pendingPositionalRequests++;
+    return _FileUtils.newServicePort(_FileUtils.NO_ORDERING_KEY);
+  }
+
+  void _positionalRequestDone() {
+    _pendingPositionalRequests--;
+    if (_pendingPositionalRequests == 0 && _pendingClose != null) {
+      Completer<RandomAccessFile> completer = _pendingClose;
+      Future<RandomAccessFile> future =
+          _sendCloseRequest(_pendingCloseRequest);
+      _pendingClose = null;
+      _pendingCloseRequest = null;
+      future.then(completer.complete);
+      future.handleException((e) {
+        completer.completeException(e);
+        return true;
+      });
+    }
+  }
+
   void closeSync() {
     _checkNotClosed();
+    if (_pendingPositionalRequests > 0) {
+      throw new FileIOException(
+          "Cannot close file '$_name' with pending readAt or writeAt");
+    }
     var id = _FileUtils.close(_id);
     if (id == -1) {
       throw new FileIOException("Cannot close file '$_name'");
@@ -936,8 +1232,7 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
 
     List result;
     try {
-      result =
-          _FileUtils.ensureFastAndSerializableBuffer(buffer, offset, bytes);
+      result = _FileUtils.ensureByteArrayBuffer(buffer, offset, bytes);
     } catch (var e) {
       // Complete asynchronously so the user has a chance to setup
       // handlers without getting exceptions when registering the
@@ -982,6 +1277,138 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
     return result;
   }
 
+  Future<int> readAt(List<int> buffer, int offset, int bytes, int position) {
+    Completer<int> completer = new Completer<int>();
+    if (buffer is !List ||
+        offset is !int ||
+        bytes is !int ||
+        position is !int ||
+        position < 0) {
+      // Complete asynchronously so the user has a chance to setup
+      // handlers without getting exceptions when registering the
+      // then handler.
+      new Timer(0, (t) {
+        completer.completeException(new FileIOException(
+            "Invalid arguments to readAt for file '$_name'"));
+      });
+      return completer.future;
+    };
+    if (closed) return _completeWithClosedException(completer);
+    List request = new List(4);
+    request[0] = _FileUtils.READ_AT_REQUEST;
+    request[1] = _id;
+    request[2] = bytes;
+    request[3] = position;
+    // Positional requests do not depend on each other so they are
+    // spread over the file service ports instead of being queued
+    // behind other requests on this file's port.
+    return _positionalRequestPort().call(request).transform((response) {
+      _positionalRequestDone();
+      if (_isErrorResponse(response)) {
+        throw _exceptionFromResponse(response,
+                                     "readAt failed for file '$_name'");
+      }
+      var read = response[1];
+      var data = response[2];
+      buffer.setRange(offset, read, data);
+      return read;
+    });
+  }
+
+  int readAtSync(List<int> buffer, int offset, int bytes, int position) {
+    _checkNotClosed();
+    if (buffer is !List ||
+        offset is !int ||
+        bytes is !int ||
+        position is !int ||
+        position < 0) {
+      throw new FileIOException(
+          "Invalid arguments to readAt for file '$_name'");
+    }
+    if (bytes == 0) return 0;
+    int index =
+        _FileUtils.checkReadWriteListArguments(buffer.length, offset, bytes);
+    if (index != 0) {
+      throw new IndexOutOfRangeException(index);
+    }
+    var result = _FileUtils.readAt(_id, buffer, offset, bytes, position);
+    if (result is OSError) {
+      throw new FileIOException("readAt failed for file '$_name'", result);
+    }
+    return result;
+  }
+
+  Future<int> writeAt(List<int> buffer, int offset, int bytes, int position) {
+    Completer<int> completer = new Completer<int>();
+    if (buffer is !List ||
+        offset is !int ||
+        bytes is !int ||
+        position is !int ||
+        position < 0) {
+      // Complete asynchronously so the user has a chance to setup
+      // handlers without getting exceptions when registering the
+      // then handler.
+      new Timer(0, (t) {
+          completer.completeException(new FileIOException(
+          "Invalid arguments to writeAt for file '$_name'"));
+      });
+      return completer.future;
+    }
+    if (closed) return _completeWithClosedException(completer);
+
+    List result;
+    try {
+      result = _FileUtils.ensureByteArrayBuffer(buffer, offset, bytes);
+    } catch (var e) {
+      // Complete asynchronously so the user has a chance to setup
+      // handlers without getting exceptions when registering the
+      // then handler.
+      new Timer(0, (t) => completer.completeException(e));
+      return completer.future;
+    }
+    List outBuffer = result[0];
+    int outOffset = result[1];
+
+    List request = new List(6);
+    request[0] = _FileUtils.WRITE_AT_REQUEST;
+    request[1] = _id;
+    request[2] = outBuffer;
+    request[3] = outOffset;
+    request[4] = bytes;
+    request[5] = position;
+    return _positionalRequestPort().call(request).transform((response) {
+      _positionalRequestDone();
+      if (_isErrorResponse(response)) {
+        throw _exceptionFromResponse(response,
+                                     "writeAt failed for file '$_name'");
+      }
+      return response;
+    });
+  }
+
+  int writeAtSync(List<int> buffer, int offset, int bytes, int position) {
+    _checkNotClosed();
+    if (buffer is !List ||
+        offset is !int ||
+        bytes is !int ||
+        position is !int ||
+        position < 0) {
+      throw new FileIOException(
+          "Invalid arguments to writeAt for file '$_name'");
+    }
+    if (bytes == 0) return 0;
+    int index =
+        _FileUtils.checkReadWriteListArguments(buffer.length, offset, bytes);
+    if (index != 0) {
+      throw new IndexOutOfRangeException(index);
+    }
+    var result = _FileUtils.writeAt(_id, buffer, offset, bytes, position);
+    if (result is OSError) {
+      throw new FileIOException("writeAt failed for file '$_name'", result);
+    }
+    return result;
+  }
+
   Future<RandomAccessFile> writeString(String string,
                                        [Encoding encoding = Encoding.UTF_8]) {
     _ensureFileService();
@@ -1137,7 +1564,9 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
 
   void _ensureFileService() {
     if (_fileService == null) {
-      _fileService = _FileUtils.newServicePort();
+      // Use the file as ordering key to keep the requests on this file
+      // in order.
+      _fileService = _FileUtils.newServicePort(_id);
     }
   }
 
@@ -1161,4 +1590,200 @@ class _RandomAccessFile extends _FileBase implements RandomAccessFile {
   int _id;
 
   SendPort _fileService;
+
+  // Number of readAt and writeAt requests in flight and the close
+  // request waiting for them to complete.
+  int _pendingPositionalRequests = 0;
+  List _pendingCloseRequest;
+  Completer<RandomAccessFile> _pendingClose;
+}
+
+
+class _PendingAppend {
+  _PendingAppend(int this.bytes) : completer = new Completer<int>();
+  final int bytes;
+  final Completer<int> completer;
+}
+
+
+class _AppendLog implements AppendLog {
+  _AppendLog(String this._name) {
+    _pendingAppends = new Queue<_PendingAppend>();
+    _port = new ReceivePort();
+    _port.receive((message, replyTo) => _handleMessage(message));
+    var result = _FileUtils.openAppendLog(_name, _port.toSendPort());
+    if (result is OSError) {
+      _port.close();
+      throw new FileIOException("Cannot open append log '$_name'", result);
+    }
+    _id = result;
+  }
+
+  Future<int> append(List<int> buffer, [int offset = 0, int bytes]) {
+    Completer<int> completer = new Completer<int>();
+    if (buffer is List && offset is int && bytes == null) {
+      bytes = buffer.length - offset;
+    }
+    if (buffer is !List || offset is !int || bytes is !int) {
+      // Complete asynchronously so the user has a chance to setup
+      // handlers without getting exceptions when registering the
+      // then handler.
+      new Timer(0, (t) {
+        completer.completeException(new FileIOException(
+            "Invalid arguments to append for append log '$_name'"));
+      });
+      return completer.future;
+    }
+    int index =
+        _FileUtils.checkReadWriteListArguments(buffer.length, offset, bytes);
+    if (index != 0 || _id == null) {
+      new Timer(0, (t) {
+        completer.completeException(_id == null
+            ? new FileIOException("Append log closed '$_name'")
+            : new IndexOutOfRangeException(index));
+      });
+      return completer.future;
+    }
+    _PendingAppend pending = new _PendingAppend(bytes);
+    _pendingAppends.addLast(pending);
+    _FileUtils.appendToLog(_id, buffer, offset, bytes);
+    return pending.completer.future;
+  }
+
+  Future<AppendLog> close() {
+    if (_closeCompleter == null) {
+      _closeCompleter = new Completer<AppendLog>();
+      // The log posts null when the records appended so far have been
+      // written and the file is closed.
+      _FileUtils.closeAppendLog(_id);
+      _id = null;
+    }
+    return _closeCompleter.future;
+  }
+
+  String get name() => _name;
+
+  void _handleMessage(message) {
+    if (message == null) {
+      _port.close();
+      _closeCompleter.complete(this);
+      return;
+    }
+    if (message[0] == _FileUtils.SUCCESS_RESPONSE) {
+      int count = message[_BATCH_COUNT];
+      // The message carries the length of the file after the batch.
+      // Work back to where the batch started to find the length after
+      // each record.
+      List<_PendingAppend> batch = new List<_PendingAppend>(count);
+      int length = message[_BATCH_LENGTH];
+      for (int i = 0; i < count; i++) {
+        batch[i] = _pendingAppends.removeFirst();
+        length -= batch[i].bytes;
+      }
+      for (int i = 0; i < count; i++) {
+        length += batch[i].bytes;
+        batch[i].completer.complete(length);
+      }
+    } else {
+      var err = new OSError(message[_FileUtils.OSERROR_RESPONSE_MESSAGE],
+                            message[_FileUtils.OSERROR_RESPONSE_ERROR_CODE]);
+      int count = message[_ERROR_COUNT];
+      for (int i = 0; i < count; i++) {
+        _pendingAppends.removeFirst().completer.completeException(
+            new FileIOException("Cannot append to log '$_name'", err));
+      }
+    }
+  }
+
+  // Index of the number of records and the file length in batch
+  // messages. Error messages have the number of records after the
+  // error code and message.
+  static final int _BATCH_COUNT = 1;
+  static final int _BATCH_LENGTH = 2;
+  static final int _ERROR_COUNT = 3;
+
+  final String _name;
+  int _id;
+  ReceivePort _port;
+  Queue<_PendingAppend> _pendingAppends;
+  Completer<AppendLog> _closeCompleter;
+}
+
+
+// All watches share one inotify instance, which is registered with
+// the event handler. The event handler reads and decodes the changes
+// and posts them to the port of each watch, followed by null when the
+// watch has ended.
+class _FileSystemWatcher implements FileSystemWatcher {
+  _FileSystemWatcher(String this._path) {
+    _port = new ReceivePort();
+    var result = _watch(_path, _port.toSendPort());
+    if (result is OSError) {
+      _port.close();
+      throw new FileIOException("Cannot watch '$_path'", result);
+    }
+    _id = result;
+    _port.receive((message, replyTo) => _handleChanges(message));
+    _EventHandler._start();
+    _EventHandler._sendData(_instance(),
+                            _port,
+                            (1 << _SocketBase._IN_EVENT) |
+                            (1 << _SocketBase._FILE_SYSTEM_WATCH));
+  }
+
+  void set onChange(void onChange(List<FileSystemEvent> events)) {
+    _onChange = onChange;
+  }
+
+  void set onError(void onError(e)) {
+    _onError = onError;
+  }
+
+  void close() {
+    if (_id < 0) return;
+    _unwatch(_id, _port.toSendPort());
+    _port.close();
+    _id = -1;
+  }
+
+  void _handleChanges(List changes) {
+    if (_id < 0) return;
+    if (changes == null) {
+      _reportError(new FileIOException(
+          "Stopped watching '$_path' as it was deleted or moved"));
+      return;
+    }
+    if (_onChange != null) {
+      List<FileSystemEvent> events =
+          new List<FileSystemEvent>(changes.length ~/ 2);
+      for (int i = 0; i < events.length; i++) {
+        String name = changes[2 * i + 1];
+        String path = (name == null)
+            ? _path
+            : "$_path${Platform.pathSeparator}$name";
+        events[i] = new FileSystemEvent._internal(changes[2 * i], path);
+      }
+      _onChange(events);
+    }
+  }
+
+  void _reportError(e) {
+    close();
+    if (_onError != null) {
+      _onError(e);
+    } else {
+      throw e;
+    }
+  }
+
+  static _watch(String path, SendPort port) native "FileSystemWatcher_Watch";
+  static void _unwatch(int id, SendPort port)
+      native "FileSystemWatcher_Unwatch";
+  static int _instance() native "FileSystemWatcher_GetInstance";
+
+  final String _path;
+  int _id;
+  ReceivePort _port;
+  Function _onChange;
+  Function _onError;
 }
@@ -0,0 +1,54 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef BIN_FILE_IO_ENGINE_H_
+#define BIN_FILE_IO_ENGINE_H_
+
+#include "bin/builtin.h"
+#include "bin/file.h"
+
+// Asynchronous engine for file service requests. An operation submitted
+// to the engine does not block the calling service port thread. When
+// the operation completes its response is posted directly to the reply
+// port in the same format as the synchronous file service response.
+//
+// The engine is backed by io_uring on Linux. The Submit functions
+// return false if the engine is not available, e.g. on other platforms
+// or on kernels without io_uring support, or if too many operations
+// are in flight. The caller then handles the request synchronously.
+class FileIOEngine {
+ public:
+  // Read up to length bytes at position. Responds like a read list
+  // request.
+  static bool SubmitReadAt(File* file,
+                           int64_t length,
+                           int64_t position,
+                           Dart_Port reply_port);
+
+  // Write length bytes at position. The bytes are copied so the buffer
+  // can be released when the call returns. Responds with the number of
+  // bytes written.
+  static bool SubmitWriteAt(File* file,
+                            const uint8_t* buffer,
+                            int64_t length,
+                            int64_t position,
+                            Dart_Port reply_port);
+
+  // Open the file with the given name. Responds with the new file
+  // object.
+  static bool SubmitOpen(const char* name,
+                         File::FileOpenMode mode,
+                         Dart_Port reply_port);
+
+  // Stat the file with the given name. Responds with the length or the
+  // last modification time in milliseconds.
+  static bool SubmitLength(const char* name, Dart_Port reply_port);
+  static bool SubmitLastModified(const char* name, Dart_Port reply_port);
+
+ private:
+  DISALLOW_ALLOCATION();
+  DISALLOW_IMPLICIT_CONSTRUCTORS(FileIOEngine);
+};
+
+#endif  // BIN_FILE_IO_ENGINE_H_
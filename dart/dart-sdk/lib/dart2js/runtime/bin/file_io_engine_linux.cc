@@ -0,0 +1,531 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/file_io_engine.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bin/thread.h"
+#include "bin/utils.h"
+#include "platform/thread.h"
+
+
+// Has to be kept in sync with OSERROR_RESPONSE in file_impl.dart.
+static const int32_t kOSErrorResponse = 2;
+static const int32_t kSuccessResponse = 0;
+static const int kMSPerSecond = 1000;
+
+
+// An operation submitted to the ring. The address of the operation is
+// the user data of its submission queue entry.
+class FileIOOperation {
+ public:
+  enum Type {
+    kReadAt,
+    kWriteAt,
+    kOpen,
+    kLength,
+    kLastModified
+  };
+
+  FileIOOperation(Type type, Dart_Port reply_port)
+      : type(type),
+        reply_port(reply_port),
+        buffer(NULL),
+        length(0),
+        mode(File::kRead),
+        path(NULL) {
+    memset(&stat_buffer, 0, sizeof(stat_buffer));
+  }
+
+  ~FileIOOperation() {
+    free(buffer);
+    free(path);
+  }
+
+  Type type;
+  Dart_Port reply_port;
+  uint8_t* buffer;
+  int64_t length;
+  File::FileOpenMode mode;
+  char* path;
+  struct statx stat_buffer;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileIOOperation);
+};
+
+
+class IOUring {
+ public:
+  // Number of submission queue entries. The kernel sizes the completion
+  // queue to twice this.
+  static const unsigned kEntries = 256;
+
+  IOUring() : ring_fd_(-1), in_flight_(0), max_in_flight_(0) { }
+
+  // Set up the ring and start the completion thread. Returns false if
+  // io_uring is not supported.
+  bool Start();
+
+  // Queue an operation. Returns false if the ring is full.
+  bool Submit(FileIOOperation* operation,
+              uint8_t opcode,
+              int fd,
+              uint64_t address,
+              uint32_t length,
+              uint64_t offset,
+              uint32_t op_flags);
+
+ private:
+  static void CompletionThread(uword args);
+  void HandleCompletions();
+  void Complete(FileIOOperation* operation, int32_t result);
+
+  int ring_fd_;
+  dart::Mutex mutex_;
+  intptr_t in_flight_;
+  intptr_t max_in_flight_;
+
+  // Submission queue.
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_mask_;
+  unsigned* sq_array_;
+  struct io_uring_sqe* sqes_;
+
+  // Completion queue.
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned* cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOUring);
+};
+
+
+static int IOUringSetup(unsigned entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+
+static int IOUringRegister(int fd,
+                           unsigned opcode,
+                           void* arg,
+                           unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+// Returns whether the kernel supports every opcode the engine submits.
+// IORING_OP_READ and IORING_OP_WRITE need Linux 5.6, as does
+// IORING_REGISTER_PROBE itself, so older kernels fail the probe.
+static bool SupportsOpcodes(int ring_fd) {
+  static const uint8_t kOpcodes[] = {
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_OPENAT,
+    IORING_OP_STATX
+  };
+  size_t size = sizeof(struct io_uring_probe) +
+      IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe* probe =
+      reinterpret_cast<struct io_uring_probe*>(calloc(1, size));
+  bool supported =
+      IOUringRegister(ring_fd, IORING_REGISTER_PROBE, probe,
+                      IORING_OP_LAST) == 0;
+  size_t count = sizeof(kOpcodes) / sizeof(kOpcodes[0]);
+  for (size_t i = 0; supported && i < count; i++) {
+    uint8_t opcode = kOpcodes[i];
+    supported = (opcode <= probe->last_op) &&
+        ((probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0);
+  }
+  free(probe);
+  return supported;
+}
+
+
+static int IOUringEnter(int fd,
+                        unsigned to_submit,
+                        unsigned min_complete,
+                        unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                 NULL, 0);
+}
+
+
+bool IOUring::Start() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = IOUringSetup(kEntries, &params);
+  if (fd < 0) return false;
+  // The rings are mapped with a single mapping below.
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 ||
+      !SupportsOpcodes(fd)) {
+    close(fd);
+    return false;
+  }
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  size_t ring_size = (sq_size > cq_size) ? sq_size : cq_size;
+  uint8_t* ring = reinterpret_cast<uint8_t*>(
+      mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING));
+  if (ring == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  void* sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    munmap(ring, ring_size);
+    close(fd);
+    return false;
+  }
+  ring_fd_ = fd;
+  sq_head_ = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+  sqes_ = reinterpret_cast<struct io_uring_sqe*>(sqes);
+  cq_head_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+  // Never have more operations in flight than the completion queue
+  // can hold.
+  max_in_flight_ = params.cq_entries;
+
+  int result = dart::Thread::Start(&IOUring::CompletionThread,
+                                   reinterpret_cast<uword>(this));
+  if (result != 0) {
+    FATAL1("Failed to start file I/O engine thread %d", result);
+  }
+  return true;
+}
+
+
+bool IOUring::Submit(FileIOOperation* operation,
+                     uint8_t opcode,
+                     int fd,
+                     uint64_t address,
+                     uint32_t length,
+                     uint64_t offset,
+                     uint32_t op_flags) {
+  MutexLocker locker(&mutex_);
+  unsigned tail = *sq_tail_;
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (in_flight_ == max_in_flight_ || tail - head == kEntries) {
+    return false;
+  }
+  unsigned index = tail & *sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = address;
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->rw_flags = op_flags;
+  sqe->user_data = reinterpret_cast<uint64_t>(operation);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  int result;
+  do {
+    result = IOUringEnter(ring_fd_, 1, 0, 0);
+  } while (result < 0 && errno == EINTR);
+  if (result != 1) {
+    // The kernel did not consume the entry. Take it back.
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+    return false;
+  }
+  in_flight_++;
+  return true;
+}
+
+
+void IOUring::CompletionThread(uword args) {
+  IOUring* ring = reinterpret_cast<IOUring*>(args);
+  while (true) {
+    int result = IOUringEnter(ring->ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    if (result < 0 && errno != EINTR) {
+      FATAL1("Failed to wait for file I/O completions %d", errno);
+    }
+    ring->HandleCompletions();
+  }
+}
+
+
+void IOUring::HandleCompletions() {
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  intptr_t completed = 0;
+  while (head != tail) {
+    struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+    FileIOOperation* operation =
+        reinterpret_cast<FileIOOperation*>(cqe->user_data);
+    int32_t result = cqe->res;
+    head++;
+    // Release the entry before posting the response as posting can
+    // take a while.
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    Complete(operation, result);
+    completed++;
+  }
+  MutexLocker locker(&mutex_);
+  in_flight_ -= completed;
+}
+
+
+static void PostOSError(Dart_Port reply_port, int error) {
+  OSError os_error;
+  os_error.SetCodeAndMessage(OSError::kSystem, error);
+  Dart_CObject type;
+  type.type = Dart_CObject::kInt32;
+  type.value.as_int32 = kOSErrorResponse;
+  Dart_CObject code;
+  code.type = Dart_CObject::kInt32;
+  code.value.as_int32 = os_error.code();
+  Dart_CObject message;
+  message.type = Dart_CObject::kString;
+  message.value.as_string = os_error.message();
+  Dart_CObject* values[3] = { &type, &code, &message };
+  Dart_CObject response;
+  response.type = Dart_CObject::kArray;
+  response.value.as_array.length = 3;
+  response.value.as_array.values = values;
+  Dart_PostCObject(reply_port, &response);
+}
+
+
+static void PostInt64(Dart_Port reply_port, int64_t value) {
+  Dart_CObject response;
+  response.type = Dart_CObject::kInt64;
+  response.value.as_int64 = value;
+  Dart_PostCObject(reply_port, &response);
+}
+
+
+static void PostReadResponse(Dart_Port reply_port,
+                             uint8_t* buffer,
+                             int32_t bytes_read) {
+  Dart_CObject success;
+  success.type = Dart_CObject::kInt32;
+  success.value.as_int32 = kSuccessResponse;
+  Dart_CObject count;
+  count.type = Dart_CObject::kInt64;
+  count.value.as_int64 = bytes_read;
+  Dart_CObject data;
+  data.type = Dart_CObject::kUint8Array;
+  data.value.as_byte_array.length = bytes_read;
+  data.value.as_byte_array.values = buffer;
+  Dart_CObject* values[3] = { &success, &count, &data };
+  Dart_CObject response;
+  response.type = Dart_CObject::kArray;
+  response.value.as_array.length = 3;
+  response.value.as_array.values = values;
+  Dart_PostCObject(reply_port, &response);
+}
+
+
+// Finish an open the same way File::Open does.
+static void CompleteOpen(FileIOOperation* operation, int fd) {
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(fstat(fd, &st)) != 0) {
+    int error = errno;
+    TEMP_FAILURE_RETRY(close(fd));
+    PostOSError(operation->reply_port, error);
+    return;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    TEMP_FAILURE_RETRY(close(fd));
+    PostOSError(operation->reply_port,
+                S_ISDIR(st.st_mode) ? EISDIR : ENOENT);
+    return;
+  }
+  if (((operation->mode & File::kWrite) != 0) &&
+      ((operation->mode & File::kTruncate) == 0)) {
+    if (TEMP_FAILURE_RETRY(lseek(fd, 0, SEEK_END)) < 0) {
+      int error = errno;
+      TEMP_FAILURE_RETRY(close(fd));
+      PostOSError(operation->reply_port, error);
+      return;
+    }
+  }
+  File* file = File::FromFD(fd);
+  PostInt64(operation->reply_port, reinterpret_cast<intptr_t>(file));
+}
+
+
+void IOUring::Complete(FileIOOperation* operation, int32_t result) {
+  if (result < 0) {
+    PostOSError(operation->reply_port, -result);
+    delete operation;
+    return;
+  }
+  switch (operation->type) {
+    case FileIOOperation::kReadAt:
+      PostReadResponse(operation->reply_port, operation->buffer, result);
+      break;
+    case FileIOOperation::kWriteAt:
+      PostInt64(operation->reply_port, result);
+      break;
+    case FileIOOperation::kOpen:
+      CompleteOpen(operation, result);
+      break;
+    case FileIOOperation::kLength:
+      PostInt64(operation->reply_port, operation->stat_buffer.stx_size);
+      break;
+    case FileIOOperation::kLastModified:
+      PostInt64(operation->reply_port,
+                operation->stat_buffer.stx_mtime.tv_sec * kMSPerSecond);
+      break;
+    default:
+      UNREACHABLE();
+  }
+  delete operation;
+}
+
+
+static dart::Mutex engine_mutex;
+static bool engine_started = false;
+static IOUring* engine = NULL;
+
+
+// Returns the ring, starting it on first use, or NULL if io_uring is
+// not supported.
+static IOUring* GetEngine() {
+  MutexLocker locker(&engine_mutex);
+  if (!engine_started) {
+    engine_started = true;
+    IOUring* ring = new IOUring();
+    if (ring->Start()) {
+      engine = ring;
+    } else {
+      delete ring;
+    }
+  }
+  return engine;
+}
+
+
+static bool Submit(FileIOOperation* operation,
+                   uint8_t opcode,
+                   int fd,
+                   uint64_t address,
+                   uint32_t length,
+                   uint64_t offset,
+                   uint32_t op_flags) {
+  IOUring* ring = GetEngine();
+  if (ring == NULL ||
+      !ring->Submit(operation, opcode, fd, address, length, offset,
+                    op_flags)) {
+    delete operation;
+    return false;
+  }
+  return true;
+}
+
+
+bool FileIOEngine::SubmitReadAt(File* file,
+                                int64_t length,
+                                int64_t position,
+                                Dart_Port reply_port) {
+  // A single operation transfers at most 2GB.
+  if (length > kMaxInt32) return false;
+  FileIOOperation* operation =
+      new FileIOOperation(FileIOOperation::kReadAt, reply_port);
+  operation->length = length;
+  operation->buffer = reinterpret_cast<uint8_t*>(malloc(length));
+  return Submit(operation,
+                IORING_OP_READ,
+                file->GetFD(),
+                reinterpret_cast<uint64_t>(operation->buffer),
+                length,
+                position,
+                0);
+}
+
+
+bool FileIOEngine::SubmitWriteAt(File* file,
+                                 const uint8_t* buffer,
+                                 int64_t length,
+                                 int64_t position,
+                                 Dart_Port reply_port) {
+  if (length > kMaxInt32) return false;
+  FileIOOperation* operation =
+      new FileIOOperation(FileIOOperation::kWriteAt, reply_port);
+  operation->length = length;
+  operation->buffer = reinterpret_cast<uint8_t*>(malloc(length));
+  memmove(operation->buffer, buffer, length);
+  return Submit(operation,
+                IORING_OP_WRITE,
+                file->GetFD(),
+                reinterpret_cast<uint64_t>(operation->buffer),
+                length,
+                position,
+                0);
+}
+
+
+bool FileIOEngine::SubmitOpen(const char* name,
+                              File::FileOpenMode mode,
+                              Dart_Port reply_port) {
+  FileIOOperation* operation =
+      new FileIOOperation(FileIOOperation::kOpen, reply_port);
+  operation->mode = mode;
+  operation->path = strdup(name);
+  int flags = O_RDONLY;
+  if ((mode & File::kWrite) != 0) {
+    flags = (O_RDWR | O_CREAT);
+  }
+  if ((mode & File::kTruncate) != 0) {
+    flags = flags | O_TRUNC;
+  }
+  // For IORING_OP_OPENAT the file mode is passed as the length.
+  return Submit(operation,
+                IORING_OP_OPENAT,
+                AT_FDCWD,
+                reinterpret_cast<uint64_t>(operation->path),
+                0666,
+                0,
+                flags);
+}
+
+
+static bool SubmitStat(FileIOOperation* operation, const char* name) {
+  operation->path = strdup(name);
+  // For IORING_OP_STATX the mask is passed as the length and the
+  // result buffer as the offset.
+  return Submit(operation,
+                IORING_OP_STATX,
+                AT_FDCWD,
+                reinterpret_cast<uint64_t>(operation->path),
+                STATX_SIZE | STATX_MTIME,
+                reinterpret_cast<uint64_t>(&operation->stat_buffer),
+                0);
+}
+
+
+bool FileIOEngine::SubmitLength(const char* name, Dart_Port reply_port) {
+  return SubmitStat(
+      new FileIOOperation(FileIOOperation::kLength, reply_port), name);
+}
+
+
+bool FileIOEngine::SubmitLastModified(const char* name, Dart_Port reply_port) {
+  return SubmitStat(
+      new FileIOOperation(FileIOOperation::kLastModified, reply_port), name);
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/file_io_engine.h"
+
+
+// There is no asynchronous file engine on this platform. All file
+// requests are handled synchronously by the file service.
+bool FileIOEngine::SubmitReadAt(File* file,
+                                int64_t length,
+                                int64_t position,
+                                Dart_Port reply_port) {
+  return false;
+}
+
+
+bool FileIOEngine::SubmitWriteAt(File* file,
+                                 const uint8_t* buffer,
+                                 int64_t length,
+                                 int64_t position,
+                                 Dart_Port reply_port) {
+  return false;
+}
+
+
+bool FileIOEngine::SubmitOpen(const char* name,
+                              File::FileOpenMode mode,
+                              Dart_Port reply_port) {
+  return false;
+}
+
+
+bool FileIOEngine::SubmitLength(const char* name, Dart_Port reply_port) {
+  return false;
+}
+
+
+bool FileIOEngine::SubmitLastModified(const char* name, Dart_Port reply_port) {
+  return false;
+}
@@ -6,12 +6,21 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <libgen.h>
 
 #include "bin/builtin.h"
 
+#if !defined(FICLONE)
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 class FileHandle {
  public:
   explicit FileHandle(int fd) : fd_(fd) { }
@@ -55,6 +64,11 @@ bool File::IsClosed() {
 }
 
 
+intptr_t File::GetFD() {
+  return handle_->fd();
+}
+
+
 int64_t File::Read(void* buffer, int64_t num_bytes) {
   ASSERT(handle_->fd() >= 0);
   return TEMP_FAILURE_RETRY(read(handle_->fd(), buffer, num_bytes));
@@ -67,6 +81,36 @@ int64_t File::Write(const void* buffer, int64_t num_bytes) {
 }
 
 
+int64_t File::ReadAt(void* buffer, int64_t num_bytes, int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  return TEMP_FAILURE_RETRY(pread(handle_->fd(), buffer, num_bytes, position));
+}
+
+
+int64_t File::WriteAt(const void* buffer,
+                      int64_t num_bytes,
+                      int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  return TEMP_FAILURE_RETRY(
+      pwrite(handle_->fd(), buffer, num_bytes, position));
+}
+
+
+int64_t File::WriteGather(const void* const* buffers,
+                          const int64_t* lengths,
+                          intptr_t count) {
+  ASSERT(handle_->fd() >= 0);
+  const intptr_t kMaxIOVecs = 64;
+  struct iovec iov[kMaxIOVecs];
+  int iov_count = (count < kMaxIOVecs) ? count : kMaxIOVecs;
+  for (int i = 0; i < iov_count; i++) {
+    iov[i].iov_base = const_cast<void*>(buffers[i]);
+    iov[i].iov_len = lengths[i];
+  }
+  return TEMP_FAILURE_RETRY(writev(handle_->fd(), iov, iov_count));
+}
+
+
 off_t File::Position() {
   ASSERT(handle_->fd() >= 0);
   return TEMP_FAILURE_RETRY(lseek(handle_->fd(), 0, SEEK_CUR));
@@ -91,6 +135,19 @@ bool File::Flush() {
 }
 
 
+bool File::FlushData() {
+  ASSERT(handle_->fd() >= 0);
+  return TEMP_FAILURE_RETRY(fdatasync(handle_->fd()) != -1);
+}
+
+
+void File::AdviseSequentialRead() {
+  ASSERT(handle_->fd() >= 0);
+  // The advice is only a hint so failing to apply it is not an error.
+  posix_fadvise(handle_->fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+
 off_t File::Length() {
   ASSERT(handle_->fd() >= 0);
   struct stat st;
@@ -137,6 +194,87 @@ File* File::OpenStdio(int fd) {
 }
 
 
+File* File::FromFD(intptr_t fd) {
+  return new File(NULL, new FileHandle(fd));
+}
+
+
+MappedMemory::~MappedMemory() {
+  if (munmap(start_, size_) != 0) {
+    FATAL1("Failed to unmap file: %s", strerror(errno));
+  }
+}
+
+
+MappedMemory* File::Map(const char* name,
+                        int64_t offset,
+                        int64_t length,
+                        MapMode mode,
+                        MapAdvice advice) {
+  if (offset < 0 || length < 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  int flags = (mode == kMapWrite) ? O_RDWR : O_RDONLY;
+  int fd = TEMP_FAILURE_RETRY(open(name, flags));
+  if (fd < 0) {
+    return NULL;
+  }
+  // Mapping pages past the end of the file succeeds but accessing
+  // them raises SIGBUS, so the region has to be within the file.
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(fstat(fd, &st)) != 0) {
+    int error = errno;
+    TEMP_FAILURE_RETRY(close(fd));
+    errno = error;
+    return NULL;
+  }
+  if (offset > st.st_size || length > st.st_size - offset) {
+    TEMP_FAILURE_RETRY(close(fd));
+    errno = EINVAL;
+    return NULL;
+  }
+  // The mapping has to start at a page boundary.
+  int64_t page_size = sysconf(_SC_PAGESIZE);
+  int64_t delta = offset % page_size;
+  // Read mappings are writable as the memory is exposed to Dart as a
+  // mutable byte array. They are private so changes never reach the
+  // file.
+  void* start = mmap(NULL,
+                     length + delta,
+                     PROT_READ | PROT_WRITE,
+                     (mode == kMapWrite) ? MAP_SHARED : MAP_PRIVATE,
+                     fd,
+                     offset - delta);
+  // The mapping stays valid after the file is closed.
+  int error = errno;
+  TEMP_FAILURE_RETRY(close(fd));
+  if (start == MAP_FAILED) {
+    errno = error;
+    return NULL;
+  }
+  int hint = MADV_NORMAL;
+  switch (advice) {
+    case kAdviceSequential:
+      hint = MADV_SEQUENTIAL;
+      break;
+    case kAdviceRandom:
+      hint = MADV_RANDOM;
+      break;
+    case kAdviceWillNeed:
+      hint = MADV_WILLNEED;
+      break;
+    default:
+      break;
+  }
+  if (hint != MADV_NORMAL) {
+    // The advice is only a hint so failing to apply it is not an error.
+    madvise(start, length + delta, hint);
+  }
+  return new MappedMemory(start, length + delta, delta);
+}
+
+
 bool File::Exists(const char* name) {
   struct stat st;
   if (TEMP_FAILURE_RETRY(stat(name, &st)) == 0) {
@@ -165,6 +303,120 @@ bool File::Delete(const char* name) {
 }
 
 
+// Copy the rest of in_fd to out_fd with a read/write loop. Used when
+// neither copy_file_range nor sendfile can copy between the files.
+static bool CopyWithReadWrite(int in_fd, int out_fd) {
+  const intptr_t kBufferSize = 64 * KB;
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(malloc(kBufferSize));
+  while (true) {
+    ssize_t bytes_read = TEMP_FAILURE_RETRY(read(in_fd, buffer, kBufferSize));
+    if (bytes_read <= 0) {
+      free(buffer);
+      return bytes_read == 0;
+    }
+    ssize_t written = 0;
+    while (written < bytes_read) {
+      ssize_t result = TEMP_FAILURE_RETRY(
+          write(out_fd, buffer + written, bytes_read - written));
+      if (result < 0) {
+        free(buffer);
+        return false;
+      }
+      written += result;
+    }
+  }
+}
+
+
+// Copy the rest of in_fd to out_fd in the kernel.
+static bool CopyInKernel(int in_fd, int out_fd) {
+  const size_t kChunkSize = 1 << 30;
+  bool use_copy_file_range = true;
+  while (true) {
+    ssize_t result = -1;
+#if defined(__NR_copy_file_range)
+    if (use_copy_file_range) {
+      result = TEMP_FAILURE_RETRY(syscall(__NR_copy_file_range,
+                                          in_fd, NULL, out_fd, NULL,
+                                          kChunkSize, 0));
+      if (result < 0 &&
+          (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+           errno == EOPNOTSUPP)) {
+        // Not supported between these files. Nothing has been copied
+        // by the failing call so continue with sendfile.
+        use_copy_file_range = false;
+        continue;
+      }
+    } else
+#endif
+    {
+      result = TEMP_FAILURE_RETRY(sendfile(out_fd, in_fd, NULL, kChunkSize));
+      if (result < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        return CopyWithReadWrite(in_fd, out_fd);
+      }
+    }
+    if (result < 0) return false;
+    if (result == 0) return true;
+  }
+}
+
+
+bool File::Copy(const char* old_path, const char* new_path) {
+  int in_fd = TEMP_FAILURE_RETRY(open(old_path, O_RDONLY));
+  if (in_fd < 0) return false;
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(fstat(in_fd, &st)) != 0) {
+    int error = errno;
+    TEMP_FAILURE_RETRY(close(in_fd));
+    errno = error;
+    return false;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    TEMP_FAILURE_RETRY(close(in_fd));
+    errno = S_ISDIR(st.st_mode) ? EISDIR : ENOENT;
+    return false;
+  }
+  // The destination is only truncated once it is known not to be the
+  // source itself, e.g. through a hard link, as that would lose the
+  // data.
+  int out_fd = TEMP_FAILURE_RETRY(
+      open(new_path, O_WRONLY | O_CREAT, st.st_mode & 0777));
+  if (out_fd < 0) {
+    int error = errno;
+    TEMP_FAILURE_RETRY(close(in_fd));
+    errno = error;
+    return false;
+  }
+  struct stat out_st;
+  int error = 0;
+  if (TEMP_FAILURE_RETRY(fstat(out_fd, &out_st)) != 0) {
+    error = errno;
+  } else if (out_st.st_dev == st.st_dev && out_st.st_ino == st.st_ino) {
+    error = EINVAL;
+  } else if (TEMP_FAILURE_RETRY(ftruncate(out_fd, 0)) != 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    TEMP_FAILURE_RETRY(close(in_fd));
+    TEMP_FAILURE_RETRY(close(out_fd));
+    errno = error;
+    return false;
+  }
+  // Share the data blocks with the original file if the file system
+  // supports it (e.g. btrfs and XFS). Otherwise copy in the kernel.
+  bool result = (ioctl(out_fd, FICLONE, in_fd) == 0) ||
+                CopyInKernel(in_fd, out_fd);
+  error = errno;
+  TEMP_FAILURE_RETRY(close(in_fd));
+  if (TEMP_FAILURE_RETRY(close(out_fd)) != 0 && result) {
+    error = errno;
+    result = false;
+  }
+  errno = error;
+  return result;
+}
+
+
 off_t File::LengthFromName(const char* name) {
   struct stat st;
   if (TEMP_FAILURE_RETRY(stat(name, &st)) == 0) {
@@ -183,6 +435,26 @@ time_t File::LastModified(const char* name) {
 }
 
 
+bool File::Stat(const char* name, int64_t* data) {
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(stat(name, &st)) != 0) {
+    return false;
+  }
+  if (S_ISREG(st.st_mode)) {
+    data[kStatType] = kIsFile;
+  } else if (S_ISDIR(st.st_mode)) {
+    data[kStatType] = kIsDirectory;
+  } else {
+    data[kStatType] = kIsOther;
+  }
+  data[kStatSize] = st.st_size;
+  data[kStatModified] = st.st_mtime;
+  data[kStatMode] = st.st_mode & 07777;
+  data[kStatInode] = st.st_ino;
+  return true;
+}
+
+
 bool File::IsAbsolutePath(const char* pathname) {
   return (pathname != NULL && pathname[0] == '/');
 }
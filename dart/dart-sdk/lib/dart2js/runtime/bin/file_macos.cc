@@ -4,9 +4,12 @@
 
 #include "bin/file.h"
 
+#include <copyfile.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <limits.h>
@@ -56,6 +59,11 @@ bool File::IsClosed() {
 }
 
 
+intptr_t File::GetFD() {
+  return handle_->fd();
+}
+
+
 int64_t File::Read(void* buffer, int64_t num_bytes) {
   ASSERT(handle_->fd() >= 0);
   return TEMP_FAILURE_RETRY(read(handle_->fd(), buffer, num_bytes));
@@ -68,6 +76,36 @@ int64_t File::Write(const void* buffer, int64_t num_bytes) {
 }
 
 
+int64_t File::ReadAt(void* buffer, int64_t num_bytes, int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  return TEMP_FAILURE_RETRY(pread(handle_->fd(), buffer, num_bytes, position));
+}
+
+
+int64_t File::WriteAt(const void* buffer,
+                      int64_t num_bytes,
+                      int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  return TEMP_FAILURE_RETRY(
+      pwrite(handle_->fd(), buffer, num_bytes, position));
+}
+
+
+int64_t File::WriteGather(const void* const* buffers,
+                          const int64_t* lengths,
+                          intptr_t count) {
+  ASSERT(handle_->fd() >= 0);
+  const intptr_t kMaxIOVecs = 64;
+  struct iovec iov[kMaxIOVecs];
+  int iov_count = (count < kMaxIOVecs) ? count : kMaxIOVecs;
+  for (int i = 0; i < iov_count; i++) {
+    iov[i].iov_base = const_cast<void*>(buffers[i]);
+    iov[i].iov_len = lengths[i];
+  }
+  return TEMP_FAILURE_RETRY(writev(handle_->fd(), iov, iov_count));
+}
+
+
 off_t File::Position() {
   ASSERT(handle_->fd() >= 0);
   return TEMP_FAILURE_RETRY(lseek(handle_->fd(), 0, SEEK_CUR));
@@ -92,6 +130,24 @@ bool File::Flush() {
 }
 
 
+bool File::FlushData() {
+  ASSERT(handle_->fd() >= 0);
+  // fsync on Mac OS only hands the data to the drive. F_FULLFSYNC also
+  // flushes the drive cache but is not supported by all file systems.
+  if (TEMP_FAILURE_RETRY(fcntl(handle_->fd(), F_FULLFSYNC)) != -1) {
+    return true;
+  }
+  return TEMP_FAILURE_RETRY(fsync(handle_->fd()) != -1);
+}
+
+
+void File::AdviseSequentialRead() {
+  ASSERT(handle_->fd() >= 0);
+  // The advice is only a hint so failing to apply it is not an error.
+  fcntl(handle_->fd(), F_RDAHEAD, 1);
+}
+
+
 off_t File::Length() {
   ASSERT(handle_->fd() >= 0);
   struct stat st;
@@ -138,6 +194,87 @@ File* File::OpenStdio(int fd) {
 }
 
 
+File* File::FromFD(intptr_t fd) {
+  return new File(NULL, new FileHandle(fd));
+}
+
+
+MappedMemory::~MappedMemory() {
+  if (munmap(start_, size_) != 0) {
+    FATAL1("Failed to unmap file: %s", strerror(errno));
+  }
+}
+
+
+MappedMemory* File::Map(const char* name,
+                        int64_t offset,
+                        int64_t length,
+                        MapMode mode,
+                        MapAdvice advice) {
+  if (offset < 0 || length < 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  int flags = (mode == kMapWrite) ? O_RDWR : O_RDONLY;
+  int fd = TEMP_FAILURE_RETRY(open(name, flags));
+  if (fd < 0) {
+    return NULL;
+  }
+  // Mapping pages past the end of the file succeeds but accessing
+  // them raises SIGBUS, so the region has to be within the file.
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(fstat(fd, &st)) != 0) {
+    int error = errno;
+    TEMP_FAILURE_RETRY(close(fd));
+    errno = error;
+    return NULL;
+  }
+  if (offset > st.st_size || length > st.st_size - offset) {
+    TEMP_FAILURE_RETRY(close(fd));
+    errno = EINVAL;
+    return NULL;
+  }
+  // The mapping has to start at a page boundary.
+  int64_t page_size = sysconf(_SC_PAGESIZE);
+  int64_t delta = offset % page_size;
+  // Read mappings are writable as the memory is exposed to Dart as a
+  // mutable byte array. They are private so changes never reach the
+  // file.
+  void* start = mmap(NULL,
+                     length + delta,
+                     PROT_READ | PROT_WRITE,
+                     (mode == kMapWrite) ? MAP_SHARED : MAP_PRIVATE,
+                     fd,
+                     offset - delta);
+  // The mapping stays valid after the file is closed.
+  int error = errno;
+  TEMP_FAILURE_RETRY(close(fd));
+  if (start == MAP_FAILED) {
+    errno = error;
+    return NULL;
+  }
+  int hint = MADV_NORMAL;
+  switch (advice) {
+    case kAdviceSequential:
+      hint = MADV_SEQUENTIAL;
+      break;
+    case kAdviceRandom:
+      hint = MADV_RANDOM;
+      break;
+    case kAdviceWillNeed:
+      hint = MADV_WILLNEED;
+      break;
+    default:
+      break;
+  }
+  if (hint != MADV_NORMAL) {
+    // The advice is only a hint so failing to apply it is not an error.
+    madvise(start, length + delta, hint);
+  }
+  return new MappedMemory(start, length + delta, delta);
+}
+
+
 bool File::Exists(const char* name) {
   struct stat st;
   if (TEMP_FAILURE_RETRY(stat(name, &st)) == 0) {
@@ -166,6 +303,29 @@ bool File::Delete(const char* name) {
 }
 
 
+bool File::Copy(const char* old_path, const char* new_path) {
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(stat(old_path, &st)) != 0) return false;
+  if (!S_ISREG(st.st_mode)) {
+    errno = S_ISDIR(st.st_mode) ? EISDIR : ENOENT;
+    return false;
+  }
+  // Copying a file onto itself, e.g. through a hard link, would
+  // truncate it and lose the data.
+  struct stat new_st;
+  if (TEMP_FAILURE_RETRY(stat(new_path, &new_st)) == 0 &&
+      new_st.st_dev == st.st_dev &&
+      new_st.st_ino == st.st_ino) {
+    errno = EINVAL;
+    return false;
+  }
+  // copyfile clones the file on file systems supporting it and
+  // otherwise copies the data in the kernel.
+  return copyfile(old_path, new_path, NULL, COPYFILE_DATA | COPYFILE_MODE)
+      == 0;
+}
+
+
 off_t File::LengthFromName(const char* name) {
   struct stat st;
   if (TEMP_FAILURE_RETRY(stat(name, &st)) == 0) {
@@ -184,6 +344,26 @@ time_t File::LastModified(const char* name) {
 }
 
 
+bool File::Stat(const char* name, int64_t* data) {
+  struct stat st;
+  if (TEMP_FAILURE_RETRY(stat(name, &st)) != 0) {
+    return false;
+  }
+  if (S_ISREG(st.st_mode)) {
+    data[kStatType] = kIsFile;
+  } else if (S_ISDIR(st.st_mode)) {
+    data[kStatType] = kIsDirectory;
+  } else {
+    data[kStatType] = kIsOther;
+  }
+  data[kStatSize] = st.st_size;
+  data[kStatModified] = st.st_mtime;
+  data[kStatMode] = st.st_mode & 07777;
+  data[kStatInode] = st.st_ino;
+  return true;
+}
+
+
 bool File::IsAbsolutePath(const char* pathname) {
   return (pathname != NULL && pathname[0] == '/');
 }
@@ -0,0 +1,48 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/file_system_watcher.h"
+
+#include "bin/builtin.h"
+#include "bin/dartutils.h"
+
+#include "include/dart_api.h"
+
+
+void FUNCTION_NAME(FileSystemWatcher_Watch)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  const char* path =
+      DartUtils::GetStringValue(Dart_GetNativeArgument(args, 0));
+  Dart_Port port =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 1),
+                                 DartUtils::kIdFieldName);
+  intptr_t id = FileSystemWatcher::Watch(path, port);
+  if (id >= 0) {
+    Dart_SetReturnValue(args, Dart_NewInteger(id));
+  } else {
+    Dart_Handle err = DartUtils::NewDartOSError();
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(FileSystemWatcher_Unwatch)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t id = DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  Dart_Port port =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 1),
+                                 DartUtils::kIdFieldName);
+  FileSystemWatcher::Unwatch(id, port);
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(FileSystemWatcher_GetInstance)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t instance = FileSystemWatcher::GetInstance();
+  Dart_SetReturnValue(args, Dart_NewInteger(instance));
+  Dart_ExitScope();
+}
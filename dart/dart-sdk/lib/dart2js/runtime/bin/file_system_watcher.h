@@ -0,0 +1,57 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef BIN_FILE_SYSTEM_WATCHER_H_
+#define BIN_FILE_SYSTEM_WATCHER_H_
+
+#include "bin/builtin.h"
+#include "bin/dartutils.h"
+#include "platform/globals.h"
+
+// Watches files and directories for changes. All watches share one
+// inotify instance, which the Dart code registers with the event
+// handler. When the instance becomes readable the event handler calls
+// DispatchEvents, which posts the changes of each watch to the ports
+// watching it.
+class FileSystemWatcher {
+ public:
+  // These values have to be kept in sync with FileSystemEvent in
+  // file.dart.
+  enum EventType {
+    kCreate = 1 << 0,
+    kModify = 1 << 1,
+    kDelete = 1 << 2,
+    kMove = 1 << 3,
+    kAttributes = 1 << 4,
+    kOverflow = 1 << 5
+  };
+
+  // Starts watching the file or directory with the given path and
+  // posting its changes to port. Returns the id of the watch or -1 if
+  // the path cannot be watched. Watches of the same file share an id.
+  static intptr_t Watch(const char* path, Dart_Port port);
+
+  // Stops posting the changes of the watch with the given id to port.
+  static void Unwatch(intptr_t id, Dart_Port port);
+
+  // Returns the file descriptor of the shared instance. Only valid
+  // after a path has been watched.
+  static intptr_t GetInstance();
+
+  // Reads the changes pending for the shared instance. The changes of
+  // each watch are posted to its ports as a list of pairs of event
+  // type and name. The name is relative to the watched directory or
+  // null for changes to the watched path itself. Consecutive changes
+  // to the same name are merged into one pair with the event types
+  // combined. When the watched path is deleted or moved the watch ends
+  // and null is posted after its last changes.
+  static void DispatchEvents(intptr_t instance);
+
+ private:
+  DISALLOW_ALLOCATION();
+  DISALLOW_IMPLICIT_CONSTRUCTORS(FileSystemWatcher);
+};
+
+
+#endif  // BIN_FILE_SYSTEM_WATCHER_H_
@@ -0,0 +1,317 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/file_system_watcher.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "bin/dartutils.h"
+#include "bin/hashmap.h"
+#include "bin/thread.h"
+
+
+static const uint32_t kWatchMask =
+    IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB |
+    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+
+// A port watching a watch descriptor. Watches of the same file get the
+// same watch descriptor from inotify, so each watch descriptor has a
+// list of ports.
+class WatchPort {
+ public:
+  WatchPort(Dart_Port port, WatchPort* next) : port(port), next(next) { }
+
+  Dart_Port port;
+  WatchPort* next;
+};
+
+
+// The watches of the process. Linux limits the number of inotify
+// instances per user, 128 by default, so all watches are added to one
+// instance and its changes are routed to the watching ports by watch
+// descriptor.
+class Watches {
+ public:
+  static intptr_t Add(const char* path, Dart_Port port);
+  static void Remove(intptr_t wd, Dart_Port port);
+  static intptr_t instance();
+  static void Dispatch(intptr_t instance);
+
+ private:
+  static WatchPort* Lookup(intptr_t wd);
+  static void End(intptr_t wd);
+  static void PostChanges(intptr_t wd,
+                          intptr_t* types,
+                          const char** names,
+                          intptr_t count);
+  static void PostOverflow();
+  static void* GetHashmapKeyFromWd(intptr_t wd) {
+    // The hashmap does not support keys with value 0.
+    return reinterpret_cast<void*>(wd + 1);
+  }
+  static uint32_t GetHashmapHashFromWd(intptr_t wd) {
+    return static_cast<uint32_t>(wd + 1);
+  }
+
+  // The shared inotify instance or -1 until the first watch.
+  static int instance_;
+  // Maps watch descriptors to their lists of ports.
+  static HashMap* ports_;
+  // Protects the map and serializes reading the instance, which can be
+  // registered with the event handlers of several isolates.
+  static dart::Mutex mutex_;
+};
+
+
+int Watches::instance_ = -1;
+HashMap* Watches::ports_ = NULL;
+dart::Mutex Watches::mutex_;
+
+
+intptr_t Watches::Add(const char* path, Dart_Port port) {
+  MutexLocker locker(&mutex_);
+  if (instance_ == -1) {
+    instance_ = TEMP_FAILURE_RETRY(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (instance_ == -1) return -1;
+    ports_ = new HashMap(&HashMap::SamePointerValue, 16);
+  }
+  intptr_t wd =
+      TEMP_FAILURE_RETRY(inotify_add_watch(instance_, path, kWatchMask));
+  if (wd < 0) return -1;
+  HashMap::Entry* entry = ports_->Lookup(
+      GetHashmapKeyFromWd(wd), GetHashmapHashFromWd(wd), true);
+  entry->value =
+      new WatchPort(port, reinterpret_cast<WatchPort*>(entry->value));
+  return wd;
+}
+
+
+void Watches::Remove(intptr_t wd, Dart_Port port) {
+  MutexLocker locker(&mutex_);
+  // The watch is gone already if it ended.
+  if (ports_ == NULL) return;
+  HashMap::Entry* entry = ports_->Lookup(
+      GetHashmapKeyFromWd(wd), GetHashmapHashFromWd(wd), false);
+  if (entry == NULL) return;
+  WatchPort** link = reinterpret_cast<WatchPort**>(&entry->value);
+  while (*link != NULL && (*link)->port != port) {
+    link = &(*link)->next;
+  }
+  if (*link == NULL) return;
+  WatchPort* removed = *link;
+  *link = removed->next;
+  delete removed;
+  if (entry->value == NULL) {
+    ports_->Remove(GetHashmapKeyFromWd(wd), GetHashmapHashFromWd(wd));
+    TEMP_FAILURE_RETRY(inotify_rm_watch(instance_, wd));
+  }
+}
+
+
+intptr_t Watches::instance() {
+  MutexLocker locker(&mutex_);
+  return instance_;
+}
+
+
+WatchPort* Watches::Lookup(intptr_t wd) {
+  HashMap::Entry* entry = ports_->Lookup(
+      GetHashmapKeyFromWd(wd), GetHashmapHashFromWd(wd), false);
+  return (entry == NULL) ? NULL : reinterpret_cast<WatchPort*>(entry->value);
+}
+
+
+// Posts null to the ports of the watch and forgets it.
+void Watches::End(intptr_t wd) {
+  WatchPort* current = Lookup(wd);
+  if (current == NULL) return;
+  ports_->Remove(GetHashmapKeyFromWd(wd), GetHashmapHashFromWd(wd));
+  while (current != NULL) {
+    WatchPort* next = current->next;
+    DartUtils::PostNull(current->port);
+    delete current;
+    current = next;
+  }
+}
+
+
+void Watches::PostChanges(intptr_t wd,
+                          intptr_t* types,
+                          const char** names,
+                          intptr_t count) {
+  WatchPort* current = Lookup(wd);
+  if (current == NULL) return;
+  Dart_CObject* objects = new Dart_CObject[2 * count];
+  Dart_CObject** values = new Dart_CObject*[2 * count];
+  for (intptr_t i = 0; i < count; i++) {
+    objects[2 * i].type = Dart_CObject::kInt32;
+    objects[2 * i].value.as_int32 = types[i];
+    if (names[i] == NULL) {
+      objects[2 * i + 1].type = Dart_CObject::kNull;
+    } else {
+      objects[2 * i + 1].type = Dart_CObject::kString;
+      objects[2 * i + 1].value.as_string = const_cast<char*>(names[i]);
+    }
+    values[2 * i] = &objects[2 * i];
+    values[2 * i + 1] = &objects[2 * i + 1];
+  }
+  Dart_CObject message;
+  message.type = Dart_CObject::kArray;
+  message.value.as_array.length = 2 * count;
+  message.value.as_array.values = values;
+  while (current != NULL) {
+    Dart_PostCObject(current->port, &message);
+    current = current->next;
+  }
+  delete[] values;
+  delete[] objects;
+}
+
+
+// Changes have been lost, so tell every watch.
+void Watches::PostOverflow() {
+  intptr_t type = FileSystemWatcher::kOverflow;
+  const char* name = NULL;
+  for (HashMap::Entry* entry = ports_->Start();
+       entry != NULL;
+       entry = ports_->Next(entry)) {
+    intptr_t wd = reinterpret_cast<intptr_t>(entry->key) - 1;
+    PostChanges(wd, &type, &name, 1);
+  }
+}
+
+
+static intptr_t EventType(uint32_t mask) {
+  intptr_t type = 0;
+  if ((mask & IN_CREATE) != 0) type |= FileSystemWatcher::kCreate;
+  if ((mask & IN_MODIFY) != 0) type |= FileSystemWatcher::kModify;
+  if ((mask & (IN_DELETE | IN_DELETE_SELF)) != 0) {
+    type |= FileSystemWatcher::kDelete;
+  }
+  if ((mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)) != 0) {
+    type |= FileSystemWatcher::kMove;
+  }
+  if ((mask & IN_ATTRIB) != 0) type |= FileSystemWatcher::kAttributes;
+  return type;
+}
+
+
+static bool SameName(const char* a, const char* b) {
+  if (a == NULL || b == NULL) return a == b;
+  return strcmp(a, b) == 0;
+}
+
+
+// A decoded inotify event. Consecutive events for the same name of the
+// same watch are merged into one change.
+struct Change {
+  intptr_t wd;
+  intptr_t type;
+  const char* name;
+  // The watch ends after this change.
+  bool ends_watch;
+};
+
+
+void Watches::Dispatch(intptr_t instance) {
+  const intptr_t kBufferSize = 16 * KB;
+  char buffer[kBufferSize]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  MutexLocker locker(&mutex_);
+  // Another event handler may have read the changes already. Changes
+  // left in the instance are read when it is reported readable again.
+  ssize_t bytes = TEMP_FAILURE_RETRY(read(instance, buffer, kBufferSize));
+  if (bytes < 0) {
+    if (errno != EAGAIN) perror("Failed reading file system changes");
+    return;
+  }
+  intptr_t max_changes = bytes / sizeof(struct inotify_event);
+  Change* changes = new Change[max_changes];
+  intptr_t count = 0;
+  bool overflow = false;
+  intptr_t offset = 0;
+  while (offset < bytes) {
+    const struct inotify_event* event =
+        reinterpret_cast<const struct inotify_event*>(buffer + offset);
+    offset += sizeof(struct inotify_event) + event->len;
+    if ((event->mask & IN_Q_OVERFLOW) != 0) {
+      overflow = true;
+      continue;
+    }
+    intptr_t wd = event->wd;
+    const char* name = (event->len > 0) ? event->name : NULL;
+    intptr_t type = EventType(event->mask);
+    // The watch is removed when the watched path is deleted, which is
+    // reported as IN_IGNORED. A moved path is still watched under its
+    // new name, which the Dart code does not know, so the watch is
+    // ended as well.
+    bool ends_watch = (event->mask & (IN_IGNORED | IN_MOVE_SELF)) != 0;
+    if ((event->mask & IN_MOVE_SELF) != 0) {
+      TEMP_FAILURE_RETRY(inotify_rm_watch(instance, wd));
+    }
+    if (count > 0 &&
+        !changes[count - 1].ends_watch &&
+        changes[count - 1].wd == wd &&
+        SameName(changes[count - 1].name, name)) {
+      changes[count - 1].type |= type;
+      changes[count - 1].ends_watch = ends_watch;
+      continue;
+    }
+    changes[count].wd = wd;
+    changes[count].type = type;
+    changes[count].name = name;
+    changes[count].ends_watch = ends_watch;
+    count++;
+  }
+  // Post the changes of each watch in one list.
+  intptr_t* types = new intptr_t[count];
+  const char** names = new const char*[count];
+  for (intptr_t i = 0; i < count; i++) {
+    if (changes[i].wd == -1) continue;
+    intptr_t wd = changes[i].wd;
+    intptr_t watch_count = 0;
+    bool ends_watch = false;
+    for (intptr_t j = i; j < count; j++) {
+      if (changes[j].wd != wd) continue;
+      if (changes[j].type != 0) {
+        types[watch_count] = changes[j].type;
+        names[watch_count] = changes[j].name;
+        watch_count++;
+      }
+      ends_watch = ends_watch || changes[j].ends_watch;
+      changes[j].wd = -1;
+    }
+    if (watch_count > 0) PostChanges(wd, types, names, watch_count);
+    if (ends_watch) End(wd);
+  }
+  if (overflow) PostOverflow();
+  delete[] names;
+  delete[] types;
+  delete[] changes;
+}
+
+
+intptr_t FileSystemWatcher::Watch(const char* path, Dart_Port port) {
+  return Watches::Add(path, port);
+}
+
+
+void FileSystemWatcher::Unwatch(intptr_t id, Dart_Port port) {
+  Watches::Remove(id, port);
+}
+
+
+intptr_t FileSystemWatcher::GetInstance() {
+  return Watches::instance();
+}
+
+
+void FileSystemWatcher::DispatchEvents(intptr_t instance) {
+  Watches::Dispatch(instance);
+}
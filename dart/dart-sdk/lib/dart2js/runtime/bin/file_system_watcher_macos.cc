@@ -0,0 +1,32 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/file_system_watcher.h"
+
+#include <errno.h>
+
+#include "bin/dartutils.h"
+
+
+intptr_t FileSystemWatcher::Watch(const char* path, Dart_Port port) {
+  // Watching is only supported with inotify on Linux.
+  errno = ENOTSUP;
+  return -1;
+}
+
+
+void FileSystemWatcher::Unwatch(intptr_t id, Dart_Port port) {
+  UNREACHABLE();
+}
+
+
+intptr_t FileSystemWatcher::GetInstance() {
+  UNREACHABLE();
+  return -1;
+}
+
+
+void FileSystemWatcher::DispatchEvents(intptr_t instance) {
+  UNREACHABLE();
+}
@@ -52,6 +52,11 @@ bool File::IsClosed() {
 }
 
 
+intptr_t File::GetFD() {
+  return handle_->fd();
+}
+
+
 int64_t File::Read(void* buffer, int64_t num_bytes) {
   ASSERT(handle_->fd() >= 0);
   return read(handle_->fd(), buffer, num_bytes);
@@ -64,6 +69,69 @@ int64_t File::Write(const void* buffer, int64_t num_bytes) {
 }
 
 
+// Unlike pread and pwrite on POSIX, positional reads and writes on a
+// synchronous handle also move the file pointer on Windows.
+int64_t File::ReadAt(void* buffer, int64_t num_bytes, int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(handle_->fd()));
+  OVERLAPPED overlapped;
+  ZeroMemory(&overlapped, sizeof(overlapped));
+  overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFF);
+  overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+  DWORD bytes_read = 0;
+  if (!ReadFile(handle,
+                buffer,
+                static_cast<DWORD>(num_bytes),
+                &bytes_read,
+                &overlapped)) {
+    // Reading at or past the end of the file is not an error.
+    if (GetLastError() == ERROR_HANDLE_EOF) return 0;
+    return -1;
+  }
+  return bytes_read;
+}
+
+
+int64_t File::WriteAt(const void* buffer,
+                      int64_t num_bytes,
+                      int64_t position) {
+  ASSERT(handle_->fd() >= 0);
+  HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(handle_->fd()));
+  OVERLAPPED overlapped;
+  ZeroMemory(&overlapped, sizeof(overlapped));
+  overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFF);
+  overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+  DWORD bytes_written = 0;
+  if (!WriteFile(handle,
+                 buffer,
+                 static_cast<DWORD>(num_bytes),
+                 &bytes_written,
+                 &overlapped)) {
+    return -1;
+  }
+  return bytes_written;
+}
+
+
+// There is no gather write for synchronous handles on Windows so the
+// buffers are written one by one.
+int64_t File::WriteGather(const void* const* buffers,
+                          const int64_t* lengths,
+                          intptr_t count) {
+  ASSERT(handle_->fd() >= 0);
+  int64_t total = 0;
+  for (intptr_t i = 0; i < count; i++) {
+    int64_t written = Write(buffers[i], lengths[i]);
+    if (written < 0) {
+      return (total > 0) ? total : -1;
+    }
+    total += written;
+    if (written < lengths[i]) break;
+  }
+  return total;
+}
+
+
 off_t File::Position() {
   ASSERT(handle_->fd() >= 0);
   return lseek(handle_->fd(), 0, SEEK_CUR);
@@ -88,6 +156,18 @@ bool File::Flush() {
 }
 
 
+bool File::FlushData() {
+  // Windows has no cheaper way to only flush the data.
+  return Flush();
+}
+
+
+void File::AdviseSequentialRead() {
+  // Sequential access can only be requested when opening a file on
+  // Windows.
+}
+
+
 off_t File::Length() {
   ASSERT(handle_->fd() >= 0);
   struct stat st;
@@ -126,6 +206,27 @@ File* File::OpenStdio(int fd) {
 }
 
 
+File* File::FromFD(intptr_t fd) {
+  return new File(NULL, new FileHandle(fd));
+}
+
+
+MappedMemory::~MappedMemory() {
+  UNREACHABLE();
+}
+
+
+MappedMemory* File::Map(const char* name,
+                        int64_t offset,
+                        int64_t length,
+                        MapMode mode,
+                        MapAdvice advice) {
+  // Memory mapped files are not supported on Windows.
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return NULL;
+}
+
+
 bool File::Exists(const char* name) {
   struct stat st;
   if (stat(name, &st) == 0) {
@@ -154,6 +255,14 @@ bool File::Delete(const char* name) {
 }
 
 
+bool File::Copy(const char* old_path, const char* new_path) {
+  if (CopyFileA(old_path, new_path, FALSE) == 0) {
+    return false;
+  }
+  return true;
+}
+
+
 off_t File::LengthFromName(const char* name) {
   struct stat st;
   if (stat(name, &st) == 0) {
@@ -172,6 +281,28 @@ time_t File::LastModified(const char* name) {
 }
 
 
+bool File::Stat(const char* name, int64_t* data) {
+  struct _stat64 st;
+  if (_stat64(name, &st) != 0) {
+    return false;
+  }
+  if ((st.st_mode & _S_IFMT) == _S_IFREG) {
+    data[kStatType] = kIsFile;
+  } else if ((st.st_mode & _S_IFMT) == _S_IFDIR) {
+    data[kStatType] = kIsDirectory;
+  } else {
+    data[kStatType] = kIsOther;
+  }
+  data[kStatSize] = st.st_size;
+  data[kStatModified] = st.st_mtime;
+  data[kStatMode] = st.st_mode & 0777;
+  // The C runtime does not report file indices on Windows so st_ino is
+  // always 0.
+  data[kStatInode] = st.st_ino;
+  return true;
+}
+
+
 bool File::IsAbsolutePath(const char* pathname) {
   // Should we consider network paths?
   if (pathname == NULL) return false;
@@ -0,0 +1,278 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/io_buffer_pool.h"
+
+#include <stdlib.h>
+#if defined(TARGET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "bin/thread.h"
+#include "platform/assert.h"
+#include "platform/utils.h"
+
+
+// Every buffer is preceded by a header recording its size class so
+// it can be returned to the right free list by any thread.
+class IOBufferHeader {
+ public:
+  intptr_t size_log2;
+  IOBufferHeader* next;  // Only used while the buffer is cached.
+};
+
+
+static const intptr_t kNumSizeClasses =
+    IOBufferPool::kMaxBufferSizeLog2 - IOBufferPool::kMinBufferSizeLog2 + 1;
+// Size class used for buffers which are too large to be cached.
+static const intptr_t kUncachedSizeLog2 = -1;
+
+
+// Per-thread cache of released buffers. The counters are only written
+// by the owning thread and are read unsynchronized when collecting
+// statistics.
+class IOBufferCache {
+ public:
+  IOBufferCache() : hits_(0), misses_(0), bytes_resident_(0), next_(NULL) {
+    for (intptr_t i = 0; i < kNumSizeClasses; i++) {
+      free_lists_[i] = NULL;
+      free_counts_[i] = 0;
+    }
+  }
+
+  IOBufferHeader* Allocate(intptr_t size_log2) {
+    intptr_t index = size_log2 - IOBufferPool::kMinBufferSizeLog2;
+    IOBufferHeader* header = free_lists_[index];
+    if (header != NULL) {
+      free_lists_[index] = header->next;
+      free_counts_[index]--;
+      bytes_resident_ -= static_cast<intptr_t>(1) << size_log2;
+      hits_++;
+      return header;
+    }
+    misses_++;
+    intptr_t size = static_cast<intptr_t>(1) << size_log2;
+    header = reinterpret_cast<IOBufferHeader*>(
+        malloc(sizeof(IOBufferHeader) + size));
+    if (header == NULL) {
+      FATAL("Out of memory allocating I/O buffer");
+    }
+    header->size_log2 = size_log2;
+    return header;
+  }
+
+  void Free(IOBufferHeader* header) {
+    intptr_t index = header->size_log2 - IOBufferPool::kMinBufferSizeLog2;
+    if (free_counts_[index] >= IOBufferPool::kMaxCachedBuffers) {
+      free(header);
+      return;
+    }
+    header->next = free_lists_[index];
+    free_lists_[index] = header;
+    free_counts_[index]++;
+    bytes_resident_ += static_cast<intptr_t>(1) << header->size_log2;
+  }
+
+  void CountUncachedAllocation() { misses_++; }
+
+  // Frees all cached buffers.
+  void Clear() {
+    for (intptr_t i = 0; i < kNumSizeClasses; i++) {
+      while (free_lists_[i] != NULL) {
+        IOBufferHeader* header = free_lists_[i];
+        free_lists_[i] = header->next;
+        free(header);
+      }
+      free_counts_[i] = 0;
+    }
+    bytes_resident_ = 0;
+  }
+
+  int64_t hits() { return hits_; }
+  int64_t misses() { return misses_; }
+  int64_t bytes_resident() { return bytes_resident_; }
+  IOBufferCache* next() { return next_; }
+  void set_next(IOBufferCache* cache) { next_ = cache; }
+
+ private:
+  IOBufferHeader* free_lists_[kNumSizeClasses];
+  intptr_t free_counts_[kNumSizeClasses];
+  int64_t hits_;
+  int64_t misses_;
+  int64_t bytes_resident_;
+  IOBufferCache* next_;
+};
+
+
+dart::Mutex IOBufferPool::mutex_;
+IOBufferCache* IOBufferPool::caches_ = NULL;
+int64_t IOBufferPool::released_hits_ = 0;
+int64_t IOBufferPool::released_misses_ = 0;
+
+
+// The thread local key for the caches is created once with a
+// destructor which releases the cache of an exiting thread.
+#if defined(TARGET_OS_WINDOWS)
+static INIT_ONCE cache_key_once = INIT_ONCE_STATIC_INIT;
+static DWORD cache_key = FLS_OUT_OF_INDEXES;
+
+
+static void WINAPI ReleaseThreadCache(void* cache) {
+  if (cache != NULL) {
+    IOBufferPool::ReleaseCache(reinterpret_cast<IOBufferCache*>(cache));
+  }
+}
+
+
+static BOOL CALLBACK CreateCacheKey(INIT_ONCE* once,
+                                    void* parameter,
+                                    void** context) {
+  cache_key = FlsAlloc(ReleaseThreadCache);
+  return cache_key != FLS_OUT_OF_INDEXES;
+}
+
+
+static IOBufferCache* GetThreadCache() {
+  if (!InitOnceExecuteOnce(&cache_key_once, CreateCacheKey, NULL, NULL)) {
+    FATAL("Failed to create I/O buffer cache key");
+  }
+  return reinterpret_cast<IOBufferCache*>(FlsGetValue(cache_key));
+}
+
+
+static void SetThreadCache(IOBufferCache* cache) {
+  FlsSetValue(cache_key, cache);
+}
+#else
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+
+static void ReleaseThreadCache(void* cache) {
+  IOBufferPool::ReleaseCache(reinterpret_cast<IOBufferCache*>(cache));
+}
+
+
+static void CreateCacheKey() {
+  if (pthread_key_create(&cache_key, ReleaseThreadCache) != 0) {
+    FATAL("Failed to create I/O buffer cache key");
+  }
+}
+
+
+static IOBufferCache* GetThreadCache() {
+  pthread_once(&cache_key_once, CreateCacheKey);
+  return reinterpret_cast<IOBufferCache*>(pthread_getspecific(cache_key));
+}
+
+
+static void SetThreadCache(IOBufferCache* cache) {
+  pthread_setspecific(cache_key, cache);
+}
+#endif  // defined(TARGET_OS_WINDOWS)
+
+
+static intptr_t SizeLog2(intptr_t size) {
+  intptr_t size_log2 = IOBufferPool::kMinBufferSizeLog2;
+  while ((static_cast<intptr_t>(1) << size_log2) < size) {
+    size_log2++;
+  }
+  return size_log2;
+}
+
+
+IOBufferCache* IOBufferPool::CurrentCache() {
+  IOBufferCache* cache = GetThreadCache();
+  if (cache == NULL) {
+    cache = new IOBufferCache();
+    SetThreadCache(cache);
+    MutexLocker locker(&mutex_);
+    cache->set_next(caches_);
+    caches_ = cache;
+  }
+  return cache;
+}
+
+
+void IOBufferPool::ReleaseCache(IOBufferCache* cache) {
+  cache->Clear();
+  {
+    MutexLocker locker(&mutex_);
+    if (caches_ == cache) {
+      caches_ = cache->next();
+    } else {
+      IOBufferCache* previous = caches_;
+      while (previous->next() != cache) {
+        ASSERT(previous->next() != NULL);
+        previous = previous->next();
+      }
+      previous->set_next(cache->next());
+    }
+    released_hits_ += cache->hits();
+    released_misses_ += cache->misses();
+  }
+  delete cache;
+}
+
+
+uint8_t* IOBufferPool::Allocate(intptr_t size) {
+  ASSERT(size >= 0);
+  IOBufferCache* cache = CurrentCache();
+  IOBufferHeader* header;
+  if (size > kMaxBufferSize) {
+    cache->CountUncachedAllocation();
+    header = reinterpret_cast<IOBufferHeader*>(
+        malloc(sizeof(IOBufferHeader) + size));
+    if (header == NULL) {
+      FATAL("Out of memory allocating I/O buffer");
+    }
+    header->size_log2 = kUncachedSizeLog2;
+  } else {
+    header = cache->Allocate(SizeLog2(size));
+  }
+  return reinterpret_cast<uint8_t*>(header + 1);
+}
+
+
+void IOBufferPool::Free(uint8_t* buffer) {
+  if (buffer == NULL) return;
+  IOBufferHeader* header = reinterpret_cast<IOBufferHeader*>(buffer) - 1;
+  if (header->size_log2 == kUncachedSizeLog2) {
+    free(header);
+  } else {
+    CurrentCache()->Free(header);
+  }
+}
+
+
+int64_t IOBufferPool::hits() {
+  MutexLocker locker(&mutex_);
+  int64_t result = released_hits_;
+  for (IOBufferCache* cache = caches_; cache != NULL; cache = cache->next()) {
+    result += cache->hits();
+  }
+  return result;
+}
+
+
+int64_t IOBufferPool::misses() {
+  MutexLocker locker(&mutex_);
+  int64_t result = released_misses_;
+  for (IOBufferCache* cache = caches_; cache != NULL; cache = cache->next()) {
+    result += cache->misses();
+  }
+  return result;
+}
+
+
+int64_t IOBufferPool::bytes_resident() {
+  MutexLocker locker(&mutex_);
+  int64_t result = 0;
+  for (IOBufferCache* cache = caches_; cache != NULL; cache = cache->next()) {
+    result += cache->bytes_resident();
+  }
+  return result;
+}
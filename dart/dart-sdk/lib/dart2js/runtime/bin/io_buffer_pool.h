@@ -0,0 +1,62 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef BIN_IO_BUFFER_POOL_H_
+#define BIN_IO_BUFFER_POOL_H_
+
+#include "bin/builtin.h"
+#include "platform/globals.h"
+#include "platform/thread.h"
+
+// Forward declaration.
+class IOBufferCache;
+
+// Pool of temporary buffers for the I/O natives. Buffers are rounded
+// up to a power of two between kMinBufferSize and kMaxBufferSize and
+// released buffers are kept in a cache owned by the releasing thread,
+// so allocating and releasing a buffer never takes a lock. The cache
+// is freed when its thread exits. Requests
+// larger than kMaxBufferSize are served directly by the allocator and
+// never cached.
+class IOBufferPool {
+ public:
+  static const intptr_t kMinBufferSizeLog2 = 9;  // 512 bytes.
+  static const intptr_t kMaxBufferSizeLog2 = 20;  // 1 MB.
+  static const intptr_t kMinBufferSize = 1 << kMinBufferSizeLog2;
+  static const intptr_t kMaxBufferSize = 1 << kMaxBufferSizeLog2;
+  // Maximum number of released buffers of each size cached per thread.
+  static const intptr_t kMaxCachedBuffers = 8;
+
+  // Returns a buffer with room for at least size bytes. The buffer
+  // must be released with Free.
+  static uint8_t* Allocate(intptr_t size);
+  static void Free(uint8_t* buffer);
+
+  // Accumulated counters for all threads. A hit is an allocation
+  // served from a cache and a miss one served by the allocator. Bytes
+  // resident is the size of all buffers currently held in caches.
+  static int64_t hits();
+  static int64_t misses();
+  static int64_t bytes_resident();
+
+  // Called when a thread with a cache exits. Frees the cached buffers
+  // and unlinks and deletes the cache.
+  static void ReleaseCache(IOBufferCache* cache);
+
+ private:
+  static IOBufferCache* CurrentCache();
+
+  static dart::Mutex mutex_;
+  // Linked list of the caches of all live threads which have used the
+  // pool.
+  static IOBufferCache* caches_;
+  // Counters of the caches of threads which have exited.
+  static int64_t released_hits_;
+  static int64_t released_misses_;
+
+  DISALLOW_ALLOCATION();
+  DISALLOW_IMPLICIT_CONSTRUCTORS(IOBufferPool);
+};
+
+#endif  // BIN_IO_BUFFER_POOL_H_
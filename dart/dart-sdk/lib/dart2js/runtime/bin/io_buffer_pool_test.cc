@@ -0,0 +1,39 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/io_buffer_pool.h"
+#include "platform/assert.h"
+#include "platform/globals.h"
+#include "vm/unit_test.h"
+
+
+UNIT_TEST_CASE(IOBufferPoolReuse) {
+  uint8_t* buffer = IOBufferPool::Allocate(1000);
+  EXPECT(buffer != NULL);
+  // The whole rounded up size is usable.
+  buffer[1023] = 42;
+  IOBufferPool::Free(buffer);
+  EXPECT(IOBufferPool::bytes_resident() >= 1024);
+  // A buffer from the same size class is served from the cache, so
+  // the buffer just released comes back.
+  int64_t hits = IOBufferPool::hits();
+  int64_t misses = IOBufferPool::misses();
+  uint8_t* reused = IOBufferPool::Allocate(600);
+  EXPECT(reused == buffer);
+  EXPECT_EQ(hits + 1, IOBufferPool::hits());
+  EXPECT_EQ(misses, IOBufferPool::misses());
+  IOBufferPool::Free(reused);
+}
+
+
+UNIT_TEST_CASE(IOBufferPoolLargeBuffers) {
+  int64_t resident = IOBufferPool::bytes_resident();
+  int64_t misses = IOBufferPool::misses();
+  uint8_t* buffer = IOBufferPool::Allocate(IOBufferPool::kMaxBufferSize + 1);
+  EXPECT(buffer != NULL);
+  EXPECT_EQ(misses + 1, IOBufferPool::misses());
+  IOBufferPool::Free(buffer);
+  // Buffers above the largest size class are not cached.
+  EXPECT_EQ(resident, IOBufferPool::bytes_resident());
+}
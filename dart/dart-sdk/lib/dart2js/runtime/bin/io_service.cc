@@ -0,0 +1,81 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "bin/io_service.h"
+
+#include "bin/platform.h"
+#include "bin/thread.h"
+#include "platform/assert.h"
+
+#include "include/dart_api.h"
+
+
+dart::Mutex IOService::mutex_;
+intptr_t IOService::pool_size_ = 0;
+Dart_Port* IOService::ports_[IOService::kNumberOfServices] = { NULL };
+Dart_Port IOService::concurrent_ports_[IOService::kNumberOfServices] = {
+  kIllegalPort
+};
+
+
+intptr_t IOService::DefaultPoolSize() {
+  intptr_t size = 2 * Platform::NumberOfProcessors();
+  return (size < 4) ? 4 : size;
+}
+
+
+intptr_t IOService::pool_size() {
+  MutexLocker lock(&mutex_);
+  if (pool_size_ == 0) pool_size_ = DefaultPoolSize();
+  return pool_size_;
+}
+
+
+void IOService::set_pool_size(intptr_t size) {
+  ASSERT(size > 0);
+  MutexLocker lock(&mutex_);
+  for (intptr_t i = 0; i < kNumberOfServices; i++) {
+    ASSERT(ports_[i] == NULL);
+  }
+  pool_size_ = size;
+}
+
+
+Dart_Port IOService::GetServicePort(ServiceId service,
+                                    const char* name,
+                                    Dart_NativeMessageHandler handler,
+                                    intptr_t ordering_key) {
+  ASSERT(service >= 0 && service < kNumberOfServices);
+  MutexLocker lock(&mutex_);
+  if (ordering_key == kNoOrderingKey) {
+    if (concurrent_ports_[service] == kIllegalPort) {
+      concurrent_ports_[service] = Dart_NewNativePort(name, handler, true);
+    }
+    return concurrent_ports_[service];
+  }
+
+  if (pool_size_ == 0) pool_size_ = DefaultPoolSize();
+  if (ports_[service] == NULL) {
+    ports_[service] = new Dart_Port[pool_size_];
+    for (intptr_t i = 0; i < pool_size_; i++) {
+      ports_[service][i] = kIllegalPort;
+    }
+  }
+
+  // Ordering keys are usually pointers so mix in the higher bits to
+  // avoid mapping all keys with the same alignment to a few ports.
+  uintptr_t hash = static_cast<uintptr_t>(ordering_key);
+  hash = (hash >> 4) ^ (hash >> 12) ^ (hash >> 20);
+  intptr_t index = hash % pool_size_;
+
+  Dart_Port result = ports_[service][index];
+  if (result == kIllegalPort) {
+    // Requests on a port are handled one at a time to keep them in
+    // order.
+    result = Dart_NewNativePort(name, handler, false);
+    if (result == kIllegalPort) return kIllegalPort;
+    ports_[service][index] = result;
+  }
+  return result;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef BIN_IO_SERVICE_H_
+#define BIN_IO_SERVICE_H_
+
+#include "bin/builtin.h"
+#include "platform/globals.h"
+#include "platform/thread.h"
+
+// Native ports serving the asynchronous requests of the file,
+// directory, socket and process services.
+//
+// Requests without an ordering key may run in any order. Each service
+// has one port for them which handles its requests concurrently, so a
+// slow request, e.g. a large read or a stat on a slow network file
+// system, does not hold up the others.
+//
+// Requests sharing an ordering key, e.g. all requests for one open
+// file, have to be handled in order. They go to a pool of ports which
+// each handle one request at a time in the order the requests were
+// posted. A key always maps to the same port of the pool, so the pool
+// size bounds the number of ordered request streams of a service
+// running in parallel.
+class IOService {
+ public:
+  enum ServiceId {
+    kFileService = 0,
+    kDirectoryService = 1,
+    kSocketService = 2,
+    kProcessService = 3,
+    kNumberOfServices = 4
+  };
+
+  static const intptr_t kNoOrderingKey = 0;
+
+  // Number of ports per service for requests with an ordering key.
+  // Defaults to twice the number of processors as most requests block
+  // in system calls. The size can only be changed before the first
+  // port is handed out.
+  static intptr_t pool_size();
+  static void set_pool_size(intptr_t size);
+
+  // Returns the port for the given service and ordering key, creating
+  // it with the given name and handler if needed. Returns
+  // kIllegalPort if the port could not be created.
+  static Dart_Port GetServicePort(ServiceId service,
+                                  const char* name,
+                                  Dart_NativeMessageHandler handler,
+                                  intptr_t ordering_key);
+
+ private:
+  static intptr_t DefaultPoolSize();
+
+  static dart::Mutex mutex_;
+  static intptr_t pool_size_;
+  static Dart_Port* ports_[kNumberOfServices];
+  static Dart_Port concurrent_ports_[kNumberOfServices];
+
+  DISALLOW_ALLOCATION();
+  DISALLOW_IMPLICIT_CONSTRUCTORS(IOService);
+};
+
+#endif  // BIN_IO_SERVICE_H_
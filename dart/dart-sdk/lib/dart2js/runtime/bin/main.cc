@@ -16,9 +16,13 @@
 #include "bin/eventhandler.h"
 #include "bin/extensions.h"
 #include "bin/file.h"
+#include "bin/io_service.h"
 #include "bin/platform.h"
 #include "bin/process.h"
+#include "bin/socket.h"
+#include "bin/thread.h"
 #include "platform/globals.h"
+#include "platform/thread.h"
 
 // snapshot_buffer points to a snapshot if we link in a snapshot otherwise
 // it is initialized to NULL.
@@ -69,6 +73,16 @@ static const char* package_root = NULL;
 static bool has_compile_all = false;
 
 
+// Value of the --workers flag. Number of isolates running the main
+// function of the script, each in its own thread.
+static int worker_count = 1;
+
+
+// Global flag that is used to indicate that processes should be
+// started by the process zygote.
+static bool use_process_zygote = false;
+
+
 static bool IsWindowsHost() {
 #if defined(TARGET_OS_WINDOWS)
   return true;
@@ -146,6 +160,51 @@ static void ProcessImportMapOption(const char* map) {
 }
 
 
+static void ProcessZeroCopyThresholdOption(const char* threshold) {
+  ASSERT(threshold != NULL);
+  int value = atoi(threshold);
+  if (value < 0) {
+    fprintf(stderr, "unrecognized --zero_copy_threshold option syntax. "
+                    "Use --zero_copy_threshold=<bytes>\n");
+    return;
+  }
+  Socket::set_zero_copy_threshold(value);
+}
+
+
+static void ProcessIOServiceThreadsOption(const char* threads) {
+  ASSERT(threads != NULL);
+  int value = atoi(threads);
+  if (value < 1) {
+    fprintf(stderr, "unrecognized --io_service_threads option syntax. "
+                    "Use --io_service_threads=<number of threads>\n");
+    return;
+  }
+  IOService::set_pool_size(value);
+}
+
+
+static void ProcessProcessZygoteOption(const char* process_zygote) {
+  ASSERT(process_zygote != NULL);
+  use_process_zygote = true;
+}
+
+
+static void ProcessWorkersOption(const char* workers) {
+  ASSERT(workers != NULL);
+  worker_count = atoi(workers);
+  if (worker_count < 1) {
+    fprintf(stderr, "unrecognized --workers option syntax. "
+                    "Use --workers=<number of isolates>\n");
+    worker_count = 1;
+    return;
+  }
+  // Let the kernel balance incoming connections between the server
+  // sockets each worker binds to the same address and port.
+  ServerSocket::set_reuse_port(worker_count > 1);
+}
+
+
 static struct {
   const char* option_name;
   void (*process)(const char* option);
@@ -155,8 +214,12 @@ static struct {
   { "--debug", ProcessDebugOption },
   { "--generate_pprof_symbols=", ProcessPprofOption },
   { "--import_map=", ProcessImportMapOption },
+  { "--io_service_threads=", ProcessIOServiceThreadsOption },
   { "--package-root=", ProcessPackageRootOption },
+  { "--process_zygote", ProcessProcessZygoteOption },
   { "--generate_flow_graph", ProcessFlowGraphOption },
+  { "--workers=", ProcessWorkersOption },
+  { "--zero_copy_threshold=", ProcessZeroCopyThresholdOption },
   { NULL, NULL }
 };
 
@@ -612,6 +675,18 @@ static bool CreateIsolateAndSetup(const char* script_uri,
 static void PrintUsage() {
   fprintf(stderr,
           "dart [<vm-flags>] <dart-script-file> [<dart-options>]\n");
+  fprintf(stderr,
+          "  --workers=<n>  run main in <n> isolates, each in its own "
+          "thread\n");
+  fprintf(stderr,
+          "  --io_service_threads=<n>  handle up to <n> file, directory "
+          "and socket\n"
+          "      requests in parallel (default: twice the number of "
+          "processors)\n");
+  fprintf(stderr,
+          "  --process_zygote  start processes from a helper process "
+          "forked at startup\n"
+          "      (Linux only)\n");
 }
 
 
@@ -678,51 +753,27 @@ static int ErrorExit(const char* format, ...) {
 
   Dart_ExitScope();
   Dart_ShutdownIsolate();
-  free(const_cast<char*>(original_working_directory));
 
   return kErrorExitCode;
 }
 
 
-int main(int argc, char** argv) {
-  char* executable_name;
-  char* script_name;
-  CommandLineOptions vm_options(argc);
-  CommandLineOptions dart_options(argc);
-  CommandLineOptions import_map(argc);
-  import_map_options = &import_map;
-  bool print_flags_seen = false;
-
-  // Perform platform specific initialization.
-  if (!Platform::Initialize()) {
-    fprintf(stderr, "Initialization failed\n");
-  }
-
-  // Parse command line arguments.
-  if (ParseArguments(argc,
-                     argv,
-                     &vm_options,
-                     &executable_name,
-                     &script_name,
-                     &dart_options,
-                     &print_flags_seen) < 0) {
-    if (print_flags_seen) {
-      // Will set the VM flags, print them out and then we exit as no
-      // script was specified on the command line.
-      Dart_SetVMFlags(vm_options.count(), vm_options.arguments());
-      return 0;
-    } else {
-      PrintUsage();
-      return kErrorExitCode;
-    }
-  }
-
-  Dart_SetVMFlags(vm_options.count(), vm_options.arguments());
+// Arguments shared by all isolates running the main function of the
+// script.
+struct MainIsolateArguments {
+  const char* script_name;
+  const char* executable_name;
+  CommandLineOptions* dart_options;
+};
 
-  // Initialize the Dart VM.
-  Dart_Initialize(CreateIsolateAndSetup, NULL);
 
-  original_working_directory = Directory::Current();
+// Creates an isolate for the script, invokes its main function and
+// handles messages until the last active receive port is
+// closed. Returns the exit code for the process. The primary isolate
+// runs on the main thread and also starts the debugger connection
+// and dumps the profiler symbol information.
+static int RunMainIsolate(MainIsolateArguments* arguments, bool primary) {
+  const char* script_name = arguments->script_name;
 
   // Call CreateIsolateAndSetup which creates an isolate and loads up
   // the specified application script.
@@ -734,7 +785,6 @@ int main(int argc, char** argv) {
                                    NULL,
                                    &error)) {
     fprintf(stderr, "%s\n", error);
-    free(const_cast<char*>(original_working_directory));
     free(error);
     delete [] isolate_name;
     return kErrorExitCode;  // Indicates we encountered an error.
@@ -756,7 +806,9 @@ int main(int argc, char** argv) {
 
   // Create a dart options object that can be accessed from dart code.
   Dart_Handle options_result =
-      SetupRuntimeOptions(&dart_options, executable_name, script_name);
+      SetupRuntimeOptions(arguments->dart_options,
+                          arguments->executable_name,
+                          script_name);
   if (Dart_IsError(options_result)) {
     return ErrorExit("%s\n", Dart_GetError(options_result));
   }
@@ -777,7 +829,7 @@ int main(int argc, char** argv) {
   }
 
   // Start the debugger wire protocol handler if necessary.
-  if (start_debugger) {
+  if (start_debugger && primary) {
     ASSERT(debug_port != 0);
     DebuggerConnectionHandler::StartHandler(debug_ip, debug_port);
   }
@@ -794,14 +846,118 @@ int main(int argc, char** argv) {
   }
 
   Dart_ExitScope();
-  // Dump symbol information for the profiler.
-  DumpPprofSymbolInfo();
+  if (primary) {
+    // Dump symbol information for the profiler.
+    DumpPprofSymbolInfo();
+  }
   // Shutdown the isolate.
   Dart_ShutdownIsolate();
+  return 0;
+}
+
+
+// Worker threads started with --workers. The main thread waits on
+// the monitor until all workers have shut down their isolates.
+static dart::Monitor workers_monitor;
+static int running_workers = 0;
+static int workers_exit_code = 0;
+
+
+static void RunWorkerIsolate(uword args) {
+  MainIsolateArguments* arguments =
+      reinterpret_cast<MainIsolateArguments*>(args);
+  int exit_code = RunMainIsolate(arguments, false);
+  MonitorLocker locker(&workers_monitor);
+  if (exit_code != 0) {
+    workers_exit_code = exit_code;
+  }
+  running_workers--;
+  locker.Notify();
+}
+
+
+int main(int argc, char** argv) {
+  char* executable_name;
+  char* script_name;
+  CommandLineOptions vm_options(argc);
+  CommandLineOptions dart_options(argc);
+  CommandLineOptions import_map(argc);
+  import_map_options = &import_map;
+  bool print_flags_seen = false;
+
+  // Perform platform specific initialization.
+  if (!Platform::Initialize()) {
+    fprintf(stderr, "Initialization failed\n");
+  }
+
+  // Parse command line arguments.
+  if (ParseArguments(argc,
+                     argv,
+                     &vm_options,
+                     &executable_name,
+                     &script_name,
+                     &dart_options,
+                     &print_flags_seen) < 0) {
+    if (print_flags_seen) {
+      // Will set the VM flags, print them out and then we exit as no
+      // script was specified on the command line.
+      Dart_SetVMFlags(vm_options.count(), vm_options.arguments());
+      return 0;
+    } else {
+      PrintUsage();
+      return kErrorExitCode;
+    }
+  }
+
+  // The zygote is forked while the process has a single thread and a
+  // small heap, which keeps the zygote and the processes it starts
+  // cheap.
+  if (use_process_zygote && !Process::StartZygote()) {
+    fprintf(stderr, "Failed to start the process zygote\n");
+  }
+
+  Dart_SetVMFlags(vm_options.count(), vm_options.arguments());
+
+  // Initialize the Dart VM.
+  Dart_Initialize(CreateIsolateAndSetup, NULL);
+
+  original_working_directory = Directory::Current();
+
+  MainIsolateArguments arguments;
+  arguments.script_name = script_name;
+  arguments.executable_name = executable_name;
+  arguments.dart_options = &dart_options;
+
+  // Start the additional workers. The first isolate runs on the main
+  // thread.
+  for (int i = 1; i < worker_count; i++) {
+    {
+      MonitorLocker locker(&workers_monitor);
+      running_workers++;
+    }
+    int result = dart::Thread::Start(RunWorkerIsolate,
+                                     reinterpret_cast<uword>(&arguments));
+    if (result != 0) {
+      FATAL1("Failed to start worker isolate thread %d", result);
+    }
+  }
+
+  int exit_code = RunMainIsolate(&arguments, true);
+
+  {
+    MonitorLocker locker(&workers_monitor);
+    while (running_workers > 0) {
+      locker.Wait();
+    }
+    if (exit_code == 0) {
+      exit_code = workers_exit_code;
+    }
+  }
+
   // Terminate process exit-code handler.
   Process::TerminateExitCodeHandler();
 
   free(const_cast<char*>(original_working_directory));
 
-  return 0;
+  return exit_code;
 }
@@ -3,7 +3,9 @@
 // BSD-style license that can be found in the LICENSE file.
 
 #include "bin/dartutils.h"
+#include "bin/io_service.h"
 #include "bin/process.h"
+#include "bin/utils.h"
 
 #include "include/dart_api.h"
 
@@ -38,14 +40,18 @@ static char** ExtractCStringList(Dart_Handle strings,
   return string_args;
 }
 
-void FUNCTION_NAME(Process_Start)(Dart_NativeArguments args) {
-  Dart_EnterScope();
-  Dart_Handle process =  Dart_GetNativeArgument(args, 0);
-  intptr_t in;
-  intptr_t out;
-  intptr_t err;
-  intptr_t exit_event;
-  Dart_Handle status_handle = Dart_GetNativeArgument(args, 9);
+// Extract the path, arguments, working directory and environment of
+// a command line from the native arguments 1 to 4. On failure the
+// error is set on the status object and false is returned. The
+// arguments and environment are allocated with new[].
+static bool ExtractCommandLine(Dart_NativeArguments args,
+                               Dart_Handle status_handle,
+                               const char** path,
+                               char*** string_args,
+                               intptr_t* args_length,
+                               const char** working_directory,
+                               char*** string_environment,
+                               intptr_t* environment_length) {
   Dart_Handle path_handle = Dart_GetNativeArgument(args, 1);
   // The Dart code verifies that the path implements the String
   // interface. However, only builtin Strings are handled by
@@ -54,54 +60,80 @@ void FUNCTION_NAME(Process_Start)(Dart_NativeArguments args) {
     DartUtils::SetIntegerField(status_handle, "_errorCode", 0);
     DartUtils::SetStringField(
         status_handle, "_errorMessage", "Path must be a builtin string");
-    Dart_SetReturnValue(args, Dart_NewBoolean(false));
-    Dart_ExitScope();
-    return;
+    return false;
   }
-  const char* path = DartUtils::GetStringValue(path_handle);
+  *path = DartUtils::GetStringValue(path_handle);
   Dart_Handle arguments = Dart_GetNativeArgument(args, 2);
-  intptr_t args_length = 0;
-  char** string_args =
+  *string_args =
       ExtractCStringList(arguments,
                          status_handle,
                          "Arguments must be builtin strings",
-                         &args_length);
-  if (string_args == NULL) {
-    Dart_SetReturnValue(args, Dart_NewBoolean(false));
-    Dart_ExitScope();
-    return;
+                         args_length);
+  if (*string_args == NULL) {
+    return false;
   }
   Dart_Handle working_directory_handle = Dart_GetNativeArgument(args, 3);
   // Defaults to the current working directoy.
-  const char* working_directory = NULL;
+  *working_directory = NULL;
   if (Dart_IsString(working_directory_handle)) {
-    working_directory = DartUtils::GetStringValue(working_directory_handle);
+    *working_directory = DartUtils::GetStringValue(working_directory_handle);
   } else if (!Dart_IsNull(working_directory_handle)) {
-    delete[] string_args;
+    delete[] *string_args;
     DartUtils::SetIntegerField(status_handle, "_errorCode", 0);
     DartUtils::SetStringField(
         status_handle, "_errorMessage",
         "WorkingDirectory must be a builtin string");
-    Dart_SetReturnValue(args, Dart_NewBoolean(false));
-    Dart_ExitScope();
-    return;
+    return false;
   }
   Dart_Handle environment = Dart_GetNativeArgument(args, 4);
-  intptr_t environment_length = 0;
-  char** string_environment = NULL;
+  *environment_length = 0;
+  *string_environment = NULL;
   if (!Dart_IsNull(environment)) {
-    string_environment =
+    *string_environment =
         ExtractCStringList(environment,
                            status_handle,
                            "Environment values must be builtin strings",
-                           &environment_length);
-    if (string_environment == NULL) {
-      delete[] string_args;
-      Dart_SetReturnValue(args, Dart_NewBoolean(false));
-      Dart_ExitScope();
-      return;
+                           environment_length);
+    if (*string_environment == NULL) {
+      delete[] *string_args;
+      return false;
     }
   }
+  return true;
+}
+
+void FUNCTION_NAME(Process_Start)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_Handle process =  Dart_GetNativeArgument(args, 0);
+  intptr_t in;
+  intptr_t out;
+  intptr_t err;
+  intptr_t exit_event;
+  Dart_Handle status_handle = Dart_GetNativeArgument(args, 9);
+  const char* path;
+  char** string_args;
+  intptr_t args_length;
+  const char* working_directory;
+  char** string_environment;
+  intptr_t environment_length;
+  if (!ExtractCommandLine(args,
+                          status_handle,
+                          &path,
+                          &string_args,
+                          &args_length,
+                          &working_directory,
+                          &string_environment,
+                          &environment_length)) {
+    Dart_SetReturnValue(args, Dart_NewBoolean(false));
+    Dart_ExitScope();
+    return;
+  }
+  Process::StdioMode stdin_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 10)));
+  Process::StdioMode stdout_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 11)));
+  Process::StdioMode stderr_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 12)));
   Dart_Handle in_handle = Dart_GetNativeArgument(args, 5);
   Dart_Handle out_handle = Dart_GetNativeArgument(args, 6);
   Dart_Handle err_handle = Dart_GetNativeArgument(args, 7);
@@ -116,6 +148,9 @@ void FUNCTION_NAME(Process_Start)(Dart_NativeArguments args) {
                                   working_directory,
                                   string_environment,
                                   environment_length,
+                                  stdin_mode,
+                                  stdout_mode,
+                                  stderr_mode,
                                   &in,
                                   &out,
                                   &err,
@@ -144,6 +179,69 @@ void FUNCTION_NAME(Process_Start)(Dart_NativeArguments args) {
 }
 
 
+void FUNCTION_NAME(Process_KeepWarm)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_Handle status_handle = Dart_GetNativeArgument(args, 9);
+  // Without the process zygote there is nothing to keep processes
+  // started ahead of time.
+  if (!Process::HasZygote()) {
+    Dart_SetReturnValue(args, Dart_NewBoolean(false));
+    Dart_ExitScope();
+    return;
+  }
+  const char* path;
+  char** string_args;
+  intptr_t args_length;
+  const char* working_directory;
+  char** string_environment;
+  intptr_t environment_length;
+  if (!ExtractCommandLine(args,
+                          status_handle,
+                          &path,
+                          &string_args,
+                          &args_length,
+                          &working_directory,
+                          &string_environment,
+                          &environment_length)) {
+    Dart_SetReturnValue(args, Dart_NewBoolean(false));
+    Dart_ExitScope();
+    return;
+  }
+  Process::StdioMode stdin_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 5)));
+  Process::StdioMode stdout_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 6)));
+  Process::StdioMode stderr_mode = static_cast<Process::StdioMode>(
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 7)));
+  intptr_t count =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 8));
+  static const int kMaxChildOsErrorMessageLength = 256;
+  char os_error_message[kMaxChildOsErrorMessageLength];
+  int error_code = Process::KeepWarm(path,
+                                     string_args,
+                                     args_length,
+                                     working_directory,
+                                     string_environment,
+                                     environment_length,
+                                     stdin_mode,
+                                     stdout_mode,
+                                     stderr_mode,
+                                     count,
+                                     os_error_message,
+                                     kMaxChildOsErrorMessageLength);
+  if (error_code != 0) {
+    DartUtils::SetIntegerField(
+        status_handle, "_errorCode", error_code);
+    DartUtils::SetStringField(
+        status_handle, "_errorMessage", os_error_message);
+  }
+  delete[] string_args;
+  delete[] string_environment;
+  Dart_SetReturnValue(args, Dart_NewBoolean(error_code == 0));
+  Dart_ExitScope();
+}
+
+
 void FUNCTION_NAME(Process_Kill)(Dart_NativeArguments args) {
   Dart_EnterScope();
   intptr_t pid = DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 1));
@@ -152,3 +250,172 @@ void FUNCTION_NAME(Process_Kill)(Dart_NativeArguments args) {
   Dart_SetReturnValue(args, Dart_NewBoolean(success));
   Dart_ExitScope();
 }
+
+
+uint8_t* ProcessOutput::Space(intptr_t* available) {
+  if (limit_ != -1 && length_ == limit_) return NULL;
+  if (length_ == capacity_) {
+    intptr_t capacity = (capacity_ == 0) ? kInitialCapacity : 2 * capacity_;
+    if (limit_ != -1 && capacity > limit_) capacity = limit_;
+    uint8_t* data = reinterpret_cast<uint8_t*>(realloc(data_, capacity));
+    // If the buffer cannot grow the data read so far is kept and the
+    // rest is dropped as if the limit had been reached.
+    if (data == NULL) return NULL;
+    data_ = data;
+    capacity_ = capacity;
+  }
+  *available = capacity_ - length_;
+  return data_ + length_;
+}
+
+
+// Extract an array of C strings from an array of strings in a service
+// request. The strings are owned by the request. Returns NULL if an
+// element is not a string.
+static char** ExtractCStringArray(CObject* strings, intptr_t* length) {
+  CObjectArray array(strings);
+  *length = array.Length();
+  char** result = new char*[*length];
+  for (intptr_t i = 0; i < *length; i++) {
+    if (!array[i]->IsString()) {
+      delete[] result;
+      return NULL;
+    }
+    result[i] = CObjectString(array[i]).CString();
+  }
+  return result;
+}
+
+
+static CObject* NewByteArray(ProcessOutput* output) {
+  CObjectUint8Array* byte_array =
+      new CObjectUint8Array(CObject::NewUint8Array(output->length()));
+  if (output->length() > 0) {
+    memmove(byte_array->Buffer(), output->data(), output->length());
+  }
+  return byte_array;
+}
+
+
+// Run a process to completion. The request holds the path, the
+// arguments, the working directory or null, the environment or null,
+// the limit of the output of each stream or -1 and the timeout in
+// milliseconds or -1. The response holds the exit code, the output of
+// stdout and stderr, the user and system CPU time in microseconds,
+// the maximum resident set size in bytes, whether the process was
+// killed at the timeout and whether output was dropped.
+static CObject* ProcessRunRequest(const CObjectArray& request) {
+  if (request.Length() != 7 ||
+      !request[1]->IsString() ||
+      !request[2]->IsArray() ||
+      !(request[3]->IsString() || request[3]->IsNull()) ||
+      !(request[4]->IsArray() || request[4]->IsNull()) ||
+      !request[5]->IsIntptr() ||
+      !request[6]->IsIntptr()) {
+    return CObject::IllegalArgumentError();
+  }
+  CObjectString path(request[1]);
+  intptr_t arguments_length;
+  char** arguments = ExtractCStringArray(request[2], &arguments_length);
+  if (arguments == NULL) return CObject::IllegalArgumentError();
+  const char* working_directory = NULL;
+  if (request[3]->IsString()) {
+    working_directory = CObjectString(request[3]).CString();
+  }
+  intptr_t environment_length = 0;
+  char** environment = NULL;
+  if (request[4]->IsArray()) {
+    environment = ExtractCStringArray(request[4], &environment_length);
+    if (environment == NULL) {
+      delete[] arguments;
+      return CObject::IllegalArgumentError();
+    }
+  }
+  intptr_t output_limit = CObjectIntptr(request[5]).Value();
+  int64_t timeout_millis = CObjectIntptr(request[6]).Value();
+
+  static const int kMaxChildOsErrorMessageLength = 256;
+  char os_error_message[kMaxChildOsErrorMessageLength];
+  ProcessRunResult result(output_limit);
+  int error_code = Process::Run(path.CString(),
+                                arguments,
+                                arguments_length,
+                                working_directory,
+                                environment,
+                                environment_length,
+                                timeout_millis,
+                                &result,
+                                os_error_message,
+                                kMaxChildOsErrorMessageLength);
+  delete[] arguments;
+  delete[] environment;
+  if (error_code != 0) {
+    OSError os_error(error_code, os_error_message, OSError::kSystem);
+    return CObject::NewOSError(&os_error);
+  }
+  CObjectArray* response = new CObjectArray(CObject::NewArray(9));
+  response->SetAt(0, new CObjectInt32(CObject::NewInt32(0)));
+  response->SetAt(1, new CObjectInt32(CObject::NewInt32(result.exit_code())));
+  response->SetAt(2, NewByteArray(result.out()));
+  response->SetAt(3, NewByteArray(result.err()));
+  response->SetAt(
+      4, new CObjectInt64(CObject::NewInt64(result.user_time_micros())));
+  response->SetAt(
+      5, new CObjectInt64(CObject::NewInt64(result.system_time_micros())));
+  response->SetAt(
+      6, new CObjectInt64(CObject::NewInt64(result.max_resident_set_size())));
+  response->SetAt(7, CObject::Bool(result.timed_out()));
+  response->SetAt(
+      8,
+      CObject::Bool(result.out()->truncated() || result.err()->truncated()));
+  return response;
+}
+
+
+void ProcessService(Dart_Port dest_port_id,
+                    Dart_Port reply_port_id,
+                    Dart_CObject* message) {
+  CObject* response = CObject::False();
+  CObjectArray request(message);
+  if (message->type == Dart_CObject::kArray) {
+    if (request.Length() > 1 && request[0]->IsInt32()) {
+      CObjectInt32 request_type(request[0]);
+      switch (request_type.Value()) {
+        case Process::kRunRequest:
+          response = ProcessRunRequest(request);
+          break;
+        default:
+          UNREACHABLE();
+      }
+    }
+  }
+
+  Dart_PostCObject(reply_port_id, response->AsApiCObject());
+}
+
+
+// A run request blocks the thread handling it until the process has
+// exited. Run requests have no ordering key, so they are handled on
+// the concurrent port of the process service and a long running
+// process does not hold up other runs. Being a service of its own,
+// the process service does not hold up file, directory or socket
+// requests either.
+Dart_Port Process::GetServicePort() {
+  return IOService::GetServicePort(IOService::kProcessService,
+                                   "ProcessService",
+                                   ProcessService,
+                                   IOService::kNoOrderingKey);
+}
+
+
+void FUNCTION_NAME(Process_NewServicePort)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_SetReturnValue(args, Dart_Null());
+  Dart_Port service_port = Process::GetServicePort();
+  if (service_port != kIllegalPort) {
+    // Return a send port for the service port.
+    Dart_Handle send_port = Dart_NewSendPort(service_port);
+    Dart_SetReturnValue(args, send_port);
+  }
+  Dart_ExitScope();
+}
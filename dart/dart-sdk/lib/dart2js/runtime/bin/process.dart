@@ -38,6 +38,11 @@ class Process {
    * Returns a [:Future<ProcessResult>:] that completes with the
    * result of running the process, i.e., exit code, standard out and
    * standard in.
+   *
+   * On Linux the process is run to completion and its output is
+   * collected natively, and the result includes its resource usage.
+   * This is not done if stdio modes other than
+   * [:ProcessStdio.PIPE:] are requested.
    */
   static Future<ProcessResult> run(String executable,
                                    List<String> arguments,
@@ -45,6 +50,34 @@ class Process {
     return _Process.run(executable, arguments, options);
   }
 
+  /**
+   * Asks the process zygote to keep [count] processes running the
+   * [executable] with the specified [arguments] started ahead of
+   * time. A later [start] with the same executable, arguments and
+   * [ProcessOptions] gets one of them instead of starting a new
+   * process. Processes kept warm should wait for input on stdin
+   * before doing any work.
+   *
+   * A [run] only gets a process kept warm if stdio modes other than
+   * [:ProcessStdio.PIPE:] are requested. Otherwise it runs the
+   * process natively with stdin connected to the null device, which
+   * a process kept warm could not wait on.
+   *
+   * Lowering the count does not stop processes which have already
+   * been started.
+   *
+   * The process zygote is only available on Linux when the VM is
+   * started with --process_zygote. Returns false if it is not
+   * available and true otherwise. Throws a [ProcessException] if the
+   * zygote fails to handle the request.
+   */
+  static bool keepWarm(String executable,
+                       List<String> arguments,
+                       int count,
+                       [ProcessOptions options]) {
+    return _Process.keepWarm(executable, arguments, count, options);
+  }
+
   /**
    * Returns an input stream of the process stdout.
    *
@@ -132,6 +165,40 @@ interface ProcessResult {
    * Standard error from the process as a string.
    */
   String get stderr();
+
+  /**
+   * Whether the process was killed because it did not complete
+   * within the [:ProcessOptions.timeout:].
+   */
+  bool get timedOut();
+
+  /**
+   * Whether output beyond [:ProcessOptions.maxOutputBytes:] was
+   * dropped from [stdout] or [stderr].
+   */
+  bool get outputTruncated();
+
+  /**
+   * CPU time in microseconds the process spent in user mode, or null
+   * if it is not available on the platform.
+   */
+  int get userTime();
+
+  /**
+   * CPU time in microseconds the process spent in the kernel, or null
+   * if it is not available on the platform.
+   */
+  int get systemTime();
+
+  /**
+   * Maximum resident set size of the process in bytes, or null if it
+   * is not available on the platform.
+   *
+   * On Linux the value includes the resident set size of the process
+   * which started it at the time it was started. Start the VM with
+   * --process_zygote to keep this small.
+   */
+  int get maxResidentSetSize();
 }
 
 
@@ -170,6 +237,28 @@ class ProcessOptions {
    */
   Encoding stderrEncoding;
 
+  /**
+   * The maximum number of bytes of stdout and of stderr kept when
+   * running a non-interactive process with [:Process.run:]. Output
+   * beyond the limit is read and dropped. If not set all output is
+   * kept.
+   *
+   * This option is only supported where [:Process.run:] collects
+   * the output natively and is ignored otherwise. It is ignored for
+   * interactive processes started with [:Process.start:].
+   */
+  int maxOutputBytes;
+
+  /**
+   * The number of milliseconds a non-interactive process started
+   * with [:Process.run:] may run. A process which has not completed
+   * by then is killed. If not set the process may run forever.
+   *
+   * This option is ignored for interactive processes started with
+   * [:Process.start:].
+   */
+  int timeout;
+
   /**
    * Provides the environment variables for the process. If not set
    * the environment of the parent process is inherited.
@@ -179,6 +268,61 @@ class ProcessOptions {
    * code-points outside the ASCII range is passed in.
    */
   Map<String, String> environment;
+
+  /**
+   * How stdin of the process is connected. The default is
+   * [:ProcessStdio.PIPE:].
+   */
+  ProcessStdio stdinMode;
+
+  /**
+   * How stdout of the process is connected. The default is
+   * [:ProcessStdio.PIPE:].
+   */
+  ProcessStdio stdoutMode;
+
+  /**
+   * How stderr of the process is connected. The default is
+   * [:ProcessStdio.PIPE:]. With [:ProcessStdio.MERGE:] stderr goes
+   * wherever stdout goes.
+   */
+  ProcessStdio stderrMode;
+}
+
+
+/**
+ * [ProcessStdio] specifies how a stdio stream of a process is
+ * connected, see [ProcessOptions]. Only [PIPE] is supported on
+ * Windows.
+ *
+ * A stream which is not piped to Dart has no data on the process
+ * stdout or stderr input streams and data written to the process
+ * stdin output stream is discarded. Avoiding the pipes makes starting
+ * the process cheaper.
+ */
+class ProcessStdio {
+  /**
+   * The stream is a pipe to the Dart process.
+   */
+  static final ProcessStdio PIPE = const ProcessStdio._mode(0);
+
+  /**
+   * The process uses the stream of the Dart process.
+   */
+  static final ProcessStdio INHERIT = const ProcessStdio._mode(1);
+
+  /**
+   * The stream is connected to the null device.
+   */
+  static final ProcessStdio NULL = const ProcessStdio._mode(2);
+
+  /**
+   * For stderr only, stderr goes wherever stdout goes.
+   */
+  static final ProcessStdio MERGE = const ProcessStdio._mode(3);
+
+  const ProcessStdio._mode(int this._value);
+  final int _value;
 }
 
 /**
@@ -9,16 +9,122 @@
 #include "platform/globals.h"
 
 
+// Output of a stdio stream of a process run to completion by
+// Process::Run. The data grows up to the limit. Data beyond the limit
+// is read and dropped so the process does not block writing it.
+class ProcessOutput {
+ public:
+  // A limit of -1 means no limit.
+  explicit ProcessOutput(intptr_t limit)
+      : data_(NULL), length_(0), capacity_(0), limit_(limit),
+        truncated_(false) { }
+  ~ProcessOutput() { free(data_); }
+
+  // Returns the free space at the end of the data, growing the buffer
+  // if needed, and sets available to its size. Returns NULL if the
+  // limit has been reached or the buffer cannot grow.
+  uint8_t* Space(intptr_t* available);
+
+  // Adds length bytes written to the space returned by Space to the
+  // data.
+  void Commit(intptr_t length) { length_ += length; }
+
+  // Records that data beyond the limit has been dropped.
+  void MarkTruncated() { truncated_ = true; }
+
+  uint8_t* data() const { return data_; }
+  intptr_t length() const { return length_; }
+  bool truncated() const { return truncated_; }
+
+ private:
+  static const intptr_t kInitialCapacity = 4 * KB;
+
+  uint8_t* data_;
+  intptr_t length_;
+  intptr_t capacity_;
+  intptr_t limit_;
+  bool truncated_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessOutput);
+};
+
+
+// Exit code, output and resource usage of a process run to completion
+// by Process::Run.
+class ProcessRunResult {
+ public:
+  explicit ProcessRunResult(intptr_t output_limit)
+      : exit_code_(0),
+        timed_out_(false),
+        user_time_micros_(0),
+        system_time_micros_(0),
+        max_resident_set_size_(0),
+        out_(output_limit),
+        err_(output_limit) { }
+
+  int exit_code() const { return exit_code_; }
+  void set_exit_code(int exit_code) { exit_code_ = exit_code; }
+  bool timed_out() const { return timed_out_; }
+  void set_timed_out(bool timed_out) { timed_out_ = timed_out; }
+  int64_t user_time_micros() const { return user_time_micros_; }
+  int64_t system_time_micros() const { return system_time_micros_; }
+  // In bytes.
+  int64_t max_resident_set_size() const { return max_resident_set_size_; }
+  void SetUsage(int64_t user_time_micros,
+                int64_t system_time_micros,
+                int64_t max_resident_set_size) {
+    user_time_micros_ = user_time_micros;
+    system_time_micros_ = system_time_micros;
+    max_resident_set_size_ = max_resident_set_size;
+  }
+
+  // Output of stdout and stderr of the process.
+  ProcessOutput* out() { return &out_; }
+  ProcessOutput* err() { return &err_; }
+
+ private:
+  int exit_code_;
+  bool timed_out_;
+  int64_t user_time_micros_;
+  int64_t system_time_micros_;
+  int64_t max_resident_set_size_;
+  ProcessOutput out_;
+  ProcessOutput err_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessRunResult);
+};
+
+
 class Process {
  public:
+  // These values have to be kept in sync with the request types of
+  // _ProcessRun in process_impl.dart.
+  enum ProcessRequest {
+    kRunRequest = 0
+  };
+
+  // How a stdio stream of a started process is connected. These values
+  // have to be kept in sync with the values of ProcessStdio in
+  // process.dart. kStdioMergeStdout is only used for stderr.
+  enum StdioMode {
+    kStdioPipe = 0,
+    kStdioInherit = 1,
+    kStdioNull = 2,
+    kStdioMergeStdout = 3
+  };
+
   // Start a new process providing access to stdin, stdout, stderr and
-  // process exit streams.
+  // process exit streams. The id of a stdio stream which is not piped
+  // is set to -1.
   static int Start(const char* path,
                    char* arguments[],
                    intptr_t arguments_length,
                    const char* working_directory,
                    char* environment[],
                    intptr_t environment_length,
+                   StdioMode stdin_mode,
+                   StdioMode stdout_mode,
+                   StdioMode stderr_mode,
                    intptr_t* in,
                    intptr_t* out,
                    intptr_t* err,
@@ -27,9 +133,66 @@ class Process {
                    char* os_error_message,
                    int os_error_message_len);
 
+  // Start the process zygote, a helper process which starts the
+  // processes for Start so the cost of starting a process does not
+  // grow with the heap of the VM. Must be called before the VM is
+  // initialized, while the process has a single thread. Returns false
+  // if the zygote could not be started or is not supported on the
+  // platform.
+  static bool StartZygote();
+
+  // Returns whether processes are started by the process zygote.
+  static bool HasZygote();
+
+  // Ask the process zygote to keep count processes for the command
+  // line started ahead of time. Start hands them out for the same
+  // command line, working directory, environment and stdio modes.
+  // Must only be called if HasZygote returns true. Returns 0 or an
+  // error code.
+  static int KeepWarm(const char* path,
+                      char* arguments[],
+                      intptr_t arguments_length,
+                      const char* working_directory,
+                      char* environment[],
+                      intptr_t environment_length,
+                      StdioMode stdin_mode,
+                      StdioMode stdout_mode,
+                      StdioMode stderr_mode,
+                      intptr_t count,
+                      char* os_error_message,
+                      int os_error_message_len);
+
+  // Run a process to completion with stdin connected to the null
+  // device, capturing stdout and stderr into the output buffers of
+  // the result. If timeout_millis is not -1 the process is killed
+  // when it has not exited after that many milliseconds. Blocks until
+  // the process has exited and its output has been read. Only
+  // supported on Linux. Returns 0 or an error code.
+  static int Run(const char* path,
+                 char* arguments[],
+                 intptr_t arguments_length,
+                 const char* working_directory,
+                 char* environment[],
+                 intptr_t environment_length,
+                 int64_t timeout_millis,
+                 ProcessRunResult* result,
+                 char* os_error_message,
+                 int os_error_message_len);
+
+  // Get a port for the process service, which runs processes to
+  // completion for Process.run.
+  static Dart_Port GetServicePort();
+
   // Kill a process with a given pid.
   static bool Kill(intptr_t id, int signal);
 
+  // On Linux the exit event of a started process is a process
+  // descriptor, or the read end of a pipe its exit code is written to
+  // on kernels without process descriptors. Returns the pid of the
+  // process of a process descriptor returned by Start and forgets it,
+  // or 0 for an exit code pipe. Only supported on Linux.
+  static intptr_t TakeProcessDescriptorPid(intptr_t fd);
+
   // Terminate the exit code handler thread. Does not return before
   // the thread has terminated.
   static void TerminateExitCodeHandler();
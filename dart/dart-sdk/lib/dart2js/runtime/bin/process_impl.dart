@@ -18,12 +18,66 @@ class _Process extends Process {
   static Future<ProcessResult> run(String path,
                                    List<String> arguments,
                                    [ProcessOptions options]) {
+    if (Platform.operatingSystem == 'linux' && _ProcessRun._supports(options)) {
+      return new _ProcessRun(path, arguments, options)._result;
+    }
     return new _NonInteractiveProcess._start(path, arguments, options)._result;
   }
 
+  static bool keepWarm(String path,
+                       List<String> arguments,
+                       int count,
+                       ProcessOptions options) {
+    if (count is !int || count < 0) {
+      throw new IllegalArgumentException(
+          "Count is not a non-negative int: $count");
+    }
+    var process = new _Process._unstarted();
+    process._setOptions(path, arguments, options);
+    var status = new _ProcessStartStatus();
+    bool success = process._keepWarmNative(process._path,
+                                           process._arguments,
+                                           process._workingDirectory,
+                                           process._environment,
+                                           process._stdinMode._value,
+                                           process._stdoutMode._value,
+                                           process._stderrMode._value,
+                                           count,
+                                           status);
+    if (!success && status._errorMessage !== null) {
+      throw new ProcessException(status._errorMessage, status._errorCode);
+    }
+    return success;
+  }
+
   _Process.start(String path,
                  List<String> arguments,
                  ProcessOptions options) {
+    _setOptions(path, arguments, options);
+
+    _in = new _Socket._internalReadOnly();  // stdout coming from process.
+    _out = new _Socket._internalWriteOnly();  // stdin going to process.
+    _err = new _Socket._internalReadOnly();  // stderr coming from process.
+    if (Platform.operatingSystem == 'linux') {
+      _exitHandler = new _ProcessExitHandler();
+    } else {
+      _exitHandler = new _Socket._internalReadOnly();
+    }
+    _closed = false;
+    _ended = false;
+    _started = false;
+    _onExit = null;
+    // TODO(ager): Make the actual process starting really async instead of
+    // simulating it with a timer.
+    new Timer(0, (Timer ignore) => _start());
+  }
+
+  // Only holds the validated options of a command line for keepWarm.
+  _Process._unstarted();
+
+  void _setOptions(String path,
+                   List<String> arguments,
+                   ProcessOptions options) {
     if (path is !String) {
       throw new IllegalArgumentException("Path is not a String: $path");
     }
@@ -72,17 +126,29 @@ class _Process extends Process {
       });
     }
 
-    _in = new _Socket._internalReadOnly();  // stdout coming from process.
-    _out = new _Socket._internalWriteOnly();  // stdin going to process.
-    _err = new _Socket._internalReadOnly();  // stderr coming from process.
-    _exitHandler = new _Socket._internalReadOnly();
-    _closed = false;
-    _ended = false;
-    _started = false;
-    _onExit = null;
-    // TODO(ager): Make the actual process starting really async instead of
-    // simulating it with a timer.
-    new Timer(0, (Timer ignore) => _start());
+    ProcessStdio stdinMode;
+    ProcessStdio stdoutMode;
+    ProcessStdio stderrMode;
+    if (options !== null) {
+      stdinMode = options.stdinMode;
+      stdoutMode = options.stdoutMode;
+      stderrMode = options.stderrMode;
+    }
+    _stdinMode = _checkStdioMode(stdinMode, "stdinMode");
+    _stdoutMode = _checkStdioMode(stdoutMode, "stdoutMode");
+    _stderrMode = _checkStdioMode(stderrMode, "stderrMode");
+    if (_stdinMode === ProcessStdio.MERGE ||
+        _stdoutMode === ProcessStdio.MERGE) {
+      throw new IllegalArgumentException("Only stderr can be merged");
+    }
+  }
+
+  ProcessStdio _checkStdioMode(mode, String name) {
+    if (mode === null) return ProcessStdio.PIPE;
+    if (mode is !ProcessStdio) {
+      throw new IllegalArgumentException("$name is not a ProcessStdio: $mode");
+    }
+    return mode;
   }
 
   String _windowsArgumentEscape(String argument) {
@@ -148,7 +214,10 @@ class _Process extends Process {
                                 _out,
                                 _err,
                                 _exitHandler,
-                                status);
+                                status,
+                                _stdinMode._value,
+                                _stdoutMode._value,
+                                _stderrMode._value);
     if (!success) {
       close();
       _reportError(new ProcessException(status._errorMessage,
@@ -165,35 +234,41 @@ class _Process extends Process {
 
     // Setup an exit handler to handle internal cleanup and possible
     // callback when a process terminates.
-    int exitDataRead = 0;
-    final int EXIT_DATA_SIZE = 8;
-    List<int> exitDataBuffer = new List<int>(EXIT_DATA_SIZE);
-    _exitHandler.inputStream.onData = () {
-
-      int exitCode(List<int> ints) {
-        var code = _intFromBytes(ints, 0);
-        var negative = _intFromBytes(ints, 4);
-        assert(negative == 0 || negative == 1);
-        return (negative == 0) ? code : -code;
-      }
-
-      void handleExit() {
-        _ended = true;
-        if (_onExit !== null) {
-          _onExit(exitCode(exitDataBuffer));
+    if (_exitHandler is _ProcessExitHandler) {
+      _exitHandler._listen(_handleExit);
+    } else {
+      int exitDataRead = 0;
+      final int EXIT_DATA_SIZE = 8;
+      List<int> exitDataBuffer = new List<int>(EXIT_DATA_SIZE);
+      _exitHandler.inputStream.onData = () {
+
+        int exitCode(List<int> ints) {
+          var code = _intFromBytes(ints, 0);
+          var negative = _intFromBytes(ints, 4);
+          assert(negative == 0 || negative == 1);
+          return (negative == 0) ? code : -code;
         }
-      }
 
-      exitDataRead += _exitHandler.inputStream.readInto(
-          exitDataBuffer, exitDataRead, EXIT_DATA_SIZE - exitDataRead);
-      if (exitDataRead == EXIT_DATA_SIZE) handleExit();
-    };
+        exitDataRead += _exitHandler.inputStream.readInto(
+            exitDataBuffer, exitDataRead, EXIT_DATA_SIZE - exitDataRead);
+        if (exitDataRead == EXIT_DATA_SIZE) {
+          _handleExit(exitCode(exitDataBuffer));
+        }
+      };
+    }
 
     if (_onStart !== null) {
       _onStart();
     }
   }
 
+  void _handleExit(int exitCode) {
+    _ended = true;
+    if (_onExit !== null) {
+      _onExit(exitCode);
+    }
+  }
+
   bool _startNative(String path,
                     List<String> arguments,
                     String workingDirectory,
@@ -201,13 +276,27 @@ class _Process extends Process {
                     Socket input,
                     Socket output,
                     Socket error,
-                    Socket exitHandler,
-                    _ProcessStartStatus status) native "Process_Start";
+                    exitHandler,
+                    _ProcessStartStatus status,
+                    int stdinMode,
+                    int stdoutMode,
+                    int stderrMode) native "Process_Start";
+
+  bool _keepWarmNative(String path,
+                       List<String> arguments,
+                       String workingDirectory,
+                       List<String> environment,
+                       int stdinMode,
+                       int stdoutMode,
+                       int stderrMode,
+                       int count,
+                       _ProcessStartStatus status) native "Process_KeepWarm";
 
   InputStream get stdout() {
     if (_closed) {
       throw new ProcessException("Process closed");
     }
+    if (_stdoutMode !== ProcessStdio.PIPE) return _emptyInputStream();
     return _in.inputStream;
   }
 
@@ -215,6 +304,7 @@ class _Process extends Process {
     if (_closed) {
       throw new ProcessException("Process closed");
     }
+    if (_stderrMode !== ProcessStdio.PIPE) return _emptyInputStream();
     return _err.inputStream;
   }
 
@@ -222,9 +312,23 @@ class _Process extends Process {
     if (_closed) {
       throw new ProcessException("Process closed");
     }
+    // Data written to stdin which is not piped is discarded.
+    if (_stdinMode !== ProcessStdio.PIPE) {
+      if (_discardedStdin === null) {
+        _discardedStdin = new _DiscardOutputStream();
+      }
+      return _discardedStdin;
+    }
     return _out.outputStream;
   }
 
+  // Streams from the process which are not piped have no data.
+  InputStream _emptyInputStream() {
+    var stream = new ListInputStream();
+    stream.markEndOfStream();
+    return stream;
+  }
+
   void kill([ProcessSignal signal = ProcessSignal.SIGTERM]) {
     if (signal is! ProcessSignal) {
       throw new IllegalArgumentException(
@@ -288,11 +392,17 @@ class _Process extends Process {
   ObjectArray<String> _arguments;
   String _workingDirectory;
   List<String> _environment;
+  ProcessStdio _stdinMode;
+  ProcessStdio _stdoutMode;
+  ProcessStdio _stderrMode;
   // Private methods of _Socket are used by _in, _out, and _err.
   _Socket _in;
   _Socket _out;
   _Socket _err;
-  Socket _exitHandler;
+  _DiscardOutputStream _discardedStdin;
+  // A _ProcessExitHandler on Linux and a Socket reading the exit code
+  // from a pipe elsewhere.
+  var _exitHandler;
   int _pid;
   bool _closed;
   bool _ended;
@@ -303,6 +413,81 @@ class _Process extends Process {
 }
 
 
+// Output stream for a process stdin which is not piped. Written data
+// is dropped right away so it does not accumulate.
+class _DiscardOutputStream
+    extends _BaseOutputStream implements OutputStream {
+  bool write(List<int> buffer, [bool copyBuffer = false]) {
+    if (_closed) throw new StreamException.streamClosed();
+    return true;
+  }
+
+  bool writeFrom(List<int> buffer, [int offset = 0, int len]) {
+    if (_closed) throw new StreamException.streamClosed();
+    return true;
+  }
+
+  void flush() {
+    // Nothing is buffered.
+  }
+
+  void close() {
+    if (_closed) throw new StreamException.streamClosed();
+    _closed = true;
+    if (_onClosed !== null) new Timer(0, (Timer ignore) => _onClosed());
+  }
+
+  void destroy() {
+    close();
+  }
+
+  void set onNoPendingWrites(void callback()) {
+    // Writes never pend, so the callback is called right away.
+    if (callback !== null && !_closed) {
+      new Timer(0, (Timer ignore) => callback());
+    }
+  }
+
+  void set onClosed(void callback()) {
+    _onClosed = callback;
+  }
+
+  bool _closed = false;
+  Function _onClosed;
+}
+
+
+// On Linux the event handler watches a process descriptor for the
+// exit of the process and posts the exit code to the port of the
+// _ProcessExitHandler.
+class _ProcessExitHandler {
+  void _listen(void onExit(int exitCode)) {
+    _EventHandler._start();
+    _port = new ReceivePort();
+    _port.receive((exitCode, replyTo) {
+      close();
+      onExit(exitCode);
+    });
+    _EventHandler._sendData(_id,
+                            _port,
+                            (1 << _SocketBase._IN_EVENT) |
+                            (1 << _SocketBase._PROCESS_EXIT));
+  }
+
+  void close() {
+    if (_port === null) return;
+    // If the process has not exited yet the event handler keeps
+    // watching it so it is reaped when it exits.
+    _EventHandler._sendData(_id, _port, 1 << _SocketBase._CLOSE_COMMAND);
+    _port.close();
+    _port = null;
+  }
+
+  int _id;
+  ReceivePort _port;
+}
+
+
 // _NonInteractiveProcess is a wrapper around an interactive process
 // that buffers output so it can be delivered when the process exits.
 // _NonInteractiveProcess is used to implement the Process.run
@@ -332,8 +517,17 @@ class _NonInteractiveProcess {
       }
     }
 
+    var timeout = _ProcessRun._checkTimeout(options);
+    _ProcessRun._checkMaxOutputBytes(options);
+
     // Start the underlying process.
     _process = new _Process.start(path, arguments, options);
+    if (timeout !== null) {
+      _timer = new Timer(timeout, (Timer ignore) {
+        _timedOut = true;
+        _process.kill(ProcessSignal.SIGKILL);
+      });
+    }
 
     // Make sure stdin is closed.
     _process.onStart = _process.stdin.close;
@@ -374,9 +568,11 @@ class _NonInteractiveProcess {
 
   void _checkDone() {
     if (_exitCode != null && _stderrClosed && _stdoutClosed) {
+      if (_timer !== null) _timer.cancel();
       _completer.complete(new _ProcessResult(_exitCode,
                                              _stdoutBuffer.toString(),
-                                             _stderrBuffer.toString()));
+                                             _stderrBuffer.toString(),
+                                             _timedOut));
     }
   }
 
@@ -389,15 +585,150 @@ class _NonInteractiveProcess {
   int _exitCode;
   bool _stdoutClosed = false;
   bool _stderrClosed = false;
+  Timer _timer;
+  bool _timedOut = false;
+}
+
+
+// _ProcessRun runs a process to completion on the process service,
+// which collects the output and resource usage natively and responds
+// once with all of it. It implements Process.run on Linux.
+class _ProcessRun {
+  static final RUN_REQUEST = 0;
+
+  static final SUCCESS_RESPONSE = 0;
+  static final ILLEGAL_ARGUMENT_RESPONSE = 1;
+  static final OSERROR_RESPONSE = 2;
+
+  // Indices of the values of a successful response. These have to be
+  // kept in sync with ProcessRunRequest in process.cc.
+  static final RESPONSE_EXIT_CODE = 1;
+  static final RESPONSE_STDOUT = 2;
+  static final RESPONSE_STDERR = 3;
+  static final RESPONSE_USER_TIME = 4;
+  static final RESPONSE_SYSTEM_TIME = 5;
+  static final RESPONSE_MAX_RSS = 6;
+  static final RESPONSE_TIMED_OUT = 7;
+  static final RESPONSE_TRUNCATED = 8;
+
+  // The native run always pipes stdout and stderr and closes stdin.
+  static bool _supports(ProcessOptions options) {
+    if (options === null) return true;
+    bool isPipe(mode) => mode === null || mode === ProcessStdio.PIPE;
+    return isPipe(options.stdinMode) &&
+           isPipe(options.stdoutMode) &&
+           isPipe(options.stderrMode);
+  }
+
+  static int _checkTimeout(ProcessOptions options) {
+    if (options === null || options.timeout === null) return null;
+    var timeout = options.timeout;
+    if (timeout is !int || timeout < 0) {
+      throw new IllegalArgumentException(
+          "timeout is not a non-negative int: $timeout");
+    }
+    return timeout;
+  }
+
+  static int _checkMaxOutputBytes(ProcessOptions options) {
+    if (options === null || options.maxOutputBytes === null) return null;
+    var maxOutputBytes = options.maxOutputBytes;
+    if (maxOutputBytes is !int || maxOutputBytes < 0) {
+      throw new IllegalArgumentException(
+          "maxOutputBytes is not a non-negative int: $maxOutputBytes");
+    }
+    return maxOutputBytes;
+  }
+
+  static SendPort _newServicePort() native "Process_NewServicePort";
+
+  _ProcessRun(String path, List<String> arguments, ProcessOptions options) {
+    var stdoutEncoding = Encoding.UTF_8;
+    var stderrEncoding = Encoding.UTF_8;
+    if (options !== null) {
+      if (options.stdoutEncoding !== null) {
+        stdoutEncoding = options.stdoutEncoding;
+        if (stdoutEncoding is !Encoding) {
+          throw new IllegalArgumentException(
+              'stdoutEncoding option is not an encoding: $stdoutEncoding');
+        }
+      }
+      if (options.stderrEncoding !== null) {
+        stderrEncoding = options.stderrEncoding;
+        if (stderrEncoding is !Encoding) {
+          throw new IllegalArgumentException(
+              'stderrEncoding option is not an encoding: $stderrEncoding');
+        }
+      }
+    }
+    // Fails for unsupported encodings before the process is started.
+    var stdoutDecoder = _StringDecoders.decoder(stdoutEncoding);
+    var stderrDecoder = _StringDecoders.decoder(stderrEncoding);
+    var timeout = _checkTimeout(options);
+    var maxOutputBytes = _checkMaxOutputBytes(options);
+    // Validates the command line the same way as Process.start.
+    var process = new _Process._unstarted();
+    process._setOptions(path, arguments, options);
+
+    List request = new List(7);
+    request[0] = RUN_REQUEST;
+    request[1] = process._path;
+    request[2] = process._arguments;
+    request[3] = process._workingDirectory;
+    request[4] = process._environment;
+    request[5] = (maxOutputBytes === null) ? -1 : maxOutputBytes;
+    request[6] = (timeout === null) ? -1 : timeout;
+    _result = _newServicePort().call(request).transform((response) {
+      if (response is !List || response[0] != SUCCESS_RESPONSE) {
+        throw _exceptionFromResponse(response);
+      }
+      String decode(_StringDecoder decoder, List<int> bytes) {
+        decoder.write(bytes);
+        var decoded = decoder.decoded;
+        return (decoded === null) ? "" : decoded;
+      }
+      return new _ProcessResult(
+          response[RESPONSE_EXIT_CODE],
+          decode(stdoutDecoder, response[RESPONSE_STDOUT]),
+          decode(stderrDecoder, response[RESPONSE_STDERR]),
+          response[RESPONSE_TIMED_OUT],
+          response[RESPONSE_TRUNCATED],
+          response[RESPONSE_USER_TIME],
+          response[RESPONSE_SYSTEM_TIME],
+          response[RESPONSE_MAX_RSS]);
+    });
+  }
+
+  Exception _exceptionFromResponse(response) {
+    if (response is List && response[0] == OSERROR_RESPONSE) {
+      return new ProcessException(response[2], response[1]);
+    }
+    if (response is List && response[0] == ILLEGAL_ARGUMENT_RESPONSE) {
+      return new IllegalArgumentException();
+    }
+    return new ProcessException("Internal error");
+  }
+
+  Future<ProcessResult> _result;
 }
 
 
 class _ProcessResult implements ProcessResult {
   const _ProcessResult(int this.exitCode,
                        String this.stdout,
-                       String this.stderr);
+                       String this.stderr,
+                       bool this.timedOut,
+                       [bool this.outputTruncated = false,
+                        int this.userTime,
+                        int this.systemTime,
+                        int this.maxResidentSetSize]);
 
   final int exitCode;
   final String stdout;
   final String stderr;
+  final bool timedOut;
+  final bool outputTruncated;
+  final int userTime;
+  final int systemTime;
+  final int maxResidentSetSize;
 }
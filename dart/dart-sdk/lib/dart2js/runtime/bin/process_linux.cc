@@ -7,16 +7,35 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "bin/directory.h"
 #include "bin/fdutils.h"
+#include "bin/hashmap.h"
 #include "bin/thread.h"
 
+extern char** environ;
+
+
+// Older C library headers do not define the system call numbers. They
+// are the same on all architectures.
+#if !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434
+#endif
+#if !defined(SYS_pidfd_send_signal)
+#define SYS_pidfd_send_signal 424
+#endif
 
 // ProcessInfo is used to map a process id to the file descriptor for
 // the pipe used to communicate the exit code of the process to Dart.
@@ -47,8 +66,11 @@ class ProcessInfo {
 // started from Dart.
 class ProcessInfoList {
  public:
-  static void AddProcess(pid_t pid, intptr_t fd) {
-    MutexLocker locker(&mutex_);
+  // Adds a process. The caller must hold the mutex returned by
+  // mutex(). Taking it before the process is spawned ensures that the
+  // exit code handler does not look up the process before it has been
+  // added.
+  static void AddProcessLocked(pid_t pid, intptr_t fd) {
     ProcessInfo* info = new ProcessInfo(pid, fd);
     info->set_next(active_processes_);
     active_processes_ = info;
@@ -68,6 +90,9 @@ class ProcessInfoList {
   }
 
 
+  static dart::Mutex* mutex() { return &mutex_; }
+
+
   static void RemoveProcess(pid_t pid) {
     MutexLocker locker(&mutex_);
     ProcessInfo* prev = NULL;
@@ -257,6 +282,78 @@ bool ExitCodeHandler::thread_terminated_ = false;
 dart::Monitor ExitCodeHandler::thread_terminate_monitor_;
 
 
+// The exit of a started process is observed through a process
+// descriptor, which needs Linux 5.3. Without process descriptors the
+// exit code handler reaps the processes on SIGCHLD and writes their
+// exit codes to pipes instead. The process descriptors of processes
+// started from Dart are mapped to their pids until the event handler
+// takes them over, as it reaps the processes by pid.
+class ProcessDescriptors {
+ public:
+  static bool IsSupported();
+  static void Add(intptr_t pidfd, pid_t pid);
+  static pid_t Take(intptr_t pidfd);
+
+ private:
+  static void* GetHashmapKeyFromFd(intptr_t fd) {
+    // The hashmap does not support keys with value 0.
+    return reinterpret_cast<void*>(fd + 1);
+  }
+  static uint32_t GetHashmapHashFromFd(intptr_t fd) {
+    return static_cast<uint32_t>(fd);
+  }
+
+  // -1 until the support has been probed.
+  static int supported_;
+  static HashMap* pids_;
+  static dart::Mutex mutex_;
+};
+
+
+int ProcessDescriptors::supported_ = -1;
+HashMap* ProcessDescriptors::pids_ = NULL;
+dart::Mutex ProcessDescriptors::mutex_;
+
+
+bool ProcessDescriptors::IsSupported() {
+  MutexLocker locker(&mutex_);
+  if (supported_ == -1) {
+    int fd = syscall(SYS_pidfd_open, getpid(), 0);
+    if (fd != -1) {
+      TEMP_FAILURE_RETRY(close(fd));
+      supported_ = 1;
+    } else {
+      // Some sandboxes deny unknown system calls with EPERM.
+      supported_ = (errno == ENOSYS || errno == EPERM) ? 0 : 1;
+    }
+  }
+  return supported_ == 1;
+}
+
+
+void ProcessDescriptors::Add(intptr_t pidfd, pid_t pid) {
+  MutexLocker locker(&mutex_);
+  if (pids_ == NULL) {
+    pids_ = new HashMap(&HashMap::SamePointerValue, 16);
+  }
+  HashMap::Entry* entry = pids_->Lookup(
+      GetHashmapKeyFromFd(pidfd), GetHashmapHashFromFd(pidfd), true);
+  entry->value = reinterpret_cast<void*>(static_cast<intptr_t>(pid));
+}
+
+
+pid_t ProcessDescriptors::Take(intptr_t pidfd) {
+  MutexLocker locker(&mutex_);
+  if (pids_ == NULL) return 0;
+  HashMap::Entry* entry = pids_->Lookup(
+      GetHashmapKeyFromFd(pidfd), GetHashmapHashFromFd(pidfd), false);
+  if (entry == NULL) return 0;
+  pid_t pid = static_cast<pid_t>(reinterpret_cast<intptr_t>(entry->value));
+  pids_->Remove(GetHashmapKeyFromFd(pidfd), GetHashmapHashFromFd(pidfd));
+  return pid;
+}
+
+
 static char* SafeStrNCpy(char* dest, const char* src, size_t n) {
   strncpy(dest, src, n);
   dest[n - 1] = '\0';
@@ -285,21 +382,985 @@ static void SigChldHandler(int process_signal, siginfo_t* siginfo, void* tmp) {
 }
 
 
-static void ReportChildError(int exec_control_fd) {
-  // In the case of failure in the child process write the errno and
-  // the OS error message to the exec control pipe and exit.
-  int child_errno = errno;
-  char* os_error_message = strerror(errno);
-  ASSERT(sizeof(child_errno) == sizeof(errno));
-  int bytes_written =
-      FDUtils::WriteToBlocking(
-          exec_control_fd, &child_errno, sizeof(child_errno));
-  if (bytes_written == sizeof(child_errno)) {
-    FDUtils::WriteToBlocking(
-        exec_control_fd, os_error_message, strlen(os_error_message) + 1);
+static void ClosePipe(int fds[2]) {
+  if (fds[0] != -1) TEMP_FAILURE_RETRY(close(fds[0]));
+  if (fds[1] != -1) TEMP_FAILURE_RETRY(close(fds[1]));
+}
+
+
+// Spawns the program with the arguments and, if not NULL, the
+// environment. Without an environment the program is looked up in
+// the PATH.
+static int Spawn(pid_t* pid,
+                 const char* path,
+                 posix_spawn_file_actions_t* actions,
+                 char* arguments[],
+                 char* environment[]) {
+  if (environment != NULL) {
+    return posix_spawn(pid, path, actions, NULL, arguments, environment);
+  }
+  return posix_spawnp(pid, path, actions, NULL, arguments, environ);
+}
+
+
+// Creates a pipe for a stdio stream of a child process. Both ends are
+// closed on exec, which dup2 clears for the copy the child uses, so
+// no other end survives the exec. The end kept by the parent is made
+// non-blocking. A new pipe has no other status flags so they are set
+// without reading them first. Returns 0 or an errno value.
+static int CreateStdioPipe(int fds[2], int parent_end) {
+  if (TEMP_FAILURE_RETRY(pipe2(fds, O_CLOEXEC)) == -1) {
+    return errno;
+  }
+  if (TEMP_FAILURE_RETRY(fcntl(fds[parent_end], F_SETFL, O_NONBLOCK)) == -1) {
+    int error = errno;
+    ClosePipe(fds);
+    fds[0] = fds[1] = -1;
+    return error;
+  }
+  return 0;
+}
+
+
+// Adds the file action connecting the stdio descriptor fd of the
+// child as given by mode. child_fd is the end of the pipe used by the
+// child for kStdioPipe. Returns 0 or an errno value.
+static int AddStdioAction(posix_spawn_file_actions_t* actions,
+                          int fd,
+                          Process::StdioMode mode,
+                          int child_fd) {
+  switch (mode) {
+    case Process::kStdioPipe:
+      return posix_spawn_file_actions_adddup2(actions, child_fd, fd);
+    case Process::kStdioNull:
+      return posix_spawn_file_actions_addopen(
+          actions,
+          fd,
+          "/dev/null",
+          (fd == STDIN_FILENO) ? O_RDONLY : O_WRONLY,
+          0);
+    case Process::kStdioMergeStdout:
+      // Added after the action for stdout so stderr goes wherever
+      // stdout goes.
+      ASSERT(fd == STDERR_FILENO);
+      return posix_spawn_file_actions_adddup2(actions, STDOUT_FILENO, fd);
+    default:
+      ASSERT(mode == Process::kStdioInherit);
+      return 0;
+  }
+}
+
+
+// Creates the pipes for the stdio streams of a child process which
+// are piped to Dart. The pipes of the other streams are left as
+// { -1, -1 }. Returns 0 or an errno value, in which case no pipe is
+// left open.
+static int CreateStdioPipes(Process::StdioMode stdin_mode,
+                            Process::StdioMode stdout_mode,
+                            Process::StdioMode stderr_mode,
+                            int write_out[2],
+                            int read_in[2],
+                            int read_err[2]) {
+  int result = 0;
+  if (stdout_mode == Process::kStdioPipe) {
+    result = CreateStdioPipe(read_in, 0);
+  }
+  if (result == 0 && stderr_mode == Process::kStdioPipe) {
+    result = CreateStdioPipe(read_err, 0);
+  }
+  if (result == 0 && stdin_mode == Process::kStdioPipe) {
+    result = CreateStdioPipe(write_out, 1);
+  }
+  if (result != 0) {
+    ClosePipe(read_in);
+    ClosePipe(read_err);
+    ClosePipe(write_out);
+  }
+  return result;
+}
+
+
+// The process zygote is a small helper process forked from the VM at
+// startup, before the VM has threads or a large heap. It starts the
+// processes for Process::Start on request over a Unix socket so the
+// cost of starting a process does not depend on the size of the VM
+// process. The zygote clones the processes with CLONE_PARENT, which
+// makes them children of the VM. The VM reaps them through their
+// process descriptors like the processes it starts itself.
+//
+// The zygote can also keep a pool of processes for a command line
+// started ahead of time. A start request with the same command line,
+// working directory, environment and stdio modes gets one of them and
+// the zygote starts a replacement.
+class ProcessZygote {
+ public:
+  // Forks the zygote. Must be called while the VM process has a
+  // single thread. Returns false if the zygote could not be started.
+  static bool Start();
+
+  static bool IsRunning() { return socket_ != -1; }
+
+  // Asks the zygote to start a process as Process::Start does and
+  // sets result to what Process::Start returns. Returns false if the
+  // zygote could not be asked, e.g. because the request is too large,
+  // in which case the caller has to start the process itself.
+  static bool StartProcess(const char* path,
+                           char* arguments[],
+                           intptr_t arguments_length,
+                           const char* working_directory,
+                           char* environment[],
+                           intptr_t environment_length,
+                           Process::StdioMode stdin_mode,
+                           Process::StdioMode stdout_mode,
+                           Process::StdioMode stderr_mode,
+                           intptr_t* in,
+                           intptr_t* out,
+                           intptr_t* err,
+                           intptr_t* id,
+                           intptr_t* exit_event,
+                           char* os_error_message,
+                           int os_error_message_len,
+                           int* result);
+
+  // Asks the zygote to keep count processes for the command line
+  // started ahead of time. Lowering the count does not stop processes
+  // already started. Returns 0 or an errno value.
+  static int KeepWarm(const char* path,
+                      char* arguments[],
+                      intptr_t arguments_length,
+                      const char* working_directory,
+                      char* environment[],
+                      intptr_t environment_length,
+                      Process::StdioMode stdin_mode,
+                      Process::StdioMode stdout_mode,
+                      Process::StdioMode stderr_mode,
+                      intptr_t count,
+                      char* os_error_message,
+                      int os_error_message_len);
+
+ private:
+  enum RequestType {
+    kStartRequest = 0,
+    kKeepWarmRequest = 1
+  };
+
+  // Indices of the file descriptors of a response.
+  enum ResponseFd {
+    kInFd = 0,
+    kOutFd = 1,
+    kErrFd = 2,
+    kExitFd = 3,
+    kResponseFds = 4
+  };
+
+  static const int kMaxErrorMessageLength = 256;
+
+  // A response of the zygote. The file descriptors which are not -1
+  // are sent along with the response in order. The process
+  // descriptor is also sent if starting the process failed after it
+  // was cloned so the VM can reap it.
+  struct Response {
+    int32_t result;
+    int32_t pid;
+    int32_t fds[kResponseFds];
+    char message[kMaxErrorMessageLength];
+  };
+
+  class Request;
+  class CommandLine;
+  class WarmPool;
+
+  static int SendRequest(int type,
+                         intptr_t count,
+                         const char* path,
+                         char* arguments[],
+                         intptr_t arguments_length,
+                         const char* working_directory,
+                         char* environment[],
+                         intptr_t environment_length,
+                         Process::StdioMode stdin_mode,
+                         Process::StdioMode stdout_mode,
+                         Process::StdioMode stderr_mode,
+                         Response* response);
+  static bool ReceiveResponse(int socket, Response* response);
+
+  // Run in the zygote process.
+  static void Run(int socket);
+  static void SendResponse(int socket, Response* response);
+  static void StartChild(CommandLine* command_line, Response* response);
+  static void ExecChild(CommandLine* command_line,
+                        int stdio_fds[3],
+                        int exec_control_fd);
+
+  // Socket connected to the zygote or -1 if it is not running.
+  static int socket_;
+  // Held while sending a request and when closing the socket.
+  static dart::Mutex mutex_;
+
+  DISALLOW_ALLOCATION();
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ProcessZygote);
+};
+
+
+int ProcessZygote::socket_ = -1;
+dart::Mutex ProcessZygote::mutex_;
+
+
+// A request to the zygote. It holds the request type and a count
+// followed by the command line. Integers are stored in host byte
+// order. Strings are stored with their length, or -1 for NULL,
+// followed by their characters and the terminating NUL so they can
+// be used in place.
+class ProcessZygote::Request {
+ public:
+  // Offset of the command line, which identifies a pool of processes.
+  static const intptr_t kCommandLineOffset = 2 * sizeof(int32_t);
+
+  Request() : buffer_(NULL), length_(0), capacity_(0), position_(0) { }
+  ~Request() { free(buffer_); }
+
+  void WriteInt(int32_t value) { Append(&value, sizeof(value)); }
+
+  void WriteString(const char* value) {
+    if (value == NULL) {
+      WriteInt(-1);
+      return;
+    }
+    int32_t length = strlen(value);
+    WriteInt(length);
+    Append(value, length + 1);
+  }
+
+  bool ReadInt(int32_t* value) {
+    if (position_ + static_cast<intptr_t>(sizeof(*value)) > length_) {
+      return false;
+    }
+    memmove(value, buffer_ + position_, sizeof(*value));
+    position_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadString(const char** value) {
+    int32_t length;
+    if (!ReadInt(&length)) return false;
+    if (length == -1) {
+      *value = NULL;
+      return true;
+    }
+    if (length < 0 ||
+        position_ + length + 1 > length_ ||
+        buffer_[position_ + length] != '\0') {
+      return false;
+    }
+    *value = buffer_ + position_;
+    position_ += length + 1;
+    return true;
+  }
+
+  // The socket is a sequenced packet socket so a request is sent and
+  // received as a whole. The request carries the socket the response
+  // is sent on, so requests from several threads can be in flight at
+  // the same time. Sending fails with EMSGSIZE if the request does not
+  // fit into the socket buffer.
+  bool Send(int socket, int reply_socket) {
+    char control[CMSG_SPACE(sizeof(reply_socket))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov;
+    iov.iov_base = buffer_;
+    iov.iov_len = length_;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(reply_socket));
+    memmove(CMSG_DATA(header), &reply_socket, sizeof(reply_socket));
+    ssize_t sent =
+        TEMP_FAILURE_RETRY(sendmsg(socket, &message, MSG_NOSIGNAL));
+    return sent == length_;
+  }
+
+  // Returns false if the socket has been closed. Sets reply_socket to
+  // -1 if the request did not carry a reply socket.
+  bool Receive(int socket, int* reply_socket) {
+    ssize_t size =
+        TEMP_FAILURE_RETRY(recv(socket, NULL, 0, MSG_PEEK | MSG_TRUNC));
+    if (size <= 0) return false;
+    length_ = 0;
+    position_ = 0;
+    Reserve(size);
+    char control[CMSG_SPACE(sizeof(*reply_socket))];
+    struct iovec iov;
+    iov.iov_base = buffer_;
+    iov.iov_len = size;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t received =
+        TEMP_FAILURE_RETRY(recvmsg(socket, &message, MSG_CMSG_CLOEXEC));
+    if (received != size) return false;
+    length_ = size;
+    *reply_socket = -1;
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (header != NULL &&
+        header->cmsg_level == SOL_SOCKET &&
+        header->cmsg_type == SCM_RIGHTS &&
+        header->cmsg_len == CMSG_LEN(sizeof(*reply_socket))) {
+      memmove(reply_socket, CMSG_DATA(header), sizeof(*reply_socket));
+    }
+    return true;
+  }
+
+  bool HasCommandLine(Request* other) {
+    return (length_ == other->length_) &&
+        (memcmp(buffer_ + kCommandLineOffset,
+                other->buffer_ + kCommandLineOffset,
+                length_ - kCommandLineOffset) == 0);
+  }
+
+  intptr_t length() { return length_; }
+  void set_position(intptr_t position) { position_ = position; }
+
+ private:
+  void Reserve(intptr_t capacity) {
+    if (capacity <= capacity_) return;
+    capacity_ = (capacity_ == 0) ? 1 * KB : capacity_;
+    while (capacity_ < capacity) capacity_ *= 2;
+    buffer_ = reinterpret_cast<char*>(realloc(buffer_, capacity_));
+  }
+
+  void Append(const void* data, intptr_t length) {
+    Reserve(length_ + length);
+    memmove(buffer_ + length_, data, length);
+    length_ += length;
+  }
+
+  char* buffer_;
+  intptr_t length_;
+  intptr_t capacity_;
+  intptr_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(Request);
+};
+
+
+// A command line read from a request. The strings point into the
+// request.
+class ProcessZygote::CommandLine {
+ public:
+  CommandLine()
+      : working_directory(NULL),
+        path(NULL),
+        arguments(NULL),
+        environment(NULL) { }
+  ~CommandLine() {
+    delete[] arguments;
+    delete[] environment;
+  }
+
+  bool Parse(Request* request);
+
+  int32_t stdin_mode;
+  int32_t stdout_mode;
+  int32_t stderr_mode;
+  const char* working_directory;
+  const char* path;
+  // The arguments start with the path and end with NULL like the
+  // environment. The environment is NULL if it is inherited.
+  char** arguments;
+  char** environment;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CommandLine);
+};
+
+
+bool ProcessZygote::CommandLine::Parse(Request* request) {
+  request->set_position(Request::kCommandLineOffset);
+  int32_t arguments_length;
+  if (!request->ReadInt(&stdin_mode) ||
+      !request->ReadInt(&stdout_mode) ||
+      !request->ReadInt(&stderr_mode) ||
+      !request->ReadString(&working_directory) ||
+      !request->ReadString(&path) ||
+      path == NULL ||
+      !request->ReadInt(&arguments_length) ||
+      arguments_length < 0 ||
+      arguments_length > request->length()) {
+    return false;
+  }
+  arguments = new char*[arguments_length + 2];
+  arguments[0] = const_cast<char*>(path);
+  for (intptr_t i = 0; i < arguments_length; i++) {
+    const char* argument;
+    if (!request->ReadString(&argument) || argument == NULL) return false;
+    arguments[i + 1] = const_cast<char*>(argument);
+  }
+  arguments[arguments_length + 1] = NULL;
+  int32_t environment_length;
+  if (!request->ReadInt(&environment_length) ||
+      environment_length > request->length()) {
+    return false;
+  }
+  if (environment_length >= 0) {
+    environment = new char*[environment_length + 1];
+    for (intptr_t i = 0; i < environment_length; i++) {
+      const char* variable;
+      if (!request->ReadString(&variable) || variable == NULL) return false;
+      environment[i] = const_cast<char*>(variable);
+    }
+    environment[environment_length] = NULL;
+  }
+  return true;
+}
+
+
+// The processes kept started ahead of time for a command line.
+class ProcessZygote::WarmPool {
+ public:
+  // The pool takes ownership of the request.
+  explicit WarmPool(Request* request)
+      : request_(request),
+        target_(0),
+        count_(0),
+        failed_(false),
+        processes_(NULL),
+        next_(NULL) {
+    bool parsed = command_line_.Parse(request);
+    ASSERT(parsed);
+  }
+
+  Request* request() { return request_; }
+  void set_target(intptr_t target) { target_ = target; }
+  WarmPool* next() { return next_; }
+  void set_next(WarmPool* next) { next_ = next; }
+
+  // Takes a process out of the pool. Returns false if it is empty.
+  bool Take(Response* response) {
+    if (processes_ == NULL) return false;
+    WarmProcess* process = processes_;
+    processes_ = process->next;
+    count_--;
+    *response = process->response;
+    delete process;
+    // Later processes would fail to start the same way, so a failure
+    // is reported once and the pool is not filled again.
+    if (response->result != 0) {
+      target_ = 0;
+      failed_ = false;
+    }
+    return true;
+  }
+
+  // Whether the pool has fewer than the target number of processes.
+  // No more processes are started while a failure is in the pool.
+  bool NeedsProcess() { return count_ < target_ && !failed_; }
+
+  // Starts one process for the pool. A failure to start a process is
+  // kept in the pool like a process, so it is reported to the start
+  // request which takes it.
+  void StartProcess() {
+    WarmProcess* process = new WarmProcess();
+    StartChild(&command_line_, &process->response);
+    process->next = processes_;
+    processes_ = process;
+    count_++;
+    if (process->response.result != 0) {
+      failed_ = true;
+    }
+  }
+
+ private:
+  struct WarmProcess {
+    Response response;
+    WarmProcess* next;
+  };
+
+  Request* request_;
+  CommandLine command_line_;
+  intptr_t target_;
+  intptr_t count_;
+  bool failed_;
+  WarmProcess* processes_;
+  WarmPool* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(WarmPool);
+};
+
+
+bool ProcessZygote::Start() {
+  int fds[2];
+  int result = TEMP_FAILURE_RETRY(
+      socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds));
+  if (result == -1) {
+    return false;
+  }
+  pid_t pid = TEMP_FAILURE_RETRY(fork());
+  if (pid == -1) {
+    ClosePipe(fds);
+    return false;
+  }
+  if (pid == 0) {
+    TEMP_FAILURE_RETRY(close(fds[0]));
+    Run(fds[1]);
+  }
+  TEMP_FAILURE_RETRY(close(fds[1]));
+  socket_ = fds[0];
+  return true;
+}
+
+
+bool ProcessZygote::StartProcess(const char* path,
+                                 char* arguments[],
+                                 intptr_t arguments_length,
+                                 const char* working_directory,
+                                 char* environment[],
+                                 intptr_t environment_length,
+                                 Process::StdioMode stdin_mode,
+                                 Process::StdioMode stdout_mode,
+                                 Process::StdioMode stderr_mode,
+                                 intptr_t* in,
+                                 intptr_t* out,
+                                 intptr_t* err,
+                                 intptr_t* id,
+                                 intptr_t* exit_event,
+                                 char* os_error_message,
+                                 int os_error_message_len,
+                                 int* result) {
+  Response response;
+  if (SendRequest(kStartRequest, 0, path, arguments, arguments_length,
+                  working_directory, environment, environment_length,
+                  stdin_mode, stdout_mode, stderr_mode, &response) != 0) {
+    return false;
+  }
+  *result = response.result;
+  if (response.result != 0) {
+    // A process which failed to exec has exited, or been killed, and
+    // is a child of the VM which has to be reaped.
+    if (response.pid > 0) {
+      TEMP_FAILURE_RETRY(waitpid(response.pid, NULL, 0));
+    }
+    if (response.fds[kExitFd] != -1) {
+      TEMP_FAILURE_RETRY(close(response.fds[kExitFd]));
+    }
+    SafeStrNCpy(os_error_message, response.message, os_error_message_len);
+    return true;
+  }
+  *in = response.fds[kInFd];
+  *out = response.fds[kOutFd];
+  *err = response.fds[kErrFd];
+  *exit_event = response.fds[kExitFd];
+  *id = response.pid;
+  ProcessDescriptors::Add(response.fds[kExitFd], response.pid);
+  return true;
+}
+
+
+int ProcessZygote::KeepWarm(const char* path,
+                            char* arguments[],
+                            intptr_t arguments_length,
+                            const char* working_directory,
+                            char* environment[],
+                            intptr_t environment_length,
+                            Process::StdioMode stdin_mode,
+                            Process::StdioMode stdout_mode,
+                            Process::StdioMode stderr_mode,
+                            intptr_t count,
+                            char* os_error_message,
+                            int os_error_message_len) {
+  Response response;
+  int result = SendRequest(kKeepWarmRequest, count, path, arguments,
+                           arguments_length, working_directory, environment,
+                           environment_length, stdin_mode, stdout_mode,
+                           stderr_mode, &response);
+  if (result != 0) {
+    errno = result;
+    SetChildOsErrorMessage(os_error_message, os_error_message_len);
+    return result;
+  }
+  if (response.result != 0) {
+    SafeStrNCpy(os_error_message, response.message, os_error_message_len);
+  }
+  return response.result;
+}
+
+
+// Sends a request and waits for the response. Returns 0 or an errno
+// value if the request could not be sent or the zygote is gone.
+int ProcessZygote::SendRequest(int type,
+                               intptr_t count,
+                               const char* path,
+                               char* arguments[],
+                               intptr_t arguments_length,
+                               const char* working_directory,
+                               char* environment[],
+                               intptr_t environment_length,
+                               Process::StdioMode stdin_mode,
+                               Process::StdioMode stdout_mode,
+                               Process::StdioMode stderr_mode,
+                               Response* response) {
+  // The working directory of the VM can change after the zygote has
+  // been forked so the current one is always sent.
+  char* current_directory = NULL;
+  if (working_directory == NULL) {
+    current_directory = Directory::Current();
+    if (current_directory == NULL) return errno;
+    working_directory = current_directory;
+  }
+  Request request;
+  request.WriteInt(type);
+  request.WriteInt(count);
+  request.WriteInt(stdin_mode);
+  request.WriteInt(stdout_mode);
+  request.WriteInt(stderr_mode);
+  request.WriteString(working_directory);
+  request.WriteString(path);
+  request.WriteInt(arguments_length);
+  for (intptr_t i = 0; i < arguments_length; i++) {
+    request.WriteString(arguments[i]);
+  }
+  request.WriteInt((environment == NULL) ? -1 : environment_length);
+  for (intptr_t i = 0; environment != NULL && i < environment_length; i++) {
+    request.WriteString(environment[i]);
+  }
+  free(current_directory);
+
+  // The response comes back on a socket of its own, so the lock is
+  // only held while sending and other threads can send their requests
+  // while this one waits.
+  int reply_fds[2];
+  if (TEMP_FAILURE_RETRY(socketpair(AF_UNIX,
+                                    SOCK_SEQPACKET | SOCK_CLOEXEC,
+                                    0,
+                                    reply_fds)) == -1) {
+    return errno;
+  }
+  {
+    MutexLocker locker(&mutex_);
+    if (socket_ == -1) {
+      ClosePipe(reply_fds);
+      return ECONNRESET;
+    }
+    if (!request.Send(socket_, reply_fds[1])) {
+      int error = errno;
+      ClosePipe(reply_fds);
+      if (error == EMSGSIZE) {
+        return error;
+      }
+      // The zygote is gone. The VM starts the processes itself from
+      // now on.
+      TEMP_FAILURE_RETRY(close(socket_));
+      socket_ = -1;
+      return (error != 0) ? error : ECONNRESET;
+    }
+  }
+  TEMP_FAILURE_RETRY(close(reply_fds[1]));
+  int error = 0;
+  if (!ReceiveResponse(reply_fds[0], response)) {
+    error = (errno != 0) ? errno : ECONNRESET;
+  }
+  TEMP_FAILURE_RETRY(close(reply_fds[0]));
+  return error;
+}
+
+
+bool ProcessZygote::ReceiveResponse(int socket, Response* response) {
+  int fds[kResponseFds];
+  char control[CMSG_SPACE(sizeof(fds))];
+  struct iovec iov;
+  iov.iov_base = response;
+  iov.iov_len = sizeof(*response);
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  errno = 0;
+  ssize_t received =
+      TEMP_FAILURE_RETRY(recvmsg(socket, &message, MSG_CMSG_CLOEXEC));
+  if (received != sizeof(*response)) {
+    return false;
+  }
+  intptr_t fd_count = 0;
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (header != NULL &&
+      header->cmsg_level == SOL_SOCKET &&
+      header->cmsg_type == SCM_RIGHTS) {
+    fd_count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (fd_count > kResponseFds) fd_count = 0;
+    memmove(fds, CMSG_DATA(header), fd_count * sizeof(int));
+  }
+  intptr_t expected_fd_count = 0;
+  for (intptr_t i = 0; i < kResponseFds; i++) {
+    if (response->fds[i] != -1) expected_fd_count++;
+  }
+  // The kernel drops descriptors which do not fit into the control
+  // buffer or the descriptor limit of the VM and sets MSG_CTRUNC.
+  if ((message.msg_flags & MSG_CTRUNC) != 0 ||
+      fd_count != expected_fd_count) {
+    for (intptr_t i = 0; i < fd_count; i++) {
+      TEMP_FAILURE_RETRY(close(fds[i]));
+    }
+    // Without its descriptors the process cannot be used. It is a
+    // child of the VM, so it is killed and reaped here.
+    if (response->pid > 0) {
+      kill(response->pid, SIGKILL);
+      TEMP_FAILURE_RETRY(waitpid(response->pid, NULL, 0));
+    }
+    errno = ((message.msg_flags & MSG_CTRUNC) != 0) ? EMFILE : EPROTO;
+    return false;
+  }
+  intptr_t next = 0;
+  for (intptr_t i = 0; i < kResponseFds; i++) {
+    if (response->fds[i] != -1) {
+      response->fds[i] = fds[next++];
+    }
+  }
+  return true;
+}
+
+
+void ProcessZygote::Run(int socket) {
+  WarmPool* pools = NULL;
+  while (true) {
+    // Warm processes are started one at a time while no request is
+    // waiting, so a request never waits for pools to be filled.
+    WarmPool* unfilled = pools;
+    while (unfilled != NULL && !unfilled->NeedsProcess()) {
+      unfilled = unfilled->next();
+    }
+    if (unfilled != NULL) {
+      struct pollfd pollfd;
+      pollfd.fd = socket;
+      pollfd.events = POLLIN;
+      pollfd.revents = 0;
+      if (TEMP_FAILURE_RETRY(poll(&pollfd, 1, 0)) == 0) {
+        unfilled->StartProcess();
+        continue;
+      }
+    }
+    Request* request = new Request();
+    int reply_socket;
+    if (!request->Receive(socket, &reply_socket)) {
+      // The VM has exited.
+      _exit(0);
+    }
+    if (reply_socket == -1) {
+      // There is nobody to respond to.
+      delete request;
+      continue;
+    }
+    Response response;
+    memset(&response, 0, sizeof(response));
+    for (intptr_t i = 0; i < kResponseFds; i++) {
+      response.fds[i] = -1;
+    }
+    int32_t type;
+    int32_t count;
+    CommandLine command_line;
+    if (!request->ReadInt(&type) ||
+        !request->ReadInt(&count) ||
+        !command_line.Parse(request)) {
+      response.result = EINVAL;
+      SafeStrNCpy(response.message, strerror(EINVAL), kMaxErrorMessageLength);
+      SendResponse(reply_socket, &response);
+      TEMP_FAILURE_RETRY(close(reply_socket));
+      delete request;
+      continue;
+    }
+    WarmPool* pool = pools;
+    while (pool != NULL && !pool->request()->HasCommandLine(request)) {
+      pool = pool->next();
+    }
+    if (type == kKeepWarmRequest) {
+      if (pool == NULL) {
+        pool = new WarmPool(request);
+        pool->set_next(pools);
+        pools = pool;
+        request = NULL;
+      }
+      pool->set_target(count);
+    } else if (pool == NULL || !pool->Take(&response)) {
+      StartChild(&command_line, &response);
+    }
+    SendResponse(reply_socket, &response);
+    TEMP_FAILURE_RETRY(close(reply_socket));
+    delete request;
+  }
+}
+
+
+void ProcessZygote::SendResponse(int socket, Response* response) {
+  int fds[kResponseFds];
+  intptr_t fd_count = 0;
+  for (intptr_t i = 0; i < kResponseFds; i++) {
+    if (response->fds[i] != -1) {
+      fds[fd_count++] = response->fds[i];
+    }
+  }
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov;
+  iov.iov_base = response;
+  iov.iov_len = sizeof(*response);
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  if (fd_count > 0) {
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+    memmove(CMSG_DATA(header), fds, fd_count * sizeof(int));
+  }
+  // If sending fails the VM has exited, which the next receive sees.
+  TEMP_FAILURE_RETRY(sendmsg(socket, &message, MSG_NOSIGNAL));
+  for (intptr_t i = 0; i < fd_count; i++) {
+    TEMP_FAILURE_RETRY(close(fds[i]));
+  }
+}
+
+
+void ProcessZygote::StartChild(CommandLine* command_line,
+                               Response* response) {
+  memset(response, 0, sizeof(*response));
+  for (intptr_t i = 0; i < kResponseFds; i++) {
+    response->fds[i] = -1;
   }
-  TEMP_FAILURE_RETRY(close(exec_control_fd));
-  exit(1);
+  int read_in[2] = { -1, -1 };  // Pipe for stdout to child process.
+  int read_err[2] = { -1, -1 };  // Pipe for stderr to child process.
+  int write_out[2] = { -1, -1 };  // Pipe for stdin to child process.
+  int exec_control[2] = { -1, -1 };  // Pipe to get the result from exec.
+  int result = CreateStdioPipes(
+      static_cast<Process::StdioMode>(command_line->stdin_mode),
+      static_cast<Process::StdioMode>(command_line->stdout_mode),
+      static_cast<Process::StdioMode>(command_line->stderr_mode),
+      write_out,
+      read_in,
+      read_err);
+  if (result == 0 &&
+      TEMP_FAILURE_RETRY(pipe2(exec_control, O_CLOEXEC)) == -1) {
+    result = errno;
+    ClosePipe(read_in);
+    ClosePipe(read_err);
+    ClosePipe(write_out);
+  }
+  if (result != 0) {
+    response->result = result;
+    SafeStrNCpy(response->message, strerror(result), kMaxErrorMessageLength);
+    return;
+  }
+
+  // The zygote has a single thread and a small heap so the clone is
+  // cheap. With CLONE_PARENT the child is a child of the VM.
+  pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+  if (pid == 0) {
+    int stdio_fds[3] = { write_out[0], read_in[1], read_err[1] };
+    ExecChild(command_line, stdio_fds, exec_control[1]);
+  }
+  if (pid == -1) {
+    result = errno;
+  }
+  if (read_in[1] != -1) TEMP_FAILURE_RETRY(close(read_in[1]));
+  if (read_err[1] != -1) TEMP_FAILURE_RETRY(close(read_err[1]));
+  if (write_out[0] != -1) TEMP_FAILURE_RETRY(close(write_out[0]));
+  TEMP_FAILURE_RETRY(close(exec_control[1]));
+
+  if (pid > 0) {
+    // The exec control pipe is closed by a successful exec. Otherwise
+    // the child writes the errno before it exits.
+    int child_errno;
+    ssize_t bytes_read = TEMP_FAILURE_RETRY(
+        read(exec_control[0], &child_errno, sizeof(child_errno)));
+    if (bytes_read == sizeof(child_errno)) {
+      result = child_errno;
+    }
+    // The VM does not reap the child before it has got the process
+    // descriptor so the pid cannot have been reused.
+    response->pid = pid;
+    response->fds[kExitFd] = syscall(SYS_pidfd_open, pid, 0);
+    if (response->fds[kExitFd] == -1 && result == 0) {
+      result = errno;
+      kill(pid, SIGKILL);
+    }
+  }
+  TEMP_FAILURE_RETRY(close(exec_control[0]));
+
+  response->result = result;
+  if (result != 0) {
+    if (read_in[0] != -1) TEMP_FAILURE_RETRY(close(read_in[0]));
+    if (read_err[0] != -1) TEMP_FAILURE_RETRY(close(read_err[0]));
+    if (write_out[1] != -1) TEMP_FAILURE_RETRY(close(write_out[1]));
+    SafeStrNCpy(response->message, strerror(result), kMaxErrorMessageLength);
+    return;
+  }
+  response->fds[kInFd] = read_in[0];
+  response->fds[kOutFd] = write_out[1];
+  response->fds[kErrFd] = read_err[0];
+}
+
+
+// Connects the stdio descriptor fd of a child started by the zygote
+// as given by mode. pipe_fd is the end of the pipe used by the child
+// for kStdioPipe. Returns -1 on failure.
+static int SetupChildStdio(int fd, int32_t mode, int pipe_fd) {
+  switch (mode) {
+    case Process::kStdioPipe:
+      // dup2 does not clear close-on-exec if the descriptors are the
+      // same.
+      if (pipe_fd == fd) return TEMP_FAILURE_RETRY(fcntl(fd, F_SETFD, 0));
+      return TEMP_FAILURE_RETRY(dup2(pipe_fd, fd));
+    case Process::kStdioNull: {
+      int null_fd = TEMP_FAILURE_RETRY(
+          open("/dev/null", (fd == STDIN_FILENO) ? O_RDONLY : O_WRONLY));
+      if (null_fd == -1) return -1;
+      int result = TEMP_FAILURE_RETRY(dup2(null_fd, fd));
+      TEMP_FAILURE_RETRY(close(null_fd));
+      return result;
+    }
+    case Process::kStdioMergeStdout:
+      return TEMP_FAILURE_RETRY(dup2(STDOUT_FILENO, fd));
+    default:
+      return 0;
+  }
+}
+
+
+void ProcessZygote::ExecChild(CommandLine* command_line,
+                              int stdio_fds[3],
+                              int exec_control_fd) {
+  if (SetupChildStdio(
+          STDIN_FILENO, command_line->stdin_mode, stdio_fds[0]) != -1 &&
+      SetupChildStdio(
+          STDOUT_FILENO, command_line->stdout_mode, stdio_fds[1]) != -1 &&
+      SetupChildStdio(
+          STDERR_FILENO, command_line->stderr_mode, stdio_fds[2]) != -1 &&
+      (command_line->working_directory == NULL ||
+       TEMP_FAILURE_RETRY(chdir(command_line->working_directory)) != -1)) {
+    if (command_line->environment != NULL) {
+      TEMP_FAILURE_RETRY(execve(command_line->path,
+                                command_line->arguments,
+                                command_line->environment));
+    } else {
+      TEMP_FAILURE_RETRY(execvp(command_line->path,
+                                command_line->arguments));
+    }
+  }
+  int child_errno = errno;
+  TEMP_FAILURE_RETRY(
+      write(exec_control_fd, &child_errno, sizeof(child_errno)));
+  _exit(1);
 }
 
 
@@ -309,6 +1370,9 @@ int Process::Start(const char* path,
                    const char* working_directory,
                    char* environment[],
                    intptr_t environment_length,
+                   StdioMode stdin_mode,
+                   StdioMode stdout_mode,
+                   StdioMode stderr_mode,
                    intptr_t* in,
                    intptr_t* out,
                    intptr_t* err,
@@ -317,78 +1381,70 @@ int Process::Start(const char* path,
                    char* os_error_message,
                    int os_error_message_len) {
   pid_t pid;
-  int read_in[2];  // Pipe for stdout to child process.
-  int read_err[2];  // Pipe for stderr to child process.
-  int write_out[2];  // Pipe for stdin to child process.
-  int exec_control[2];  // Pipe to get the result from exec.
-  int result;
-
-  bool initialized = ExitCodeHandler::EnsureInitialized();
-  if (!initialized) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    fprintf(stderr,
-            "Error initializing exit code handler: %s\n",
-            os_error_message);
-    return errno;
+  int read_in[2] = { -1, -1 };  // Pipe for stdout to child process.
+  int read_err[2] = { -1, -1 };  // Pipe for stderr to child process.
+  int write_out[2] = { -1, -1 };  // Pipe for stdin to child process.
+  int result = 0;
+
+  if (ProcessZygote::IsRunning() &&
+      ProcessZygote::StartProcess(path,
+                                  arguments,
+                                  arguments_length,
+                                  working_directory,
+                                  environment,
+                                  environment_length,
+                                  stdin_mode,
+                                  stdout_mode,
+                                  stderr_mode,
+                                  in,
+                                  out,
+                                  err,
+                                  id,
+                                  exit_event,
+                                  os_error_message,
+                                  os_error_message_len,
+                                  &result)) {
+    return result;
   }
 
-  result = TEMP_FAILURE_RETRY(pipe(read_in));
-  if (result < 0) {
+  result = CreateStdioPipes(stdin_mode,
+                            stdout_mode,
+                            stderr_mode,
+                            write_out,
+                            read_in,
+                            read_err);
+  if (result != 0) {
+    errno = result;
     SetChildOsErrorMessage(os_error_message, os_error_message_len);
     fprintf(stderr, "Error pipe creation failed: %s\n", os_error_message);
-    return errno;
-  }
-
-  result = TEMP_FAILURE_RETRY(pipe(read_err));
-  if (result < 0) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    fprintf(stderr, "Error pipe creation failed: %s\n", os_error_message);
-    return errno;
+    return result;
   }
 
-  result = TEMP_FAILURE_RETRY(pipe(write_out));
-  if (result < 0) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    fprintf(stderr, "Error pipe creation failed: %s\n", os_error_message);
-    return errno;
-  }
-
-  result = TEMP_FAILURE_RETRY(pipe(exec_control));
-  if (result < 0) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    fprintf(stderr, "Error pipe creation failed: %s\n", os_error_message);
-    return errno;
-  }
+  // Without process descriptors the exit code of the child is written
+  // to a pipe by the exit code handler.
+  bool use_pidfd = ProcessDescriptors::IsSupported();
+  int event_fds[2] = { -1, -1 };  // Pipe for the exit code of the child.
+  if (!use_pidfd) {
+    if (!ExitCodeHandler::EnsureInitialized() ||
+        TEMP_FAILURE_RETRY(pipe2(event_fds, O_CLOEXEC)) == -1) {
+      result = errno;
+      SetChildOsErrorMessage(os_error_message, os_error_message_len);
+      ClosePipe(read_in);
+      ClosePipe(read_err);
+      ClosePipe(write_out);
+      fprintf(stderr,
+              "Error initializing exit code handler: %s\n",
+              os_error_message);
+      return result;
+    }
 
-  // Set close on exec on the write file descriptor of the exec control pipe.
-  result = TEMP_FAILURE_RETRY(
-      fcntl(exec_control[1],
-            F_SETFD,
-            TEMP_FAILURE_RETRY(fcntl(exec_control[1], F_GETFD)) | FD_CLOEXEC));
-  if (result < 0) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    TEMP_FAILURE_RETRY(close(exec_control[0]));
-    TEMP_FAILURE_RETRY(close(exec_control[1]));
-    fprintf(stderr, "fcntl failed: %s\n", os_error_message);
-    return errno;
+    struct sigaction act;
+    bzero(&act, sizeof(act));
+    act.sa_sigaction = SigChldHandler;
+    act.sa_flags = SA_NOCLDSTOP | SA_SIGINFO;
+    if (sigaction(SIGCHLD, &act, 0) != 0) {
+      perror("Process start: setting signal handler failed");
+    }
   }
 
   char** program_arguments = new char*[arguments_length + 2];
@@ -407,70 +1463,66 @@ int Process::Start(const char* path,
     program_environment[environment_length] = NULL;
   }
 
-  struct sigaction act;
-  bzero(&act, sizeof(act));
-  act.sa_sigaction = SigChldHandler;
-  act.sa_flags = SA_NOCLDSTOP | SA_SIGINFO;
-  if (sigaction(SIGCHLD, &act, 0) != 0) {
-    perror("Process start: setting signal handler failed");
-  }
-  pid = TEMP_FAILURE_RETRY(fork());
-  if (pid < 0) {
-    SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    delete[] program_arguments;
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    TEMP_FAILURE_RETRY(close(exec_control[0]));
-    TEMP_FAILURE_RETRY(close(exec_control[1]));
-    return errno;
-  } else if (pid == 0) {
-    // Wait for parent process before setting up the child process.
-    char msg;
-    int bytes_read = FDUtils::ReadFromBlocking(read_in[0], &msg, sizeof(msg));
-    if (bytes_read != sizeof(msg)) {
-      perror("Failed receiving notification message");
-      exit(1);
+  // The child gets its stdio as requested and changes to the working
+  // directory before exec.
+  posix_spawn_file_actions_t actions;
+  result = posix_spawn_file_actions_init(&actions);
+  if (result == 0) {
+    result = AddStdioAction(&actions, STDIN_FILENO, stdin_mode, write_out[0]);
+    if (result == 0) {
+      result = AddStdioAction(&actions, STDOUT_FILENO, stdout_mode, read_in[1]);
     }
-
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(exec_control[0]));
-
-    if (TEMP_FAILURE_RETRY(dup2(write_out[0], STDIN_FILENO)) == -1) {
-      ReportChildError(exec_control[1]);
+    if (result == 0) {
+      result =
+          AddStdioAction(&actions, STDERR_FILENO, stderr_mode, read_err[1]);
     }
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-
-    if (TEMP_FAILURE_RETRY(dup2(read_in[1], STDOUT_FILENO)) == -1) {
-      ReportChildError(exec_control[1]);
-    }
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-
-    if (TEMP_FAILURE_RETRY(dup2(read_err[1], STDERR_FILENO)) == -1) {
-      ReportChildError(exec_control[1]);
+    if (result == 0 && working_directory != NULL) {
+      result = posix_spawn_file_actions_addchdir_np(&actions,
+                                                    working_directory);
     }
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-
-    if (working_directory != NULL &&
-        TEMP_FAILURE_RETRY(chdir(working_directory)) == -1) {
-      ReportChildError(exec_control[1]);
+    if (result == 0) {
+      // The C library starts the child with vfork semantics so the
+      // page tables of the parent are not copied, however large its
+      // heap is. A failing exec is reported as the result, which gives
+      // the same error code and message as an exec error written back
+      // by a forked child.
+      if (use_pidfd) {
+        result = Spawn(&pid,
+                       path,
+                       &actions,
+                       program_arguments,
+                       program_environment);
+      } else {
+        // Holding the lock until the process has been added makes sure
+        // the exit code handler finds it.
+        MutexLocker locker(ProcessInfoList::mutex());
+        result = Spawn(&pid,
+                       path,
+                       &actions,
+                       program_arguments,
+                       program_environment);
+        if (result == 0) {
+          ProcessInfoList::AddProcessLocked(pid, event_fds[1]);
+        }
+      }
     }
+    posix_spawn_file_actions_destroy(&actions);
+  }
 
-    if (environment != NULL) {
-      TEMP_FAILURE_RETRY(
-          execve(path,
-                 const_cast<char* const*>(program_arguments),
-                 program_environment));
+  // With process descriptors the exit of the child is observed through
+  // a process descriptor which the event handler watches. Nothing else
+  // reaps the child, so its pid cannot have been reused before the
+  // descriptor is opened.
+  int pidfd = -1;
+  if (result == 0 && use_pidfd) {
+    pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1) {
+      result = errno;
+      kill(pid, SIGKILL);
+      TEMP_FAILURE_RETRY(waitpid(pid, NULL, 0));
     } else {
-      TEMP_FAILURE_RETRY(
-          execvp(path, const_cast<char* const*>(program_arguments)));
+      ProcessDescriptors::Add(pidfd, pid);
     }
-    ReportChildError(exec_control[1]);
   }
 
   // The arguments and environment for the spawned process are not needed
@@ -478,76 +1530,227 @@ int Process::Start(const char* path,
   delete[] program_arguments;
   delete[] program_environment;
 
-  int event_fds[2];
-  result = TEMP_FAILURE_RETRY(pipe(event_fds));
-  if (result < 0) {
+  // Return error code if any failures.
+  if (result != 0) {
+    errno = result;
     SetChildOsErrorMessage(os_error_message, os_error_message_len);
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    fprintf(stderr, "Error pipe creation failed: %s\n", os_error_message);
+    ClosePipe(read_in);
+    ClosePipe(read_err);
+    ClosePipe(write_out);
+    // A process which was not spawned was not added to the exit code
+    // handler.
+    ClosePipe(event_fds);
+    return result;
+  }
+
+  *exit_event = use_pidfd ? pidfd : event_fds[0];
+
+  // Close the ends used by the child.
+  *in = read_in[0];
+  if (read_in[1] != -1) TEMP_FAILURE_RETRY(close(read_in[1]));
+  *out = write_out[1];
+  if (write_out[0] != -1) TEMP_FAILURE_RETRY(close(write_out[0]));
+  *err = read_err[0];
+  if (read_err[1] != -1) TEMP_FAILURE_RETRY(close(read_err[1]));
+
+  *id = pid;
+  return 0;
+}
+
+
+static int64_t MonotonicMillis() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+
+// Reads the data available on the non-blocking pipe fd into output.
+// Returns false at the end of the stream or on error.
+static bool ReadOutput(intptr_t fd, ProcessOutput* output) {
+  while (true) {
+    intptr_t available;
+    uint8_t* space = output->Space(&available);
+    // Data beyond the limit is dropped.
+    uint8_t discard[4 * KB];
+    if (space == NULL) {
+      space = discard;
+      available = sizeof(discard);
+    }
+    ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, space, available));
+    if (bytes_read > 0) {
+      if (space == discard) {
+        output->MarkTruncated();
+      } else {
+        output->Commit(bytes_read);
+      }
+      continue;
+    }
+    return (bytes_read == -1) && (errno == EAGAIN);
+  }
+}
+
+
+// Waits for the process to exit and gets its exit code and resource
+// usage. The waitid system call reports the resource usage of the
+// child, which the C library wrapper does not expose.
+static int ReapProcess(pid_t pid, ProcessRunResult* result) {
+  siginfo_t info;
+  struct rusage usage;
+  memset(&info, 0, sizeof(info));
+  memset(&usage, 0, sizeof(usage));
+  if (TEMP_FAILURE_RETRY(syscall(SYS_waitid, P_PID, pid, &info,
+                                 WEXITED, &usage)) == -1) {
     return errno;
   }
+  result->set_exit_code(
+      (info.si_code == CLD_EXITED) ? info.si_status : -info.si_status);
+  result->SetUsage(
+      static_cast<int64_t>(usage.ru_utime.tv_sec) * 1000000 +
+          usage.ru_utime.tv_usec,
+      static_cast<int64_t>(usage.ru_stime.tv_sec) * 1000000 +
+          usage.ru_stime.tv_usec,
+      static_cast<int64_t>(usage.ru_maxrss) * KB);
+  return 0;
+}
 
-  ProcessInfoList::AddProcess(pid, event_fds[1]);
-  *exit_event = event_fds[0];
-  FDUtils::SetNonBlocking(event_fds[0]);
 
-  // Notify child process to start.
-  char msg = '1';
-  result = FDUtils::WriteToBlocking(read_in[1], &msg, sizeof(msg));
-  if (result != sizeof(msg)) {
-    perror("Failed sending notification message");
+// Reads the exit code of a process reaped by the exit code handler
+// from its exit code pipe. The resource usage is not known.
+static int ReadExitCode(intptr_t fd, ProcessRunResult* result) {
+  int message[2];
+  ssize_t bytes_read = FDUtils::ReadFromBlocking(fd, message, sizeof(message));
+  if (bytes_read == -1) {
+    return errno;
+  }
+  if (bytes_read != sizeof(message)) {
+    return EIO;
   }
+  result->set_exit_code((message[1] == 0) ? message[0] : -message[0]);
+  return 0;
+}
 
-  // Read exec result from child. If no data is returned the exec was
-  // successful and the exec call closed the pipe. Otherwise the errno
-  // is written to the pipe.
-  TEMP_FAILURE_RETRY(close(exec_control[1]));
-  int child_errno;
-  int bytes_read = -1;
-  ASSERT(sizeof(child_errno) == sizeof(errno));
-  bytes_read =
-      FDUtils::ReadFromBlocking(
-          exec_control[0], &child_errno, sizeof(child_errno));
-  if (bytes_read == sizeof(child_errno)) {
-      bytes_read = FDUtils::ReadFromBlocking(exec_control[0],
-                                             os_error_message,
-                                             os_error_message_len);
-      os_error_message[os_error_message_len - 1] = '\0';
+
+// Kills a process started by Process::Run.
+static void KillRunProcess(bool use_pidfd, intptr_t exit_event, pid_t pid) {
+  if (use_pidfd) {
+    // The process descriptor cannot refer to another process so the
+    // signal cannot hit the wrong one.
+    syscall(SYS_pidfd_send_signal, exit_event, SIGKILL, NULL, 0);
+  } else {
+    kill(pid, SIGKILL);
   }
-  TEMP_FAILURE_RETRY(close(exec_control[0]));
+}
 
-  // Return error code if any failures.
-  if (bytes_read != 0) {
-    TEMP_FAILURE_RETRY(close(read_in[0]));
-    TEMP_FAILURE_RETRY(close(read_in[1]));
-    TEMP_FAILURE_RETRY(close(read_err[0]));
-    TEMP_FAILURE_RETRY(close(read_err[1]));
-    TEMP_FAILURE_RETRY(close(write_out[0]));
-    TEMP_FAILURE_RETRY(close(write_out[1]));
-    if (bytes_read == -1) {
-      return errno;  // Read failed.
-    } else {
-      return child_errno;  // Exec failed.
-    }
+
+int Process::Run(const char* path,
+                 char* arguments[],
+                 intptr_t arguments_length,
+                 const char* working_directory,
+                 char* environment[],
+                 intptr_t environment_length,
+                 int64_t timeout_millis,
+                 ProcessRunResult* result,
+                 char* os_error_message,
+                 int os_error_message_len) {
+  intptr_t in;
+  intptr_t out;
+  intptr_t err;
+  intptr_t pid;
+  intptr_t exit_event;
+  int error = Start(path,
+                    arguments,
+                    arguments_length,
+                    working_directory,
+                    environment,
+                    environment_length,
+                    kStdioNull,
+                    kStdioPipe,
+                    kStdioPipe,
+                    &in,
+                    &out,
+                    &err,
+                    &pid,
+                    &exit_event,
+                    os_error_message,
+                    os_error_message_len);
+  if (error != 0) return error;
+  // stdin is connected to the null device so there is no pipe to it.
+  ASSERT(out == -1);
+  // The process is reaped here rather than by the event handler.
+  bool use_pidfd = ProcessDescriptors::IsSupported();
+  if (use_pidfd) {
+    ProcessDescriptors::Take(exit_event);
   }
 
-  FDUtils::SetNonBlocking(read_in[0]);
-  *in = read_in[0];
-  TEMP_FAILURE_RETRY(close(read_in[1]));
-  FDUtils::SetNonBlocking(write_out[1]);
-  *out = write_out[1];
-  TEMP_FAILURE_RETRY(close(write_out[0]));
-  FDUtils::SetNonBlocking(read_err[0]);
-  *err = read_err[0];
-  TEMP_FAILURE_RETRY(close(read_err[1]));
+  // The output is read as it arrives so the process never blocks on a
+  // full pipe. The exit event, a process descriptor or the exit code
+  // pipe, becomes readable when the process exits.
+  int64_t deadline =
+      (timeout_millis == -1) ? -1 : MonotonicMillis() + timeout_millis;
+  bool exited = false;
+  int poll_error = 0;
+  struct pollfd fds[3];
+  fds[0].fd = in;
+  fds[1].fd = err;
+  fds[2].fd = exit_event;
+  for (intptr_t i = 0; i < 3; i++) {
+    fds[i].events = POLLIN;
+  }
+  while (fds[0].fd != -1 || fds[1].fd != -1 || !exited) {
+    // After the process has been killed its output is not waited for,
+    // as processes it started may still hold the pipes open.
+    if (exited && result->timed_out()) break;
+    int timeout = -1;
+    if (deadline != -1 && !result->timed_out()) {
+      int64_t remaining = deadline - MonotonicMillis();
+      timeout = (remaining > 0) ? remaining : 0;
+    }
+    int ready = TEMP_FAILURE_RETRY(poll(fds, 3, timeout));
+    if (ready == -1) {
+      // The process cannot be watched any longer. It is killed so it
+      // can be reaped and the error is reported.
+      poll_error = errno;
+      KillRunProcess(use_pidfd, exit_event, pid);
+      break;
+    }
+    if (ready == 0) {
+      KillRunProcess(use_pidfd, exit_event, pid);
+      result->set_timed_out(true);
+      continue;
+    }
+    for (intptr_t i = 0; i < 2; i++) {
+      if (fds[i].fd != -1 && fds[i].revents != 0) {
+        ProcessOutput* output = (i == 0) ? result->out() : result->err();
+        if (!ReadOutput(fds[i].fd, output)) {
+          TEMP_FAILURE_RETRY(close(fds[i].fd));
+          fds[i].fd = -1;
+        }
+      }
+    }
+    if (fds[2].fd != -1 && fds[2].revents != 0) {
+      exited = true;
+      // Negative descriptors are ignored by poll.
+      fds[2].fd = -1;
+    }
+  }
+  if (fds[0].fd != -1) TEMP_FAILURE_RETRY(close(fds[0].fd));
+  if (fds[1].fd != -1) TEMP_FAILURE_RETRY(close(fds[1].fd));
 
-  *id = pid;
-  return 0;
+  if (use_pidfd) {
+    error = ReapProcess(pid, result);
+  } else {
+    error = ReadExitCode(exit_event, result);
+  }
+  TEMP_FAILURE_RETRY(close(exit_event));
+  if (poll_error != 0) {
+    error = poll_error;
+  }
+  if (error != 0) {
+    errno = error;
+    SetChildOsErrorMessage(os_error_message, os_error_message_len);
+  }
+  return error;
 }
 
 
@@ -560,6 +1763,52 @@ bool Process::Kill(intptr_t id, int signal) {
 }
 
 
+bool Process::StartZygote() {
+  // The zygote hands out the processes it starts as process
+  // descriptors.
+  if (!ProcessDescriptors::IsSupported()) return false;
+  return ProcessZygote::Start();
+}
+
+
+bool Process::HasZygote() {
+  return ProcessZygote::IsRunning();
+}
+
+
+int Process::KeepWarm(const char* path,
+                      char* arguments[],
+                      intptr_t arguments_length,
+                      const char* working_directory,
+                      char* environment[],
+                      intptr_t environment_length,
+                      StdioMode stdin_mode,
+                      StdioMode stdout_mode,
+                      StdioMode stderr_mode,
+                      intptr_t count,
+                      char* os_error_message,
+                      int os_error_message_len) {
+  return ProcessZygote::KeepWarm(path,
+                                 arguments,
+                                 arguments_length,
+                                 working_directory,
+                                 environment,
+                                 environment_length,
+                                 stdin_mode,
+                                 stdout_mode,
+                                 stderr_mode,
+                                 count,
+                                 os_error_message,
+                                 os_error_message_len);
+}
+
+
+intptr_t Process::TakeProcessDescriptorPid(intptr_t fd) {
+  return ProcessDescriptors::Take(fd);
+}
+
+
 void Process::TerminateExitCodeHandler() {
+  // The exit code handler only runs without process descriptors.
   ExitCodeHandler::TerminateExitCodeThread();
 }
@@ -302,12 +302,40 @@ static void ReportChildError(int exec_control_fd) {
 }
 
 
+// Connects the stdio descriptor fd of the child as given by
+// mode. pipe_fd is the end of the pipe used by the child for
+// kStdioPipe. Returns -1 on failure.
+static int SetupChildStdio(int fd, Process::StdioMode mode, int pipe_fd) {
+  switch (mode) {
+    case Process::kStdioPipe:
+      return TEMP_FAILURE_RETRY(dup2(pipe_fd, fd));
+    case Process::kStdioNull: {
+      int null_fd = TEMP_FAILURE_RETRY(
+          open("/dev/null", (fd == STDIN_FILENO) ? O_RDONLY : O_WRONLY));
+      if (null_fd == -1) return -1;
+      int result = TEMP_FAILURE_RETRY(dup2(null_fd, fd));
+      TEMP_FAILURE_RETRY(close(null_fd));
+      return result;
+    }
+    case Process::kStdioMergeStdout:
+      ASSERT(fd == STDERR_FILENO);
+      return TEMP_FAILURE_RETRY(dup2(STDOUT_FILENO, fd));
+    default:
+      ASSERT(mode == Process::kStdioInherit);
+      return 0;
+  }
+}
+
+
 int Process::Start(const char* path,
                    char* arguments[],
                    intptr_t arguments_length,
                    const char* working_directory,
                    char* environment[],
                    intptr_t environment_length,
+                   StdioMode stdin_mode,
+                   StdioMode stdout_mode,
+                   StdioMode stderr_mode,
                    intptr_t* in,
                    intptr_t* out,
                    intptr_t* err,
@@ -440,17 +468,17 @@ int Process::Start(const char* path,
     TEMP_FAILURE_RETRY(close(read_err[0]));
     TEMP_FAILURE_RETRY(close(exec_control[0]));
 
-    if (TEMP_FAILURE_RETRY(dup2(write_out[0], STDIN_FILENO)) == -1) {
+    if (SetupChildStdio(STDIN_FILENO, stdin_mode, write_out[0]) == -1) {
       ReportChildError(exec_control[1]);
     }
     TEMP_FAILURE_RETRY(close(write_out[0]));
 
-    if (TEMP_FAILURE_RETRY(dup2(read_in[1], STDOUT_FILENO)) == -1) {
+    if (SetupChildStdio(STDOUT_FILENO, stdout_mode, read_in[1]) == -1) {
       ReportChildError(exec_control[1]);
     }
     TEMP_FAILURE_RETRY(close(read_in[1]));
 
-    if (TEMP_FAILURE_RETRY(dup2(read_err[1], STDERR_FILENO)) == -1) {
+    if (SetupChildStdio(STDERR_FILENO, stderr_mode, read_err[1]) == -1) {
       ReportChildError(exec_control[1]);
     }
     TEMP_FAILURE_RETRY(close(read_err[1]));
@@ -535,15 +563,31 @@ int Process::Start(const char* path,
     }
   }
 
-  FDUtils::SetNonBlocking(read_in[0]);
-  *in = read_in[0];
+  // The pipes of streams which are not piped to Dart are not used.
   TEMP_FAILURE_RETRY(close(read_in[1]));
-  FDUtils::SetNonBlocking(write_out[1]);
-  *out = write_out[1];
+  if (stdout_mode == kStdioPipe) {
+    FDUtils::SetNonBlocking(read_in[0]);
+    *in = read_in[0];
+  } else {
+    TEMP_FAILURE_RETRY(close(read_in[0]));
+    *in = -1;
+  }
   TEMP_FAILURE_RETRY(close(write_out[0]));
-  FDUtils::SetNonBlocking(read_err[0]);
-  *err = read_err[0];
+  if (stdin_mode == kStdioPipe) {
+    FDUtils::SetNonBlocking(write_out[1]);
+    *out = write_out[1];
+  } else {
+    TEMP_FAILURE_RETRY(close(write_out[1]));
+    *out = -1;
+  }
   TEMP_FAILURE_RETRY(close(read_err[1]));
+  if (stderr_mode == kStdioPipe) {
+    FDUtils::SetNonBlocking(read_err[0]);
+    *err = read_err[0];
+  } else {
+    TEMP_FAILURE_RETRY(close(read_err[0]));
+    *err = -1;
+  }
 
   *id = pid;
   return 0;
@@ -559,6 +603,58 @@ bool Process::Kill(intptr_t id, int signal) {
 }
 
 
+// The process zygote is only supported on Linux.
+bool Process::StartZygote() {
+  return false;
+}
+
+
+bool Process::HasZygote() {
+  return false;
+}
+
+
+int Process::KeepWarm(const char* path,
+                      char* arguments[],
+                      intptr_t arguments_length,
+                      const char* working_directory,
+                      char* environment[],
+                      intptr_t environment_length,
+                      StdioMode stdin_mode,
+                      StdioMode stdout_mode,
+                      StdioMode stderr_mode,
+                      intptr_t count,
+                      char* os_error_message,
+                      int os_error_message_len) {
+  UNREACHABLE();
+  return 0;
+}
+
+
+// Running a process to completion natively is only supported on
+// Linux.
+int Process::Run(const char* path,
+                 char* arguments[],
+                 intptr_t arguments_length,
+                 const char* working_directory,
+                 char* environment[],
+                 intptr_t environment_length,
+                 int64_t timeout_millis,
+                 ProcessRunResult* result,
+                 char* os_error_message,
+                 int os_error_message_len) {
+  UNREACHABLE();
+  return 0;
+}
+
+
+// Process descriptors are only supported on Linux.
+intptr_t Process::TakeProcessDescriptorPid(intptr_t fd) {
+  UNREACHABLE();
+  return 0;
+}
+
+
 void Process::TerminateExitCodeHandler() {
   ExitCodeHandler::TerminateExitCodeThread();
 }
@@ -0,0 +1,115 @@
+// Copyright (c) 2012, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "platform/globals.h"
+#if defined(TARGET_OS_LINUX)
+
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bin/fdutils.h"
+#include "bin/process.h"
+#include "platform/assert.h"
+#include "vm/benchmark_test.h"
+#include "vm/timer.h"
+#include "vm/unit_test.h"
+
+static const intptr_t kProcessStartBenchmarkCount = 500;
+
+
+// Runs a shell script to completion with Process::Run.
+static int RunScript(const char* script,
+                     int64_t timeout_millis,
+                     ProcessRunResult* result) {
+  static const int kMaxOsErrorMessageLength = 256;
+  char os_error_message[kMaxOsErrorMessageLength];
+  char* arguments[] = { const_cast<char*>("-c"), const_cast<char*>(script) };
+  return Process::Run("sh", arguments, 2, NULL, NULL, 0, timeout_millis,
+                      result, os_error_message, kMaxOsErrorMessageLength);
+}
+
+
+UNIT_TEST_CASE(ProcessRunOutput) {
+  ProcessRunResult result(4);
+  EXPECT_EQ(0, RunScript("echo out; echo error >&2; exit 3", -1, &result));
+  EXPECT_EQ(3, result.exit_code());
+  EXPECT(!result.timed_out());
+  EXPECT_EQ(4, result.out()->length());
+  EXPECT(memcmp("out\n", result.out()->data(), 4) == 0);
+  EXPECT(!result.out()->truncated());
+  EXPECT_EQ(4, result.err()->length());
+  EXPECT(result.err()->truncated());
+  EXPECT(result.max_resident_set_size() > 0);
+}
+
+
+UNIT_TEST_CASE(ProcessRunTimeout) {
+  ProcessRunResult result(-1);
+  EXPECT_EQ(0, RunScript("sleep 10", 100, &result));
+  EXPECT(result.timed_out());
+  EXPECT_EQ(-SIGKILL, result.exit_code());
+}
+
+
+namespace dart {
+
+// Starts short-lived processes one after the other and waits for each
+// of them directly instead of through the event handler.
+static int64_t MeasureProcessStarts(Process::StdioMode mode) {
+  static const int kMaxOsErrorMessageLength = 256;
+  char os_error_message[kMaxOsErrorMessageLength];
+  Timer timer(true, "Process start benchmark");
+  timer.Start();
+  for (intptr_t i = 0; i < kProcessStartBenchmarkCount; i++) {
+    intptr_t in;
+    intptr_t out;
+    intptr_t err;
+    intptr_t pid;
+    intptr_t exit_event;
+    int result = Process::Start("true", NULL, 0, NULL, NULL, 0,
+                                mode, mode, mode,
+                                &in, &out, &err, &pid, &exit_event,
+                                os_error_message, kMaxOsErrorMessageLength);
+    EXPECT_EQ(0, result);
+    if (result != 0) break;
+    if (in != -1) TEMP_FAILURE_RETRY(close(in));
+    if (out != -1) TEMP_FAILURE_RETRY(close(out));
+    if (err != -1) TEMP_FAILURE_RETRY(close(err));
+    // Without process descriptors the exit code handler reaps the
+    // process and writes its exit code to the exit event pipe.
+    if (Process::TakeProcessDescriptorPid(exit_event) == pid) {
+      int status;
+      EXPECT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+      EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    } else {
+      int message[2];
+      EXPECT_EQ(static_cast<intptr_t>(sizeof(message)),
+                FDUtils::ReadFromBlocking(exit_event,
+                                          message,
+                                          sizeof(message)));
+      EXPECT_EQ(0, message[0]);
+    }
+    TEMP_FAILURE_RETRY(close(exit_event));
+  }
+  timer.Stop();
+  return timer.TotalElapsedTime();
+}
+
+
+// Measures process start throughput with stdio piped to Dart.
+BENCHMARK(ProcessStartPiped) {
+  benchmark->set_score(MeasureProcessStarts(Process::kStdioPipe));
+}
+
+
+// Measures process start throughput without stdio pipes.
+BENCHMARK(ProcessStartNullStdio) {
+  benchmark->set_score(MeasureProcessStarts(Process::kStdioNull));
+}
+
+}  // namespace dart
+
+#endif  // defined(TARGET_OS_LINUX)
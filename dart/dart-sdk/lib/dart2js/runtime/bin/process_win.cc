@@ -318,6 +318,9 @@ int Process::Start(const char* path,
                    const char* working_directory,
                    char* environment[],
                    intptr_t environment_length,
+                   StdioMode stdin_mode,
+                   StdioMode stdout_mode,
+                   StdioMode stderr_mode,
                    intptr_t* in,
                    intptr_t* out,
                    intptr_t* err,
@@ -330,6 +333,14 @@ int Process::Start(const char* path,
   HANDLE stderr_handles[2] = { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE };
   HANDLE exit_handles[2] = { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE };
 
+  // The stdio of a process can only be piped to Dart on Windows.
+  if (stdin_mode != kStdioPipe ||
+      stdout_mode != kStdioPipe ||
+      stderr_mode != kStdioPipe) {
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return SetOsErrorMessage(os_error_message, os_error_message_len);
+  }
+
   // Generate unique pipe names for the four named pipes needed.
   char pipe_names[4][80];
   UUID uuid;
@@ -518,6 +529,58 @@ bool Process::Kill(intptr_t id, int signal) {
 }
 
 
+// The process zygote is only supported on Linux.
+bool Process::StartZygote() {
+  return false;
+}
+
+
+bool Process::HasZygote() {
+  return false;
+}
+
+
+int Process::KeepWarm(const char* path,
+                      char* arguments[],
+                      intptr_t arguments_length,
+                      const char* working_directory,
+                      char* environment[],
+                      intptr_t environment_length,
+                      StdioMode stdin_mode,
+                      StdioMode stdout_mode,
+                      StdioMode stderr_mode,
+                      intptr_t count,
+                      char* os_error_message,
+                      int os_error_message_len) {
+  UNREACHABLE();
+  return 0;
+}
+
+
+// Running a process to completion natively is only supported on
+// Linux.
+int Process::Run(const char* path,
+                 char* arguments[],
+                 intptr_t arguments_length,
+                 const char* working_directory,
+                 char* environment[],
+                 intptr_t environment_length,
+                 int64_t timeout_millis,
+                 ProcessRunResult* result,
+                 char* os_error_message,
+                 int os_error_message_len) {
+  UNREACHABLE();
+  return 0;
+}
+
+
+// Process descriptors are only supported on Linux.
+intptr_t Process::TakeProcessDescriptorPid(intptr_t fd) {
+  UNREACHABLE();
+  return 0;
+}
+
+
 void Process::TerminateExitCodeHandler() {
   // Nothing needs to be done on Windows.
 }
@@ -2,8 +2,14 @@
 // for details. All rights reserved. Use of this source code is governed by a
 // BSD-style license that can be found in the LICENSE file.
 
+#include <errno.h>
+
 #include "bin/socket.h"
 #include "bin/dartutils.h"
+#include "bin/eventhandler.h"
+#include "bin/file.h"
+#include "bin/io_buffer_pool.h"
+#include "bin/io_service.h"
 #include "bin/thread.h"
 #include "bin/utils.h"
 
@@ -13,10 +19,8 @@
 
 #include "include/dart_api.h"
 
-dart::Mutex Socket::mutex_;
-int Socket::service_ports_size_ = 0;
-Dart_Port* Socket::service_ports_ = NULL;
-int Socket::service_ports_index_ = 0;
+bool ServerSocket::reuse_port_ = false;
+intptr_t Socket::zero_copy_threshold_ = Socket::kDefaultZeroCopyThreshold;
 
 void FUNCTION_NAME(Socket_CreateConnect)(Dart_NativeArguments args) {
   Dart_EnterScope();
@@ -77,17 +81,17 @@ void FUNCTION_NAME(Socket_ReadList)(Dart_NativeArguments args) {
     if (Dart_IsVMFlagSet("short_socket_read")) {
       length = (length + 1) / 2;
     }
-    uint8_t* buffer = new uint8_t[length];
+    uint8_t* buffer = IOBufferPool::Allocate(length);
     intptr_t bytes_read = Socket::Read(socket, buffer, length);
     if (bytes_read > 0) {
       Dart_Handle result =
           Dart_ListSetAsBytes(buffer_obj, offset, buffer, bytes_read);
       if (Dart_IsError(result)) {
-        delete[] buffer;
+        IOBufferPool::Free(buffer);
         Dart_PropagateError(result);
       }
     }
-    delete[] buffer;
+    IOBufferPool::Free(buffer);
     if (bytes_read >= 0) {
       Dart_SetReturnValue(args, Dart_NewInteger(bytes_read));
     } else {
@@ -129,7 +133,7 @@ void FUNCTION_NAME(Socket_WriteList)(Dart_NativeArguments args) {
   // Send data in chunks of maximum 16KB.
   const intptr_t max_chunk_length =
       dart::Utils::Minimum(length, static_cast<intptr_t>(16 * KB));
-  uint8_t* buffer = new uint8_t[max_chunk_length];
+  uint8_t* buffer = IOBufferPool::Allocate(max_chunk_length);
   intptr_t total_bytes_written = 0;
   intptr_t bytes_written = 0;
   do {
@@ -140,14 +144,14 @@ void FUNCTION_NAME(Socket_WriteList)(Dart_NativeArguments args) {
                                  buffer,
                                  chunk_length);
     if (Dart_IsError(result)) {
-      delete[] buffer;
+      IOBufferPool::Free(buffer);
       Dart_PropagateError(result);
     }
     bytes_written =
         Socket::Write(socket, reinterpret_cast<void*>(buffer), chunk_length);
     total_bytes_written += bytes_written;
   } while (bytes_written > 0 && total_bytes_written < length);
-  delete[] buffer;
+  IOBufferPool::Free(buffer);
   if (bytes_written >= 0) {
     Dart_SetReturnValue(args, Dart_NewInteger(total_bytes_written));
   } else {
@@ -157,6 +161,60 @@ void FUNCTION_NAME(Socket_WriteList)(Dart_NativeArguments args) {
 }
 
 
+void FUNCTION_NAME(Socket_GetZeroCopyThreshold)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_SetReturnValue(args, Dart_NewInteger(Socket::zero_copy_threshold()));
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(Socket_EnableZeroCopy)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t socket =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 0),
+                                 DartUtils::kIdFieldName);
+  Dart_SetReturnValue(args, Dart_NewBoolean(Socket::EnableZeroCopy(socket)));
+  Dart_ExitScope();
+}
+
+
+// Writes from a byte array backed by a file mapping without copying
+// the data. Returns null if the data has to be written normally
+// instead. The caller keeps the byte array alive until the kernel
+// reports the write complete.
+void FUNCTION_NAME(Socket_WriteListZeroCopy)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t socket =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 0),
+                                 DartUtils::kIdFieldName);
+  Dart_Handle buffer_obj = Dart_GetNativeArgument(args, 1);
+  intptr_t offset =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 2));
+  intptr_t length =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 3));
+  void* peer = NULL;
+  if (Dart_IsError(Dart_ExternalByteArrayGetPeer(buffer_obj, &peer)) ||
+      !MappedMemory::IsRegistered(peer)) {
+    Dart_SetReturnValue(args, Dart_Null());
+    Dart_ExitScope();
+    return;
+  }
+  MappedMemory* mapping = reinterpret_cast<MappedMemory*>(peer);
+  ASSERT((offset + length) <= mapping->length());
+  intptr_t bytes_written =
+      Socket::WriteZeroCopy(socket, mapping->address() + offset, length);
+  if (bytes_written >= 0) {
+    Dart_SetReturnValue(args, Dart_NewInteger(bytes_written));
+  } else if (errno == ENOBUFS) {
+    // Too many zero-copy writes are waiting for completion.
+    Dart_SetReturnValue(args, Dart_Null());
+  } else {
+    Dart_SetReturnValue(args, DartUtils::NewDartOSError());
+  }
+  Dart_ExitScope();
+}
+
+
 void FUNCTION_NAME(Socket_GetPort)(Dart_NativeArguments args) {
   Dart_EnterScope();
   intptr_t socket =
@@ -269,6 +327,311 @@ void FUNCTION_NAME(ServerSocket_Accept)(Dart_NativeArguments args) {
   Dart_ExitScope();
 }
 
+// A ConnectionDispatcher owns a native port which is registered with
+// the event handler as the receiver of events on a listening socket.
+// Pending connections are accepted on the native port's thread and
+// handed to the worker ports, so the isolate which created the server
+// socket never touches the accepted connections. Each worker receives
+// the message [fd, dispatcher port, worker index] and posts the
+// release message [kReleaseMessage, worker index] back to the
+// dispatcher port when the connection is closed. The number of
+// connections not yet released is the load used by the kLeastLoaded
+// policy.
+class ConnectionDispatcher {
+ public:
+  enum DispatcherMessage {
+    kReleaseMessage = 0,
+    kCloseMessage = 1
+  };
+
+  ConnectionDispatcher(intptr_t fd,
+                       EventHandler* event_handler,
+                       Dart_Port error_port,
+                       Dart_Port* worker_ports,
+                       intptr_t worker_count,
+                       ServerSocket::DispatchPolicy policy)
+      : fd_(fd),
+        port_(kIllegalPort),
+        event_handler_(event_handler),
+        error_port_(error_port),
+        worker_ports_(worker_ports),
+        loads_(new intptr_t[worker_count]),
+        worker_count_(worker_count),
+        next_worker_(0),
+        policy_(policy),
+        next_(NULL) {
+    for (intptr_t i = 0; i < worker_count_; i++) {
+      loads_[i] = 0;
+    }
+  }
+
+  ~ConnectionDispatcher() {
+    delete[] worker_ports_;
+    delete[] loads_;
+  }
+
+  // Register interest in connections on the listening socket with
+  // the event handler. The event handler unregisters the socket each
+  // time an event is delivered so this is called after every event.
+  void Listen() {
+    event_handler_->SendData(
+        fd_, port_, (1 << kInEvent) | (1 << kListeningSocket), 0);
+  }
+
+  // Accept all pending connections and post each of them to a worker.
+  void HandleEvents(intptr_t event_mask) {
+    if ((event_mask & (1 << kInEvent)) == 0) {
+      // Errors and close events are reported to the isolate owning
+      // the server socket.
+      DartUtils::PostInt32(error_port_, event_mask);
+      return;
+    }
+    while (true) {
+      intptr_t socket = ServerSocket::Accept(fd_);
+      if (socket == ServerSocket::kTemporaryFailure) break;
+      if (socket < 0) {
+        DartUtils::PostInt32(error_port_, 1 << kErrorEvent);
+        return;
+      }
+      Dispatch(socket);
+    }
+    Listen();
+  }
+
+  void Release(intptr_t worker) {
+    if (worker >= 0 && worker < worker_count_ && loads_[worker] > 0) {
+      loads_[worker]--;
+    }
+  }
+
+  void Close() {
+    event_handler_->SendData(fd_, port_, 1 << kCloseCommand, 0);
+    Dart_CloseNativePort(port_);
+  }
+
+  Dart_Port port() { return port_; }
+  void set_port(Dart_Port port) { port_ = port; }
+  ConnectionDispatcher* next() { return next_; }
+  void set_next(ConnectionDispatcher* dispatcher) { next_ = dispatcher; }
+
+ private:
+  intptr_t NextWorker() {
+    intptr_t worker = next_worker_;
+    if (policy_ == ServerSocket::kLeastLoaded) {
+      // Start the search at the round-robin position so workers with
+      // equal load still take turns.
+      for (intptr_t i = 1; i < worker_count_; i++) {
+        intptr_t candidate = (next_worker_ + i) % worker_count_;
+        if (loads_[candidate] < loads_[worker]) worker = candidate;
+      }
+    }
+    next_worker_ = (worker + 1) % worker_count_;
+    return worker;
+  }
+
+  void Dispatch(intptr_t socket) {
+    intptr_t worker = NextWorker();
+    CObjectArray* message = new CObjectArray(CObject::NewArray(3));
+    message->SetAt(0, new CObjectIntptr(CObject::NewIntptr(socket)));
+    message->SetAt(1, new CObjectInt64(CObject::NewInt64(port_)));
+    message->SetAt(2, new CObjectIntptr(CObject::NewIntptr(worker)));
+    if (Dart_PostCObject(worker_ports_[worker], message->AsApiCObject())) {
+      loads_[worker]++;
+    } else {
+      // The worker port is gone. Let the event handler close the
+      // connection rather than leaking it.
+      event_handler_->SendData(socket, 0, 1 << kCloseCommand, 0);
+    }
+  }
+
+  intptr_t fd_;
+  Dart_Port port_;
+  EventHandler* event_handler_;
+  Dart_Port error_port_;
+  Dart_Port* worker_ports_;
+  intptr_t* loads_;
+  intptr_t worker_count_;
+  intptr_t next_worker_;
+  ServerSocket::DispatchPolicy policy_;
+  ConnectionDispatcher* next_;
+};
+
+
+// Singly-linked list of all active connection dispatchers. Native
+// ports carry no user data so this is used to find the dispatcher
+// for the port a message was delivered to.
+class ConnectionDispatcherList {
+ public:
+  static void Add(ConnectionDispatcher* dispatcher) {
+    MutexLocker locker(&mutex_);
+    dispatcher->set_next(active_dispatchers_);
+    active_dispatchers_ = dispatcher;
+  }
+
+  static ConnectionDispatcher* Lookup(Dart_Port port) {
+    MutexLocker locker(&mutex_);
+    ConnectionDispatcher* current = active_dispatchers_;
+    while (current != NULL) {
+      if (current->port() == port) return current;
+      current = current->next();
+    }
+    return NULL;
+  }
+
+  static void Remove(ConnectionDispatcher* dispatcher) {
+    MutexLocker locker(&mutex_);
+    ConnectionDispatcher* prev = NULL;
+    ConnectionDispatcher* current = active_dispatchers_;
+    while (current != NULL) {
+      if (current == dispatcher) {
+        if (prev == NULL) {
+          active_dispatchers_ = current->next();
+        } else {
+          prev->set_next(current->next());
+        }
+        return;
+      }
+      prev = current;
+      current = current->next();
+    }
+  }
+
+ private:
+  static ConnectionDispatcher* active_dispatchers_;
+  static dart::Mutex mutex_;
+};
+
+
+ConnectionDispatcher* ConnectionDispatcherList::active_dispatchers_ = NULL;
+dart::Mutex ConnectionDispatcherList::mutex_;
+
+
+void ConnectionDispatcherHandler(Dart_Port dest_port_id,
+                                 Dart_Port reply_port_id,
+                                 Dart_CObject* message) {
+  ConnectionDispatcher* dispatcher =
+      ConnectionDispatcherList::Lookup(dest_port_id);
+  if (dispatcher == NULL) return;
+  if (message->type == Dart_CObject::kInt32) {
+    // Event mask posted by the event handler.
+    dispatcher->HandleEvents(message->value.as_int32);
+  } else if (message->type == Dart_CObject::kArray) {
+    CObjectArray request(message);
+    if (request.Length() > 0 && request[0]->IsInt32()) {
+      CObjectInt32 message_type(request[0]);
+      switch (message_type.Value()) {
+        case ConnectionDispatcher::kReleaseMessage:
+          if (request.Length() == 2 && request[1]->IsIntptr()) {
+            CObjectIntptr worker(request[1]);
+            dispatcher->Release(worker.Value());
+          }
+          break;
+        case ConnectionDispatcher::kCloseMessage:
+          ConnectionDispatcherList::Remove(dispatcher);
+          dispatcher->Close();
+          delete dispatcher;
+          break;
+        default:
+          UNREACHABLE();
+      }
+    }
+  }
+}
+
+
+static bool PostToDispatcher(Dart_Port dispatcher_port,
+                             int32_t message_type,
+                             intptr_t worker) {
+  CObjectArray* message = new CObjectArray(CObject::NewArray(2));
+  message->SetAt(0, new CObjectInt32(CObject::NewInt32(message_type)));
+  message->SetAt(1, new CObjectIntptr(CObject::NewIntptr(worker)));
+  return Dart_PostCObject(dispatcher_port, message->AsApiCObject());
+}
+
+
+void FUNCTION_NAME(ServerSocket_Dispatch)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  intptr_t socket =
+      DartUtils::GetIntegerField(Dart_GetNativeArgument(args, 0),
+                                 DartUtils::kIdFieldName);
+  Dart_Handle event_handler_obj = Dart_GetNativeArgument(args, 1);
+  Dart_Handle error_port_obj = Dart_GetNativeArgument(args, 2);
+  Dart_Handle workers_obj = Dart_GetNativeArgument(args, 3);
+  Dart_Handle policy_obj = Dart_GetNativeArgument(args, 4);
+  int64_t policy = 0;
+  intptr_t worker_count = 0;
+  if (Dart_IsList(workers_obj) &&
+      !Dart_IsError(Dart_ListLength(workers_obj, &worker_count)) &&
+      worker_count > 0 &&
+      DartUtils::GetInt64Value(policy_obj, &policy) &&
+      (policy == ServerSocket::kRoundRobin ||
+       policy == ServerSocket::kLeastLoaded)) {
+    Dart_Port* worker_ports = new Dart_Port[worker_count];
+    for (intptr_t i = 0; i < worker_count; i++) {
+      Dart_Handle worker = Dart_ListGetAt(workers_obj, i);
+      if (Dart_IsError(worker)) {
+        delete[] worker_ports;
+        Dart_PropagateError(worker);
+      }
+      worker_ports[i] =
+          DartUtils::GetIntegerField(worker, DartUtils::kIdFieldName);
+    }
+    Dart_Port error_port =
+        DartUtils::GetIntegerField(error_port_obj, DartUtils::kIdFieldName);
+    ConnectionDispatcher* dispatcher = new ConnectionDispatcher(
+        socket,
+        EventHandler::FromDartObject(event_handler_obj),
+        error_port,
+        worker_ports,
+        worker_count,
+        static_cast<ServerSocket::DispatchPolicy>(policy));
+    // The dispatcher state is not synchronized so messages have to
+    // be handled one at a time.
+    Dart_Port port = Dart_NewNativePort("ConnectionDispatcher",
+                                        ConnectionDispatcherHandler,
+                                        false);
+    if (port != kIllegalPort) {
+      dispatcher->set_port(port);
+      ConnectionDispatcherList::Add(dispatcher);
+      dispatcher->Listen();
+      Dart_SetReturnValue(args, Dart_NewInteger(port));
+    } else {
+      delete dispatcher;
+      OSError os_error(-1, "Failed to create dispatcher", OSError::kUnknown);
+      Dart_SetReturnValue(args, DartUtils::NewDartOSError(&os_error));
+    }
+  } else {
+    OSError os_error(-1, "Invalid argument", OSError::kUnknown);
+    Dart_Handle err = DartUtils::NewDartOSError(&os_error);
+    if (Dart_IsError(err)) Dart_PropagateError(err);
+    Dart_SetReturnValue(args, err);
+  }
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(ServerSocket_CloseDispatcher)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_Port dispatcher_port =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  PostToDispatcher(dispatcher_port, ConnectionDispatcher::kCloseMessage, 0);
+  Dart_ExitScope();
+}
+
+
+void FUNCTION_NAME(Socket_ReleaseDispatched)(Dart_NativeArguments args) {
+  Dart_EnterScope();
+  Dart_Port dispatcher_port =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 0));
+  intptr_t worker =
+      DartUtils::GetIntegerValue(Dart_GetNativeArgument(args, 1));
+  PostToDispatcher(dispatcher_port,
+                   ConnectionDispatcher::kReleaseMessage,
+                   worker);
+  Dart_ExitScope();
+}
+
+
 
 static CObject* LookupRequest(const CObjectArray& request) {
   if (request.Length() == 2 && request[1]->IsString()) {
@@ -313,27 +676,10 @@ void SocketService(Dart_Port dest_port_id,
 
 
 Dart_Port Socket::GetServicePort() {
-  MutexLocker lock(&mutex_);
-  if (service_ports_size_ == 0) {
-    ASSERT(service_ports_ == NULL);
-    service_ports_size_ = 16;
-    service_ports_ = new Dart_Port[service_ports_size_];
-    service_ports_index_ = 0;
-    for (int i = 0; i < service_ports_size_; i++) {
-      service_ports_[i] = kIllegalPort;
-    }
-  }
-
-  Dart_Port result = service_ports_[service_ports_index_];
-  if (result == kIllegalPort) {
-    result = Dart_NewNativePort("SocketService",
-                                SocketService,
-                                true);
-    ASSERT(result != kIllegalPort);
-    service_ports_[service_ports_index_] = result;
-  }
-  service_ports_index_ = (service_ports_index_ + 1) % service_ports_size_;
-  return result;
+  return IOService::GetServicePort(IOService::kSocketService,
+                                   "SocketService",
+                                   SocketService,
+                                   IOService::kNoOrderingKey);
 }
 
 
@@ -20,6 +20,17 @@ interface ServerSocket default _ServerSocket {
    */
   void set onError(void callback(e));
 
+  /**
+   * Hands all connections accepted on this socket to the isolates
+   * listening on [workers] instead of calling the connection
+   * handler. Connections are accepted natively without involving
+   * this isolate and are distributed round-robin, or to the worker
+   * with the fewest open dispatched connections if [leastLoaded] is
+   * true. Each worker receives a message which is turned into a
+   * socket using [:new Socket.fromDispatch(message):].
+   */
+  void dispatchTo(List<SendPort> workers, [bool leastLoaded]);
+
   /**
    * Returns the port used by this socket.
    */
@@ -40,6 +51,14 @@ interface Socket extends Hashable default _Socket {
    */
   Socket(String host, int port);
 
+  /**
+   * Constructs a socket for a connection handed to this isolate by a
+   * server socket dispatching its connections, see
+   * [ServerSocket.dispatchTo]. [message] is the message received on
+   * the worker port.
+   */
+  Socket.fromDispatch(List message);
+
   /**
    * Returns the number of received and non-read bytes in the socket that
    * can be read.
@@ -91,6 +110,24 @@ interface Socket extends Hashable default _Socket {
    */
   void set onError(void callback(e));
 
+  /**
+   * The timeout handler gets called when one of the timeouts set
+   * with [setTimeouts] expires.
+   */
+  void set onTimeout(void callback());
+
+  /**
+   * Sets the read and write timeouts of the socket in milliseconds. A
+   * read timeout expires when no data has been received for
+   * [readTimeout] milliseconds while waiting for data, and a write
+   * timeout when the socket has not become writable within
+   * [writeTimeout] milliseconds while waiting to write. A value of 0
+   * disables the timeout. The timeouts are tracked with a resolution
+   * of 100 milliseconds by the event handler without using timers and
+   * are currently only supported on Linux.
+   */
+  void setTimeouts(int readTimeout, int writeTimeout);
+
   /**
    * Returns input stream to the socket.
    */
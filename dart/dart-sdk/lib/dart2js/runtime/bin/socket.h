@@ -28,10 +28,38 @@ class Socket {
     kLookupRequest = 0,
   };
 
+  static const intptr_t kDefaultZeroCopyThreshold = 64 * KB;
+
   static bool Initialize();
   static intptr_t Available(intptr_t fd);
   static int Read(intptr_t fd, void* buffer, intptr_t num_bytes);
   static int Write(intptr_t fd, const void* buffer, intptr_t num_bytes);
+
+  // Zero-copy writes hand the pages of the caller's buffer to the
+  // kernel instead of copying the data. EnableZeroCopy turns them on
+  // for a socket and returns false where they are not supported. The
+  // kernel numbers the successful zero-copy writes on a socket
+  // consecutively from 0, wrapping at 2^32, and the buffer must stay
+  // mapped and unmodified until the write is reported complete.
+  // WriteZeroCopy fails with ENOBUFS when the socket has too many
+  // writes not yet reported, in which case the caller writes normally.
+  static bool EnableZeroCopy(intptr_t fd);
+  static int WriteZeroCopy(intptr_t fd, const void* buffer, intptr_t num_bytes);
+  // Reads completion notifications from the error queue of the
+  // socket. Each completed range of zero-copy write ids is stored as
+  // its first and last id in two consecutive entries of ranges.
+  // Returns the number of ranges read, at most max_ranges.
+  static intptr_t ReadZeroCopyCompletions(intptr_t fd,
+                                          uint32_t* ranges,
+                                          intptr_t max_ranges);
+
+  // Writes of at least this many bytes from byte arrays backed by
+  // File.mmapSync mappings use zero-copy writes where supported. A
+  // value of 0 disables zero-copy writes.
+  static intptr_t zero_copy_threshold() { return zero_copy_threshold_; }
+  static void set_zero_copy_threshold(intptr_t value) {
+    zero_copy_threshold_ = value;
+  }
   static intptr_t CreateConnect(const char* host, const intptr_t port);
   static intptr_t GetPort(intptr_t fd);
   static bool GetRemotePeer(intptr_t fd, char *host, intptr_t *port);
@@ -45,10 +73,7 @@ class Socket {
   static Dart_Port GetServicePort();
 
  private:
-  static dart::Mutex mutex_;
-  static int service_ports_size_;
-  static Dart_Port* service_ports_;
-  static int service_ports_index_;
+  static intptr_t zero_copy_threshold_;
 
   DISALLOW_ALLOCATION();
   DISALLOW_IMPLICIT_CONSTRUCTORS(Socket);
@@ -59,11 +84,27 @@ class ServerSocket {
  public:
   static const intptr_t kTemporaryFailure = -2;
 
+  // These values have to be kept in sync with the dispatch policy
+  // constants in socket_impl.dart.
+  enum DispatchPolicy {
+    kRoundRobin = 0,
+    kLeastLoaded = 1
+  };
+
   static intptr_t Accept(intptr_t fd);
   static intptr_t CreateBindListen(const char* bindAddress,
                                    intptr_t port,
                                    intptr_t backlog);
 
+  // When set, listening sockets are created with SO_REUSEPORT where
+  // supported so several isolates can listen on the same address and
+  // port and have the kernel balance connections between them.
+  static bool reuse_port() { return reuse_port_; }
+  static void set_reuse_port(bool value) { reuse_port_ = value; }
+
+ private:
+  static bool reuse_port_;
+
   DISALLOW_ALLOCATION();
   DISALLOW_IMPLICIT_CONSTRUCTORS(ServerSocket);
 };
@@ -17,21 +17,37 @@ class _SocketBase {
   static final int _OUT_EVENT = 1;
   static final int _ERROR_EVENT = 2;
   static final int _CLOSE_EVENT = 3;
+  // Only received from the eventhandler, as the first element of a
+  // list with the first and last id of each range of zero-copy writes
+  // the kernel has completed.
+  static final int _RELEASE_EVENT = 4;
+  static final int _TIMEOUT_EVENT = 5;
 
   static final int _CLOSE_COMMAND = 8;
   static final int _SHUTDOWN_READ_COMMAND = 9;
   static final int _SHUTDOWN_WRITE_COMMAND = 10;
+  // The set timeout commands carry the timeout in milliseconds in a
+  // separate field of the message.
+  static final int _SET_READ_TIMEOUT_COMMAND = 11;
+  static final int _SET_WRITE_TIMEOUT_COMMAND = 12;
 
   // Flag send to the eventhandler providing additional information on
   // the type of the file descriptor.
   static final int _LISTENING_SOCKET = 16;
   static final int _PIPE = 17;
+  // The id is a process descriptor and the eventhandler posts the
+  // exit code of the process instead of an event mask (Linux only).
+  static final int _PROCESS_EXIT = 18;
+  // The id is the shared file system watcher instance and the
+  // eventhandler posts the changes to the ports of the watches (Linux
+  // only).
+  static final int _FILE_SYSTEM_WATCH = 19;
 
   static final int _FIRST_EVENT = _IN_EVENT;
-  static final int _LAST_EVENT = _CLOSE_EVENT;
+  static final int _LAST_EVENT = _TIMEOUT_EVENT;
 
   static final int _FIRST_COMMAND = _CLOSE_COMMAND;
-  static final int _LAST_COMMAND = _SHUTDOWN_WRITE_COMMAND;
+  static final int _LAST_COMMAND = _SET_WRITE_TIMEOUT_COMMAND;
 
   _SocketBase () {
     _handlerMap = new List(_LAST_EVENT + 1);
@@ -177,13 +193,19 @@ class _SocketBase {
     }
   }
 
-  void _sendToEventHandler(int data) {
+  void _sendToEventHandler(int data, [int timeout = 0]) {
     if (_handler === null) {
       _handler = new ReceivePort();
-      _handler.receive((var message, ignored) { _multiplex(message); });
+      _handler.receive((var message, ignored) {
+        if (message is List) {
+          _releaseZeroCopyWrites(message);
+        } else {
+          _multiplex(message);
+        }
+      });
     }
     assert(_id >= 0);
-    _EventHandler._sendData(_id, _handler, data);
+    _EventHandler._sendData(_id, _handler, data, timeout);
   }
 
   bool _reportError(error, String message) {
@@ -227,6 +249,8 @@ class _SocketBase {
 
   bool _propagateError(Exception e) => false;
 
+  void _releaseZeroCopyWrites(List message) { }
+
   abstract bool _isListenSocket();
   abstract bool _isPipe();
 
@@ -278,12 +302,21 @@ class _ServerSocket extends _SocketBase implements ServerSocket {
 
   _ServerSocket._internal();
 
+  // These values have to be kept in sync with the DispatchPolicy
+  // enum in socket.h.
+  static final int _DISPATCH_ROUND_ROBIN = 0;
+  static final int _DISPATCH_LEAST_LOADED = 1;
+
   _accept(Socket socket) native "ServerSocket_Accept";
 
   _createBindListen(String bindAddress, int port, int backlog)
       native "ServerSocket_CreateBindListen";
 
   void set onConnection(void callback(Socket connection)) {
+    if (_dispatcher !== null) {
+      throw new SocketIOException(
+          "Cannot set connection handler when dispatching connections");
+    }
     _clientConnectionHandler = callback;
     _setHandler(_SocketBase._IN_EVENT,
                 _clientConnectionHandler != null ? _connectionHandler : null);
@@ -305,10 +338,73 @@ class _ServerSocket extends _SocketBase implements ServerSocket {
     }
   }
 
+  void dispatchTo(List<SendPort> workers, [bool leastLoaded = false]) {
+    if (_id < 0) {
+      throw new SocketIOException("dispatchTo failed - invalid socket handle");
+    }
+    if (_dispatcher !== null) {
+      throw new SocketIOException("Already dispatching connections");
+    }
+    if (workers.isEmpty()) {
+      throw new IllegalArgumentException(workers);
+    }
+    _clientConnectionHandler = null;
+    _handlerMask &= ~(1 << _SocketBase._IN_EVENT);
+    _handlerMap[_SocketBase._IN_EVENT] = null;
+    // Errors on the listening socket are still reported through the
+    // receive port of this socket.
+    if (_handler === null) {
+      _handler = new ReceivePort();
+      _handler.receive((var message, ignored) { _multiplex(message); });
+    }
+    int policy = leastLoaded ? _DISPATCH_LEAST_LOADED : _DISPATCH_ROUND_ROBIN;
+    var result = _dispatch(_EventHandler._eventHandler,
+                           _handler,
+                           workers,
+                           policy);
+    if (result is OSError) {
+      close();
+      throw new SocketIOException("Failed to dispatch connections", result);
+    }
+    _dispatcher = result;
+  }
+
+  _dispatch(_EventHandler eventHandler,
+            ReceivePort errorPort,
+            List<SendPort> workers,
+            int policy) native "ServerSocket_Dispatch";
+
+  static void _closeDispatcher(int dispatcher)
+      native "ServerSocket_CloseDispatcher";
+
+  void _activateHandlers() {
+    // When dispatching, the native dispatcher owns the registration
+    // of the listening socket with the event handler.
+    if (_dispatcher === null) super._activateHandlers();
+  }
+
+  void _close() {
+    if (_id >= 0 && _dispatcher !== null) {
+      // The dispatcher closes the listening socket once it has
+      // handled all events already delivered to it.
+      _closeDispatcher(_dispatcher);
+      _dispatcher = null;
+      _handler.close();
+      _handler = null;
+      _id = -1;
+    } else {
+      super._close();
+    }
+  }
+
   bool _isListenSocket() => true;
   bool _isPipe() => false;
 
   var _clientConnectionHandler;
+
+  // Native port of the connection dispatcher, null if connections are
+  // not dispatched.
+  int _dispatcher;
 }
 
 
@@ -340,6 +436,16 @@ class _Socket extends _SocketBase implements Socket {
     return socket;
   }
 
+  // Constructs a socket for a connection accepted by a dispatching
+  // server socket. The message is [id, dispatcher, worker index].
+  factory _Socket.fromDispatch(List message) {
+    _Socket socket = new _Socket._internal();
+    socket._id = message[0];
+    socket._dispatcher = message[1];
+    socket._dispatchWorker = message[2];
+    return socket;
+  }
+
   _Socket._internal();
   _Socket._internalReadOnly() : _pipe = true { super._closedWrite = true; }
   _Socket._internalWriteOnly() : _pipe = true { super._closedRead = true; }
@@ -402,6 +508,20 @@ class _Socket extends _SocketBase implements Socket {
       if ((offset + bytes) > buffer.length) {
         throw new IndexOutOfRangeException(offset + bytes);
       }
+      if (buffer is Uint8List && _canWriteZeroCopy(bytes)) {
+        var result = _writeListZeroCopy(buffer, offset, bytes);
+        if (result is int) {
+          // Every zero-copy write which sent data is assigned the next
+          // id and the buffer is kept until the kernel is done with it.
+          if (result > 0) _zeroCopyWrites.add(buffer);
+          return result;
+        }
+        if (result is OSError) {
+          _reportError(result, "Write failed");
+          return 0;
+        }
+        // Otherwise the data is written normally.
+      }
       // When using the Dart C API to access raw data, using a ByteArray is
       // currently much faster. This function will make a copy of the
       // supplied List to a ByteArray if it isn't already.
@@ -438,6 +558,46 @@ class _Socket extends _SocketBase implements Socket {
   _writeList(List<int> buffer, int offset, int bytes)
       native "Socket_WriteList";
 
+  bool _canWriteZeroCopy(int bytes) {
+    if (_zeroCopyThreshold === null) {
+      _zeroCopyThreshold = _getZeroCopyThreshold();
+    }
+    if (_zeroCopyThreshold == 0 || bytes < _zeroCopyThreshold || _pipe) {
+      return false;
+    }
+    if (_zeroCopy === null) {
+      _zeroCopy = _enableZeroCopy();
+      if (_zeroCopy) _zeroCopyWrites = new List();
+    }
+    return _zeroCopy;
+  }
+
+  void _releaseZeroCopyWrites(List message) {
+    if (_zeroCopyWrites === null) return;
+    for (int i = 1; i < message.length; i += 2) {
+      // The ids wrap around at 2^32.
+      int first = (message[i] - _zeroCopyFirstId) & 0xFFFFFFFF;
+      int last = (message[i + 1] - _zeroCopyFirstId) & 0xFFFFFFFF;
+      for (int j = first; j <= last && j < _zeroCopyWrites.length; j++) {
+        _zeroCopyWrites[j] = null;
+      }
+    }
+    int completed = 0;
+    while (completed < _zeroCopyWrites.length &&
+           _zeroCopyWrites[completed] === null) {
+      completed++;
+    }
+    if (completed > 0) {
+      _zeroCopyWrites.removeRange(0, completed);
+      _zeroCopyFirstId = (_zeroCopyFirstId + completed) & 0xFFFFFFFF;
+    }
+  }
+
+  _writeListZeroCopy(List<int> buffer, int offset, int bytes)
+      native "Socket_WriteListZeroCopy";
+  bool _enableZeroCopy() native "Socket_EnableZeroCopy";
+  static int _getZeroCopyThreshold() native "Socket_GetZeroCopyThreshold";
+
   bool _isErrorResponse(response) {
     return response is List && response[0] != _FileUtils.SUCCESS_RESPONSE;
   }
@@ -476,10 +636,43 @@ class _Socket extends _SocketBase implements Socket {
     _onClosed = callback;
   }
 
+  void set onTimeout(void callback()) {
+    _setHandler(_SocketBase._TIMEOUT_EVENT, callback);
+  }
+
+  void setTimeouts(int readTimeout, int writeTimeout) {
+    if (_id < 0) {
+      throw new
+          SocketIOException("setTimeouts failed - invalid socket handle");
+    }
+    if (readTimeout is! int || readTimeout < 0) {
+      throw new IllegalArgumentException(readTimeout);
+    }
+    if (writeTimeout is! int || writeTimeout < 0) {
+      throw new IllegalArgumentException(writeTimeout);
+    }
+    _sendToEventHandler(1 << _SocketBase._SET_READ_TIMEOUT_COMMAND,
+                        readTimeout);
+    _sendToEventHandler(1 << _SocketBase._SET_WRITE_TIMEOUT_COMMAND,
+                        writeTimeout);
+  }
+
   bool _isListenSocket() => false;
 
   bool _isPipe() => _pipe;
 
+  void _close() {
+    if (_id >= 0 && _dispatcher !== null) {
+      // Tell the dispatcher that this worker has one connection less.
+      _releaseDispatched(_dispatcher, _dispatchWorker);
+      _dispatcher = null;
+    }
+    super._close();
+  }
+
+  static void _releaseDispatched(int dispatcher, int worker)
+      native "Socket_ReleaseDispatched";
+
   InputStream get inputStream() {
     if (_inputStream == null) {
       if (_handlerMap[_SocketBase._IN_EVENT] !== null ||
@@ -590,5 +783,15 @@ class _Socket extends _SocketBase implements Socket {
   SocketOutputStream _outputStream;
   String _remoteHost;
   int _remotePort;
+  int _dispatcher;
+  int _dispatchWorker;
+  // Whether zero-copy writes are enabled, null until first needed.
+  bool _zeroCopy;
+  // Buffers of zero-copy writes in the order of their ids, starting
+  // with the id _zeroCopyFirstId. Completed writes are set to null
+  // until all writes before them have completed as well.
+  List _zeroCopyWrites;
+  int _zeroCopyFirstId = 0;
+  static int _zeroCopyThreshold;
   static SendPort _socketService;
 }
@@ -6,7 +6,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+// linux/errqueue.h uses struct timespec without declaring it.
+#include <linux/errqueue.h>
 
 #include "bin/fdutils.h"
 #include "bin/socket.h"
@@ -84,6 +87,73 @@ int Socket::Write(intptr_t fd, const void* buffer, intptr_t num_bytes) {
 }
 
 
+bool Socket::EnableZeroCopy(intptr_t fd) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  int optval = 1;
+  return TEMP_FAILURE_RETRY(setsockopt(
+      fd, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval))) == 0;
+#else
+  return false;
+#endif
+}
+
+
+int Socket::WriteZeroCopy(intptr_t fd, const void* buffer, intptr_t num_bytes) {
+  ASSERT(fd >= 0);
+#if defined(MSG_ZEROCOPY)
+  ssize_t written_bytes =
+      TEMP_FAILURE_RETRY(send(fd, buffer, num_bytes, MSG_ZEROCOPY));
+  ASSERT(EAGAIN == EWOULDBLOCK);
+  if (written_bytes == -1 && errno == EWOULDBLOCK) {
+    // If the would block we need to retry and therefore return 0 as
+    // the number of bytes written.
+    written_bytes = 0;
+  }
+  return written_bytes;
+#else
+  UNREACHABLE();
+  return -1;
+#endif
+}
+
+
+intptr_t Socket::ReadZeroCopyCompletions(intptr_t fd,
+                                         uint32_t* ranges,
+                                         intptr_t max_ranges) {
+  intptr_t count = 0;
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+  while (count < max_ranges) {
+    char control[128];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (TEMP_FAILURE_RETRY(recvmsg(fd, &message, MSG_ERRQUEUE)) < 0) {
+      // The error queue is empty.
+      break;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      struct sock_extended_err* error =
+          reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cmsg));
+      if (error->ee_errno == 0 &&
+          error->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+        ranges[2 * count] = error->ee_info;
+        ranges[2 * count + 1] = error->ee_data;
+        count++;
+      }
+    }
+  }
+#endif
+  return count;
+}
+
+
 intptr_t Socket::GetPort(intptr_t fd) {
   ASSERT(fd >= 0);
   struct sockaddr_in socket_address;
@@ -186,6 +256,18 @@ intptr_t ServerSocket::CreateBindListen(const char* host,
   TEMP_FAILURE_RETRY(
       setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)));
 
+#if defined(SO_REUSEPORT)
+  if (reuse_port()) {
+    if (TEMP_FAILURE_RETRY(setsockopt(fd,
+                                      SOL_SOCKET,
+                                      SO_REUSEPORT,
+                                      &optval,
+                                      sizeof(optval))) < 0) {
+      fprintf(stderr, "Error SO_REUSEPORT: %s\n", strerror(errno));
+    }
+  }
+#endif
+
   server_address.sin_family = AF_INET;
   server_address.sin_port = htons(port);
   server_address.sin_addr.s_addr = inet_addr(host);
@@ -84,6 +84,25 @@ int Socket::Write(intptr_t fd, const void* buffer, intptr_t num_bytes) {
 }
 
 
+bool Socket::EnableZeroCopy(intptr_t fd) {
+  // Zero-copy writes are not supported on Mac OS.
+  return false;
+}
+
+
+int Socket::WriteZeroCopy(intptr_t fd, const void* buffer, intptr_t num_bytes) {
+  UNREACHABLE();
+  return -1;
+}
+
+
+intptr_t Socket::ReadZeroCopyCompletions(intptr_t fd,
+                                         uint32_t* ranges,
+                                         intptr_t max_ranges) {
+  return 0;
+}
+
+
 intptr_t Socket::GetPort(intptr_t fd) {
   ASSERT(fd >= 0);
   struct sockaddr_in socket_address;
@@ -186,6 +205,18 @@ intptr_t ServerSocket::CreateBindListen(const char* host,
   TEMP_FAILURE_RETRY(
       setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)));
 
+#if defined(SO_REUSEPORT)
+  if (reuse_port()) {
+    if (TEMP_FAILURE_RETRY(setsockopt(fd,
+                                      SOL_SOCKET,
+                                      SO_REUSEPORT,
+                                      &optval,
+                                      sizeof(optval))) < 0) {
+      fprintf(stderr, "Error SO_REUSEPORT: %s\n", strerror(errno));
+    }
+  }
+#endif
+
   server_address.sin_family = AF_INET;
   server_address.sin_port = htons(port);
   server_address.sin_addr.s_addr = inet_addr(host);
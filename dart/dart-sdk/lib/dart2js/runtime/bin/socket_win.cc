@@ -35,6 +35,25 @@ intptr_t Socket::Write(intptr_t fd, const void* buffer, intptr_t num_bytes) {
 }
 
 
+bool Socket::EnableZeroCopy(intptr_t fd) {
+  // Zero-copy writes are not supported on Windows.
+  return false;
+}
+
+
+int Socket::WriteZeroCopy(intptr_t fd, const void* buffer, intptr_t num_bytes) {
+  UNREACHABLE();
+  return -1;
+}
+
+
+intptr_t Socket::ReadZeroCopyCompletions(intptr_t fd,
+                                         uint32_t* ranges,
+                                         intptr_t max_ranges) {
+  return 0;
+}
+
+
 intptr_t Socket::GetPort(intptr_t fd) {
   ASSERT(reinterpret_cast<Handle*>(fd)->is_socket());
   SocketHandle* socket_handle = reinterpret_cast<SocketHandle*>(fd);